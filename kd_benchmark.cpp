@@ -0,0 +1,1071 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// usage: kd_benchmark [--distributions uniform,clusters,lines,duplicates,snapped,skewed]
+//                     [--sizes 1000,1000000] [--dimensions 2,3,4,8]
+//                     [--coordinates float,double,int32]
+//                     [--queries 10000] [--repeat 5]
+//                     [--format json|csv] [--output path]
+// Measures the builds and the queries for each combination of the data
+// distribution, size, dimension and coordinate type. The results are written
+// as JSON or CSV, one row per algorithm, see kd_benchmark::result.
+// Each layout is built into its own range so the queries of a layout always
+// run on the range built by it. The traversal counters are reported for
+// kd_binary_search, kd_nearest, kd_nearest_left_balanced and their three-way
+// variants.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/random.hpp>
+
+#include <boost/geometry.hpp>
+#include <boost/geometry/index/rtree.hpp>
+
+#include "kd_count_within.hpp"
+#include "kd_dynamic_index.hpp"
+#include "kd_nearest_batch.hpp"
+#include "kd_quantized_index.hpp"
+#include "kd_soa_index.hpp"
+#include "kd_sort.hpp"
+#include "kd_sort_blocked.hpp"
+#include "kd_sort_extents.hpp"
+#include "kd_sort_left_balanced.hpp"
+#include "kd_sort_parallel.hpp"
+#include "kd_sort_sampled.hpp"
+#include "kd_sort_spread.hpp"
+#include "kd_sort_three_way.hpp"
+
+#include "kd_benchmark.hpp"
+
+namespace bg = boost::geometry;
+namespace bgi = bg::index;
+
+typedef boost::chrono::steady_clock steady_clock_t;
+typedef boost::chrono::duration<double, boost::nano> ns_t;
+
+// the coordinates are generated in [-range, range]
+double const range = 1000000;
+std::size_t const nearest_k = 16;
+// the epsilons of the approximate kd_nearest() queries
+double const nearest_epsilon_low = 0.5;
+double const nearest_epsilon_high = 1.0;
+
+// ---------------------------------------------------------------------- //
+
+struct options
+{
+    options()
+        : queries(10000), repeat(5), format("json")
+    {
+        distributions.push_back("uniform");
+        distributions.push_back("clusters");
+        distributions.push_back("lines");
+        distributions.push_back("duplicates");
+        distributions.push_back("snapped");
+        distributions.push_back("skewed");
+#if !defined(_DEBUG) || defined(NDEBUG)
+        sizes.push_back(1000);
+        sizes.push_back(100000);
+        sizes.push_back(1000000);
+#else
+        sizes.push_back(100);
+#endif
+        dimensions.push_back(2);
+        dimensions.push_back(3);
+        dimensions.push_back(8);
+        coordinates.push_back("double");
+    }
+
+    std::vector<std::string> distributions;
+    std::vector<std::size_t> sizes;
+    std::vector<std::size_t> dimensions;
+    std::vector<std::string> coordinates;
+    std::size_t queries;
+    std::size_t repeat;
+    std::string format;
+    std::string output;
+};
+
+template <typename T>
+std::vector<T> split_list(std::string const& list)
+{
+    std::vector<T> result;
+    std::string::size_type first = 0;
+    while ( first <= list.size() )
+    {
+        std::string::size_type last = list.find(',', first);
+        if ( last == std::string::npos )
+            last = list.size();
+        if ( last > first )
+            result.push_back(boost::lexical_cast<T>(list.substr(first, last - first)));
+        first = last + 1;
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------- //
+
+// The values of the distribution, the same for all coordinate types and
+// dimensions for the given seed. The queries are generated with a different
+// seed so they follow the density of the data.
+class generator
+{
+public:
+    generator(std::string const& distribution, std::size_t dimension, std::size_t size, unsigned seed)
+        : m_distribution(distribution)
+        , m_dimension(dimension)
+        , m_rng(seed)
+        , m_uniform(-range, range)
+        , m_normal(0, 1)
+    {
+        // the structure of the data doesn't depend on the seed
+        boost::mt19937 rng(12345);
+        boost::uniform_real<double> uniform(-range, range);
+        std::size_t centers_count = 0;
+        if ( distribution == "clusters" )
+            centers_count = 64;
+        else if ( distribution == "lines" )
+            centers_count = 2 * 32;
+        else if ( distribution == "duplicates" )
+            centers_count = (std::max)(size / 100, std::size_t(1));
+        else if ( distribution == "skewed" )
+            centers_count = 1000;
+        else if ( distribution == "snapped" )
+            centers_count = 0;
+        else if ( distribution != "uniform" )
+            throw std::invalid_argument("unknown distribution " + distribution);
+
+        m_centers.resize(centers_count * dimension);
+        for ( std::size_t i = 0 ; i < m_centers.size() ; ++i )
+            m_centers[i] = uniform(rng);
+
+        // the sizes of the cities follow the Zipf's law
+        if ( distribution == "skewed" )
+        {
+            double sum = 0;
+            for ( std::size_t i = 0 ; i < centers_count ; ++i )
+            {
+                sum += 1.0 / double(i + 1);
+                m_weights.push_back(sum);
+            }
+        }
+    }
+
+    // writes dimension coordinates
+    void next(double * coords)
+    {
+        std::size_t const dim = m_dimension;
+        if ( m_distribution == "uniform" )
+        {
+            for ( std::size_t d = 0 ; d < dim ; ++d )
+                coords[d] = m_uniform(m_rng);
+        }
+        else if ( m_distribution == "clusters" )
+        {
+            double const* c = center(uniform_index(m_centers.size() / dim));
+            for ( std::size_t d = 0 ; d < dim ; ++d )
+                coords[d] = c[d] + m_normal(m_rng) * range / 100;
+        }
+        else if ( m_distribution == "lines" )
+        {
+            std::size_t const line = uniform_index(m_centers.size() / dim / 2);
+            double const* a = center(2 * line);
+            double const* b = center(2 * line + 1);
+            double const t = (m_uniform(m_rng) + range) / (2 * range);
+            for ( std::size_t d = 0 ; d < dim ; ++d )
+                coords[d] = a[d] + t * (b[d] - a[d]) + m_normal(m_rng) * range / 10000;
+        }
+        else if ( m_distribution == "duplicates" )
+        {
+            double const* c = center(uniform_index(m_centers.size() / dim));
+            std::copy(c, c + dim, coords);
+        }
+        else if ( m_distribution == "snapped" )
+        {
+            // 256 grid lines per axis so many values share each coordinate
+            double const cell = 2 * range / 256;
+            for ( std::size_t d = 0 ; d < dim ; ++d )
+                coords[d] = std::floor(m_uniform(m_rng) / cell) * cell;
+        }
+        else // skewed
+        {
+            double const w = (m_uniform(m_rng) + range) / (2 * range) * m_weights.back();
+            std::size_t const i = std::lower_bound(m_weights.begin(), m_weights.end(), w) - m_weights.begin();
+            double const* c = center((std::min)(i, m_weights.size() - 1));
+            for ( std::size_t d = 0 ; d < dim ; ++d )
+                coords[d] = c[d] + m_normal(m_rng) * range / 500;
+        }
+
+        for ( std::size_t d = 0 ; d < dim ; ++d )
+            coords[d] = (std::max)(-range, (std::min)(range, coords[d]));
+    }
+
+private:
+    std::size_t uniform_index(std::size_t count)
+    {
+        std::size_t i = static_cast<std::size_t>((m_uniform(m_rng) + range) / (2 * range) * double(count));
+        return (std::min)(i, count - 1);
+    }
+
+    double const* center(std::size_t i) const
+    {
+        return &m_centers[i * m_dimension];
+    }
+
+    std::string m_distribution;
+    std::size_t m_dimension;
+    boost::mt19937 m_rng;
+    boost::uniform_real<double> m_uniform;
+    boost::normal_distribution<double> m_normal;
+    std::vector<double> m_centers;
+    std::vector<double> m_weights;
+};
+
+template <typename Point, std::size_t I = 0, std::size_t D = bg::dimension<Point>::value>
+struct assign_coords
+{
+    static inline void apply(Point & p, double const* coords)
+    {
+        typedef typename bg::coordinate_type<Point>::type coordinate_type;
+        bg::set<I>(p, static_cast<coordinate_type>(coords[I]));
+        assign_coords<Point, I+1>::apply(p, coords);
+    }
+};
+
+template <typename Point, std::size_t D>
+struct assign_coords<Point, D, D>
+{
+    static inline void apply(Point & , double const* ) {}
+};
+
+// the structure of the distribution depends on the size of the data, e.g.
+// the number of duplicates, so it's passed also for the queries
+template <typename Point>
+void generate(std::string const& distribution, std::size_t size, std::size_t count, unsigned seed,
+              std::vector<Point> & points)
+{
+    std::size_t const dim = bg::dimension<Point>::value;
+    generator gen(distribution, dim, size, seed);
+    double coords[dim];
+
+    points.resize(count);
+    for ( std::size_t i = 0 ; i < count ; ++i )
+    {
+        gen.next(coords);
+        assign_coords<Point>::apply(points[i], coords);
+    }
+}
+
+// ---------------------------------------------------------------------- //
+
+// Each query returns a number compared with the one returned by the reference
+// query, e.g. the comparable distance to the nearest value or the number of
+// values found.
+
+template <typename Point, std::size_t I = 0, std::size_t D = bg::dimension<Point>::value>
+struct get_coords
+{
+    static inline void apply(Point const& p, double * coords)
+    {
+        coords[I] = double(bg::get<I>(p));
+        get_coords<Point, I+1>::apply(p, coords);
+    }
+};
+
+template <typename Point, std::size_t D>
+struct get_coords<Point, D, D>
+{
+    static inline void apply(Point const& , double * ) {}
+};
+
+// the half of the side of the box expected to contain about 16 values for the
+// uniform distribution, also the distance of kd_within_distance()
+template <typename Point>
+double query_radius(std::size_t size)
+{
+    std::size_t const dim = bg::dimension<Point>::value;
+    return range * std::pow(16.0 / double((std::max)(size, std::size_t(1))), 1.0 / double(dim));
+}
+
+template <typename Point>
+bg::model::box<Point> query_box(Point const& p, std::size_t size)
+{
+    std::size_t const dim = bg::dimension<Point>::value;
+    double const half = query_radius<Point>(size);
+
+    double mins[dim], maxs[dim];
+    get_coords<Point>::apply(p, mins);
+    for ( std::size_t d = 0 ; d < dim ; ++d )
+    {
+        maxs[d] = mins[d] + half;
+        mins[d] -= half;
+    }
+
+    bg::model::box<Point> b;
+    assign_coords<Point>::apply(b.min_corner(), mins);
+    assign_coords<Point>::apply(b.max_corner(), maxs);
+    return b;
+}
+
+template <typename Point>
+struct indexes
+{
+    typedef bgi::rtree<Point, bgi::linear<8> > rtree_type;
+    typedef typename bg::coordinate_type<Point>::type coordinate_type;
+    static const std::size_t dimension = bg::dimension<Point>::value;
+
+    // the ranges built by the layouts, soa is the range passed to kd_soa_index
+    std::vector<Point> kd, sampled, left_balanced, three_way, blocked, spread, extents, quantized, soa;
+    bgi::detail::kd_split_axes<dimension> spread_axes;
+    bgi::detail::kd_split_extents<coordinate_type> extents_splits;
+    bgi::detail::kd_soa_index<Point> soa_index;
+    bgi::detail::kd_quantized_index<Point> quantized_index;
+    bgi::detail::kd_dynamic_index<Point> dynamic;
+    rtree_type rtree;
+};
+
+template <typename Point>
+struct query_buffers
+{
+    std::vector<Point> values;
+    std::vector<std::pair<Point, double> > pairs;
+    std::vector<std::size_t> positions;
+
+    void clear()
+    {
+        values.clear();
+        pairs.clear();
+        positions.clear();
+    }
+};
+
+enum query_kind
+{
+    query_binary_search,
+    query_binary_search_three_way,
+    query_binary_search_blocked,
+    query_binary_search_spread,
+    query_binary_search_extents,
+    query_binary_search_soa,
+    query_binary_search_quantized,
+    query_binary_search_dynamic,
+    query_nearest,
+    query_nearest_sampled,
+    query_nearest_three_way,
+    query_nearest_left_balanced,
+    query_nearest_blocked,
+    query_nearest_spread,
+    query_nearest_extents,
+    query_nearest_soa,
+    query_nearest_quantized,
+    query_nearest_dynamic,
+    query_nearest_epsilon_low,
+    query_nearest_epsilon_high,
+    query_nearest_k,
+    query_nearest_k_left_balanced,
+    query_nearest_k_dynamic,
+    query_within,
+    query_within_blocked,
+    query_within_extents,
+    query_within_soa,
+    query_within_dynamic,
+    query_count_within,
+    query_within_distance,
+    query_within_distance_left_balanced,
+    query_within_distance_dynamic,
+    query_rtree_nearest,
+    query_rtree_nearest_k,
+    query_rtree_within
+};
+
+template <typename Point>
+struct batch_function
+{
+    typedef typename std::vector<Point>::const_iterator const_iterator;
+    typedef typename std::vector<Point>::iterator iterator;
+    typedef bool (*type)(const_iterator, const_iterator, const_iterator, const_iterator, iterator,
+                         bgi::detail::kd_task_pool &, std::size_t);
+};
+
+template <typename Point>
+inline double nearest_k_result(Point const& q, std::vector<Point> const& buffer)
+{
+    double result = 0;
+    BOOST_FOREACH(Point const& p, buffer)
+        result = (std::max)(result, double(bg::comparable_distance(q, p)));
+    return result;
+}
+
+template <typename Point>
+inline double run_query(query_kind kind, indexes<Point> const& idx, Point const& q, query_buffers<Point> & buffers)
+{
+    typedef typename std::vector<Point>::const_iterator it_t;
+    it_t const kd_first = idx.kd.begin(), kd_last = idx.kd.end();
+    it_t const lb_first = idx.left_balanced.begin(), lb_last = idx.left_balanced.end();
+    std::size_t const size = idx.kd.size();
+
+    Point r;
+    std::size_t pos = 0;
+    buffers.clear();
+    switch ( kind )
+    {
+    case query_binary_search:
+        return bgi::detail::kd_binary_search(kd_first, kd_last, q) ? 1 : 0;
+    case query_binary_search_three_way:
+        return bgi::detail::kd_binary_search_three_way(idx.three_way.begin(), idx.three_way.end(), q) ? 1 : 0;
+    case query_binary_search_blocked:
+        return bgi::detail::kd_binary_search_blocked(idx.blocked.begin(), idx.blocked.end(), q) ? 1 : 0;
+    case query_binary_search_spread:
+        return bgi::detail::kd_binary_search_spread(idx.spread.begin(), idx.spread.end(), idx.spread_axes, q) ? 1 : 0;
+    case query_binary_search_extents:
+        return bgi::detail::kd_binary_search_extents(idx.extents.begin(), idx.extents.end(), idx.extents_splits, q) ? 1 : 0;
+    case query_binary_search_soa:
+        return idx.soa_index.binary_search(q) ? 1 : 0;
+    case query_binary_search_quantized:
+        return idx.quantized_index.binary_search(idx.quantized.begin(), q) ? 1 : 0;
+    case query_binary_search_dynamic:
+        return idx.dynamic.binary_search(q) ? 1 : 0;
+    case query_nearest:
+        if ( ! bgi::detail::kd_nearest(kd_first, kd_last, q, r) )
+            return -1;
+        return bg::comparable_distance(q, r);
+    case query_nearest_sampled:
+        if ( ! bgi::detail::kd_nearest(idx.sampled.begin(), idx.sampled.end(), q, r) )
+            return -1;
+        return bg::comparable_distance(q, r);
+    case query_nearest_three_way:
+        if ( ! bgi::detail::kd_nearest_three_way(idx.three_way.begin(), idx.three_way.end(), q, r) )
+            return -1;
+        return bg::comparable_distance(q, r);
+    case query_nearest_left_balanced:
+        if ( ! bgi::detail::kd_nearest_left_balanced(lb_first, lb_last, q, r) )
+            return -1;
+        return bg::comparable_distance(q, r);
+    case query_nearest_blocked:
+        if ( ! bgi::detail::kd_nearest_blocked(idx.blocked.begin(), idx.blocked.end(), q, r) )
+            return -1;
+        return bg::comparable_distance(q, r);
+    case query_nearest_spread:
+        if ( ! bgi::detail::kd_nearest_spread(idx.spread.begin(), idx.spread.end(), idx.spread_axes, q, r) )
+            return -1;
+        return bg::comparable_distance(q, r);
+    case query_nearest_extents:
+        if ( ! bgi::detail::kd_nearest_extents(idx.extents.begin(), idx.extents.end(), idx.extents_splits, q, r) )
+            return -1;
+        return bg::comparable_distance(q, r);
+    case query_nearest_soa:
+        if ( ! idx.soa_index.nearest(q, pos) )
+            return -1;
+        return bg::comparable_distance(q, idx.soa[pos]);
+    case query_nearest_quantized:
+        if ( ! idx.quantized_index.nearest(idx.quantized.begin(), q, pos) )
+            return -1;
+        return bg::comparable_distance(q, idx.quantized[pos]);
+    case query_nearest_dynamic:
+        if ( ! idx.dynamic.nearest(q, r) )
+            return -1;
+        return bg::comparable_distance(q, r);
+    case query_nearest_epsilon_low:
+        if ( ! bgi::detail::kd_nearest(kd_first, kd_last, q, r, nearest_epsilon_low) )
+            return -1;
+        return bg::comparable_distance(q, r);
+    case query_nearest_epsilon_high:
+        if ( ! bgi::detail::kd_nearest(kd_first, kd_last, q, r, nearest_epsilon_high) )
+            return -1;
+        return bg::comparable_distance(q, r);
+    case query_nearest_k:
+        bgi::detail::kd_nearest_k(kd_first, kd_last, q, nearest_k, std::back_inserter(buffers.values));
+        return nearest_k_result(q, buffers.values);
+    case query_nearest_k_left_balanced:
+        bgi::detail::kd_nearest_k_left_balanced(lb_first, lb_last, q, nearest_k, std::back_inserter(buffers.values));
+        return nearest_k_result(q, buffers.values);
+    case query_nearest_k_dynamic:
+        idx.dynamic.nearest(q, nearest_k, std::back_inserter(buffers.values));
+        return nearest_k_result(q, buffers.values);
+    case query_within:
+        return double(bgi::detail::kd_query_within(kd_first, kd_last, query_box(q, size), std::back_inserter(buffers.values)));
+    case query_within_blocked:
+        return double(bgi::detail::kd_query_within_blocked(idx.blocked.begin(), idx.blocked.end(), query_box(q, size), std::back_inserter(buffers.values)));
+    case query_within_extents:
+        // the same as covered_by for the Points
+        return double(bgi::detail::kd_query_intersects_extents(idx.extents.begin(), idx.extents.end(), idx.extents_splits, query_box(q, size), std::back_inserter(buffers.values)));
+    case query_within_soa:
+        return double(idx.soa_index.query_within(query_box(q, size), std::back_inserter(buffers.positions)));
+    case query_within_dynamic:
+        return double(idx.dynamic.query_within(query_box(q, size), std::back_inserter(buffers.values)));
+    case query_count_within:
+        return double(bgi::detail::kd_count_within(kd_first, kd_last, query_box(q, size)));
+    case query_within_distance:
+        return double(bgi::detail::kd_within_distance(kd_first, kd_last, q, query_radius<Point>(size), std::back_inserter(buffers.pairs)));
+    case query_within_distance_left_balanced:
+        return double(bgi::detail::kd_within_distance_left_balanced(lb_first, lb_last, q, query_radius<Point>(size), std::back_inserter(buffers.pairs)));
+    case query_within_distance_dynamic:
+        return double(idx.dynamic.within_distance(q, query_radius<Point>(size), std::back_inserter(buffers.pairs)));
+    case query_rtree_nearest:
+        if ( idx.rtree.query(bgi::nearest(q, 1), &r) < 1 )
+            return -1;
+        return bg::comparable_distance(q, r);
+    case query_rtree_nearest_k:
+        idx.rtree.query(bgi::nearest(q, unsigned(nearest_k)), std::back_inserter(buffers.values));
+        return nearest_k_result(q, buffers.values);
+    case query_rtree_within:
+        return double(idx.rtree.query(bgi::covered_by(query_box(q, size)), std::back_inserter(buffers.values)));
+    }
+    return 0;
+}
+
+// the same as run_query() but the traversal counters of the current thread
+// are updated, returns false if the query isn't instrumented
+template <typename Point>
+inline bool run_query_counted(query_kind kind, indexes<Point> const& idx, Point const& q)
+{
+    typedef typename std::vector<Point>::const_iterator it_t;
+    typedef typename bg::default_comparable_distance_result<Point>::type cdist_type;
+    typedef bgi::detail::kd_thread_stats stats;
+
+    std::size_t const VM = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN;
+    it_t const kd_first = idx.kd.begin(), kd_last = idx.kd.end();
+    it_t const lb_first = idx.left_balanced.begin();
+    it_t const tw_first = idx.three_way.begin(), tw_last = idx.three_way.end();
+
+    if ( idx.kd.empty() )
+        return false;
+
+    switch ( kind )
+    {
+    case query_binary_search:
+        bgi::detail::kd_binary_search_impl<Point, 0, VM, stats>::apply(kd_first, kd_last, q);
+        return true;
+    case query_binary_search_three_way:
+        bgi::detail::kd_binary_search_three_way_impl<Point, 0, VM, stats>::apply(tw_first, tw_last, q);
+        return true;
+    case query_nearest:
+    {
+        it_t out_it = kd_first;
+        cdist_type cdist = bg::comparable_distance(q, *kd_first);
+        bgi::detail::kd_nearest_impl<Point, 0, VM, stats>::apply(kd_first, kd_last, q, out_it, cdist);
+        return true;
+    }
+    case query_nearest_three_way:
+    {
+        it_t out_it = tw_first;
+        cdist_type cdist = bg::comparable_distance(q, *tw_first);
+        bgi::detail::kd_nearest_three_way_impl<Point, 0, VM, stats>::apply(tw_first, tw_last, q, out_it, cdist);
+        return true;
+    }
+    case query_nearest_left_balanced:
+    {
+        it_t out_it = lb_first;
+        cdist_type cdist = bg::comparable_distance(q, *lb_first);
+        bgi::detail::kd_nearest_left_balanced_impl<Point, 0, stats>::apply(lb_first, 1, idx.left_balanced.size(), q, out_it, cdist);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// ---------------------------------------------------------------------- //
+
+class runner
+{
+public:
+    explicit runner(options const& opt)
+        : m_options(opt)
+    {}
+
+    std::vector<kd_benchmark::result> const& results() const
+    {
+        return m_results;
+    }
+
+    template <typename Point>
+    void run(std::string const& distribution, std::size_t size, std::string const& coordinate)
+    {
+        kd_benchmark::result row;
+        row.distribution = distribution;
+        row.size = size;
+        row.dimension = bg::dimension<Point>::value;
+        row.coordinate = coordinate;
+
+        std::cerr << distribution << ' ' << size << ' ' << row.dimension << "D " << coordinate << std::endl;
+
+        std::vector<Point> data, queries, values;
+        generate(distribution, size, size, 1, data);
+        generate(distribution, size, (std::min)(m_options.queries, size), 2, queries);
+        // the existing values for the binary search
+        for ( std::size_t i = 0 ; i < queries.size() ; ++i )
+            values.push_back(data[i * data.size() / queries.size()]);
+
+        typedef typename indexes<Point>::coordinate_type coordinate_type;
+        static const std::size_t dimension = indexes<Point>::dimension;
+
+        indexes<Point> idx;
+        // the ranges of the layouts which aren't queried
+        std::vector<Point> parallel, left_balanced_parallel, dynamic;
+        measure_build(row, "kd_sort", data, idx.kd, &build_kd_sort<Point>);
+        measure_build(row, "kd_sort_sampled", data, idx.sampled, &build_kd_sort_sampled<Point>);
+        measure_build(row, "kd_sort_left_balanced", data, idx.left_balanced, &build_kd_sort_left_balanced<Point>);
+        measure_build(row, "kd_sort_three_way", data, idx.three_way, &build_kd_sort_three_way<Point>);
+        measure_build(row, "kd_sort_blocked", data, idx.blocked, &build_kd_sort_blocked<Point>);
+        measure_build(row, "kd_sort_spread", data, idx.spread, build_kd_sort_spread<dimension>(idx.spread_axes));
+        measure_build(row, "kd_sort_extents", data, idx.extents, build_kd_sort_extents<coordinate_type>(idx.extents_splits));
+        measure_build(row, "kd_soa_index", data, idx.soa, build_index<bgi::detail::kd_soa_index<Point> >(idx.soa_index));
+        measure_build(row, "kd_quantized_index", data, idx.quantized, build_index<bgi::detail::kd_quantized_index<Point> >(idx.quantized_index));
+        measure_build(row, "kd_dynamic_index", data, dynamic, build_dynamic_index<Point>(idx.dynamic));
+        measure_build(row, "kd_sort_parallel", data, parallel, &build_kd_sort_parallel<Point>);
+        measure_build(row, "kd_sort_left_balanced_parallel", data, left_balanced_parallel, &build_kd_sort_left_balanced_parallel<Point>);
+        measure_rtree_build(row, data, idx.rtree);
+
+        std::vector<double> reference_nearest, reference_nearest_k, reference_within, reference_distance;
+        measure_queries(row, "rtree::nearest", query_rtree_nearest, idx, queries, reference_nearest, 0);
+        measure_queries(row, "rtree::nearest_k", query_rtree_nearest_k, idx, queries, reference_nearest_k, 0);
+        measure_queries(row, "rtree::covered_by", query_rtree_within, idx, queries, reference_within, 0);
+        // there is no rtree query returning the same values
+        measure_queries(row, "kd_within_distance", query_within_distance, idx, queries, reference_distance, 0);
+
+        std::vector<double> checks, found(values.size(), 1);
+        measure_queries(row, "kd_binary_search", query_binary_search, idx, values, checks, &found);
+        measure_queries(row, "kd_binary_search_three_way", query_binary_search_three_way, idx, values, checks, &found);
+        measure_queries(row, "kd_binary_search_blocked", query_binary_search_blocked, idx, values, checks, &found);
+        measure_queries(row, "kd_binary_search_spread", query_binary_search_spread, idx, values, checks, &found);
+        measure_queries(row, "kd_binary_search_extents", query_binary_search_extents, idx, values, checks, &found);
+        measure_queries(row, "kd_soa_index::binary_search", query_binary_search_soa, idx, values, checks, &found);
+        measure_queries(row, "kd_quantized_index::binary_search", query_binary_search_quantized, idx, values, checks, &found);
+        measure_queries(row, "kd_dynamic_index::binary_search", query_binary_search_dynamic, idx, values, checks, &found);
+
+        measure_queries(row, "kd_nearest", query_nearest, idx, queries, checks, &reference_nearest);
+        measure_queries(row, "kd_nearest_sampled", query_nearest_sampled, idx, queries, checks, &reference_nearest);
+        measure_queries(row, "kd_nearest_three_way", query_nearest_three_way, idx, queries, checks, &reference_nearest);
+        measure_queries(row, "kd_nearest_left_balanced", query_nearest_left_balanced, idx, queries, checks, &reference_nearest);
+        measure_queries(row, "kd_nearest_blocked", query_nearest_blocked, idx, queries, checks, &reference_nearest);
+        measure_queries(row, "kd_nearest_spread", query_nearest_spread, idx, queries, checks, &reference_nearest);
+        measure_queries(row, "kd_nearest_extents", query_nearest_extents, idx, queries, checks, &reference_nearest);
+        measure_queries(row, "kd_soa_index::nearest", query_nearest_soa, idx, queries, checks, &reference_nearest);
+        measure_queries(row, "kd_quantized_index::nearest", query_nearest_quantized, idx, queries, checks, &reference_nearest);
+        measure_queries(row, "kd_dynamic_index::nearest", query_nearest_dynamic, idx, queries, checks, &reference_nearest);
+        // the epsilon pruning pays off in the higher dimensions, compare with kd_nearest
+        measure_queries(row, "kd_nearest(epsilon=0.5)", query_nearest_epsilon_low, idx, queries, checks, &reference_nearest,
+                        (1 + nearest_epsilon_low) * (1 + nearest_epsilon_low));
+        measure_queries(row, "kd_nearest(epsilon=1)", query_nearest_epsilon_high, idx, queries, checks, &reference_nearest,
+                        (1 + nearest_epsilon_high) * (1 + nearest_epsilon_high));
+        measure_batch(row, "kd_nearest_batch", idx.kd, queries, &bgi::detail::kd_nearest_batch, reference_nearest);
+        measure_batch(row, "kd_nearest_left_balanced_batch", idx.left_balanced, queries, &bgi::detail::kd_nearest_left_balanced_batch, reference_nearest);
+
+        measure_queries(row, "kd_nearest_k", query_nearest_k, idx, queries, checks, &reference_nearest_k);
+        measure_queries(row, "kd_nearest_k_left_balanced", query_nearest_k_left_balanced, idx, queries, checks, &reference_nearest_k);
+        measure_queries(row, "kd_dynamic_index::nearest_k", query_nearest_k_dynamic, idx, queries, checks, &reference_nearest_k);
+
+        measure_queries(row, "kd_query_within", query_within, idx, queries, checks, &reference_within);
+        measure_queries(row, "kd_query_within_blocked", query_within_blocked, idx, queries, checks, &reference_within);
+        measure_queries(row, "kd_query_intersects_extents", query_within_extents, idx, queries, checks, &reference_within);
+        measure_queries(row, "kd_soa_index::query_within", query_within_soa, idx, queries, checks, &reference_within);
+        measure_queries(row, "kd_dynamic_index::query_within", query_within_dynamic, idx, queries, checks, &reference_within);
+        measure_queries(row, "kd_count_within", query_count_within, idx, queries, checks, &reference_within);
+
+        measure_queries(row, "kd_within_distance_left_balanced", query_within_distance_left_balanced, idx, queries, checks, &reference_distance);
+        measure_queries(row, "kd_dynamic_index::within_distance", query_within_distance_dynamic, idx, queries, checks, &reference_distance);
+    }
+
+private:
+    template <typename Point>
+    static void build_kd_sort(std::vector<Point> & v)
+    {
+        bgi::detail::kd_sort(v.begin(), v.end());
+    }
+
+    template <typename Point>
+    static void build_kd_sort_sampled(std::vector<Point> & v)
+    {
+        bgi::detail::kd_sort_sampled(v.begin(), v.end());
+    }
+
+    template <typename Point>
+    static void build_kd_sort_left_balanced(std::vector<Point> & v)
+    {
+        bgi::detail::kd_sort_left_balanced(v.begin(), v.end());
+    }
+
+    template <typename Point>
+    static void build_kd_sort_three_way(std::vector<Point> & v)
+    {
+        bgi::detail::kd_sort_three_way(v.begin(), v.end());
+    }
+
+    template <typename Point>
+    static void build_kd_sort_blocked(std::vector<Point> & v)
+    {
+        bgi::detail::kd_sort_blocked(v.begin(), v.end());
+    }
+
+    template <typename Point>
+    static void build_kd_sort_parallel(std::vector<Point> & v)
+    {
+        bgi::detail::kd_sort_parallel(v.begin(), v.end());
+    }
+
+    template <typename Point>
+    static void build_kd_sort_left_balanced_parallel(std::vector<Point> & v)
+    {
+        bgi::detail::kd_sort_left_balanced_parallel(v.begin(), v.end());
+    }
+
+    template <std::size_t Dimension>
+    struct build_kd_sort_spread
+    {
+        explicit build_kd_sort_spread(bgi::detail::kd_split_axes<Dimension> & a) : axes(a) {}
+
+        template <typename Point>
+        void operator()(std::vector<Point> & v) const
+        {
+            bgi::detail::kd_sort_spread(v.begin(), v.end(), axes);
+        }
+
+        bgi::detail::kd_split_axes<Dimension> & axes;
+    };
+
+    template <typename Coord>
+    struct build_kd_sort_extents
+    {
+        explicit build_kd_sort_extents(bgi::detail::kd_split_extents<Coord> & e) : extents(e) {}
+
+        template <typename Point>
+        void operator()(std::vector<Point> & v) const
+        {
+            bgi::detail::kd_sort_extents(v.begin(), v.end(), extents);
+        }
+
+        bgi::detail::kd_split_extents<Coord> & extents;
+    };
+
+    // kd_soa_index and kd_quantized_index, the range is kept for the queries
+    template <typename Index>
+    struct build_index
+    {
+        explicit build_index(Index & i) : index(i) {}
+
+        template <typename Point>
+        void operator()(std::vector<Point> & v) const
+        {
+            index.build(v.begin(), v.end());
+        }
+
+        Index & index;
+    };
+
+    template <typename Point>
+    struct build_dynamic_index
+    {
+        explicit build_dynamic_index(bgi::detail::kd_dynamic_index<Point> & i) : index(i) {}
+
+        void operator()(std::vector<Point> & v) const
+        {
+            index.clear();
+            index.insert(v.begin(), v.end());
+        }
+
+        bgi::detail::kd_dynamic_index<Point> & index;
+    };
+
+    void add_build(kd_benchmark::result row, std::string const& algorithm,
+                   std::vector<double> & times, std::size_t rss)
+    {
+        row.algorithm = algorithm;
+        row.operation = "build";
+        row.count = times.size();
+        kd_benchmark::percentiles(times, row.median_ns, row.p99_ns);
+        row.throughput = row.median_ns > 0 ? double(row.size) / row.median_ns * 1e9 : 0;
+        row.peak_rss_kb = rss;
+        m_results.push_back(row);
+    }
+
+    // the data is copied to the result before the time is measured
+    template <typename Point, typename Build>
+    void measure_build(kd_benchmark::result const& row, std::string const& algorithm,
+                       std::vector<Point> const& data, std::vector<Point> & result,
+                       Build const& build)
+    {
+        std::vector<double> times;
+        std::size_t rss = 0;
+        for ( std::size_t i = 0 ; i < m_options.repeat ; ++i )
+        {
+            std::vector<Point>().swap(result);
+            result = data;
+            kd_benchmark::reset_peak_rss();
+            std::size_t const rss_before = kd_benchmark::peak_rss();
+
+            steady_clock_t::time_point start = steady_clock_t::now();
+            build(result);
+            times.push_back(ns_t(steady_clock_t::now() - start).count());
+
+            rss = (std::max)(rss, kd_benchmark::peak_rss() - rss_before);
+        }
+        add_build(row, algorithm, times, rss);
+    }
+
+    template <typename Point>
+    void measure_rtree_build(kd_benchmark::result const& row,
+                             std::vector<Point> const& data, typename indexes<Point>::rtree_type & result)
+    {
+        typedef typename indexes<Point>::rtree_type rtree_type;
+
+        std::vector<double> times;
+        std::size_t rss = 0;
+        for ( std::size_t i = 0 ; i < m_options.repeat ; ++i )
+        {
+            result.clear();
+            kd_benchmark::reset_peak_rss();
+            std::size_t const rss_before = kd_benchmark::peak_rss();
+
+            steady_clock_t::time_point start = steady_clock_t::now();
+            rtree_type rt(data.begin(), data.end());
+            result.swap(rt);
+            times.push_back(ns_t(steady_clock_t::now() - start).count());
+
+            rss = (std::max)(rss, kd_benchmark::peak_rss() - rss_before);
+        }
+        add_build(row, "rtree", times, rss);
+    }
+
+    // the results of the queries are stored in checks and compared with the reference if passed,
+    // if the factor is greater than 1 the results in [reference, reference * factor] are correct,
+    // e.g. the comparable distances of the approximate nearest queries
+    template <typename Point>
+    void measure_queries(kd_benchmark::result row, std::string const& algorithm, query_kind kind,
+                         indexes<Point> const& idx, std::vector<Point> const& queries,
+                         std::vector<double> & checks, std::vector<double> const* reference,
+                         double factor = 1)
+    {
+        std::vector<double> times;
+        query_buffers<Point> buffers;
+        times.reserve(queries.size());
+        checks.resize(queries.size());
+
+        double total = 0;
+        for ( std::size_t i = 0 ; i < queries.size() ; ++i )
+        {
+            steady_clock_t::time_point start = steady_clock_t::now();
+            checks[i] = run_query(kind, idx, queries[i], buffers);
+            double const t = ns_t(steady_clock_t::now() - start).count();
+            times.push_back(t);
+            total += t;
+
+            if ( reference && (*reference)[i] != checks[i]
+              && ( factor <= 1 || checks[i] < (*reference)[i] || checks[i] > (*reference)[i] * factor ) )
+                ++row.errors;
+        }
+
+        row.algorithm = algorithm;
+        row.operation = "query";
+        row.count = queries.size();
+        kd_benchmark::percentiles(times, row.median_ns, row.p99_ns);
+        row.throughput = total > 0 ? double(queries.size()) / total * 1e9 : 0;
+        count_queries(row, kind, idx, queries);
+        m_results.push_back(row);
+    }
+
+    // the whole batch is measured, the times are the averages per query
+    template <typename Point>
+    void measure_batch(kd_benchmark::result row, std::string const& algorithm,
+                       std::vector<Point> const& index, std::vector<Point> const& queries,
+                       typename batch_function<Point>::type batch,
+                       std::vector<double> const& reference)
+    {
+        if ( queries.empty() )
+            return;
+
+        bgi::detail::kd_task_pool pool;
+        std::vector<Point> results(queries.size());
+        std::vector<double> times;
+
+        double total = 0;
+        for ( std::size_t i = 0 ; i < m_options.repeat ; ++i )
+        {
+            steady_clock_t::time_point start = steady_clock_t::now();
+            batch(index.begin(), index.end(), queries.begin(), queries.end(), results.begin(),
+                  pool, BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_BATCH_CHUNK);
+            double const t = ns_t(steady_clock_t::now() - start).count();
+            times.push_back(t / double(queries.size()));
+            total += t;
+        }
+
+        for ( std::size_t i = 0 ; i < queries.size() ; ++i )
+        {
+            if ( reference[i] != double(bg::comparable_distance(queries[i], results[i])) )
+                ++row.errors;
+        }
+
+        row.algorithm = algorithm;
+        row.operation = "batch";
+        row.count = queries.size();
+        kd_benchmark::percentiles(times, row.median_ns, row.p99_ns);
+        row.throughput = total > 0 ? double(queries.size() * m_options.repeat) / total * 1e9 : 0;
+        m_results.push_back(row);
+    }
+
+    // the counters are gathered in a separate pass so the times aren't affected
+    template <typename Point>
+    static void count_queries(kd_benchmark::result & row, query_kind kind,
+                              indexes<Point> const& idx, std::vector<Point> const& queries)
+    {
+        bgi::detail::kd_traversal_counters & counters = bgi::detail::kd_thread_stats::local();
+        counters.reset();
+
+        for ( std::size_t i = 0 ; i < queries.size() ; ++i )
+        {
+            if ( ! run_query_counted(kind, idx, queries[i]) )
+                return;
+        }
+
+        if ( queries.empty() )
+            return;
+
+        double const n = double(queries.size());
+        row.nodes = double(counters.nodes) / n;
+        row.leaf_values = double(counters.leaf_values) / n;
+        row.distances = double(counters.distances) / n;
+        row.prunes = double(counters.prunes) / n;
+        row.max_depth = counters.max_depth;
+    }
+
+    options const& m_options;
+    std::vector<kd_benchmark::result> m_results;
+};
+
+// ---------------------------------------------------------------------- //
+
+template <typename T, std::size_t D = 2>
+struct dispatch_dimension
+{
+    static inline void apply(runner & r, std::string const& distribution, std::size_t size,
+                             std::size_t dimension, std::string const& coordinate)
+    {
+        if ( dimension == D )
+            r.run< bg::model::point<T, D, bg::cs::cartesian> >(distribution, size, coordinate);
+        else
+            dispatch_dimension<T, D+1>::apply(r, distribution, size, dimension, coordinate);
+    }
+};
+
+template <typename T>
+struct dispatch_dimension<T, 9>
+{
+    static inline void apply(runner & , std::string const& , std::size_t ,
+                             std::size_t dimension, std::string const& )
+    {
+        throw std::invalid_argument("unsupported dimension " + boost::lexical_cast<std::string>(dimension));
+    }
+};
+
+void run(runner & r, std::string const& distribution, std::size_t size,
+         std::size_t dimension, std::string const& coordinate)
+{
+    if ( coordinate == "float" )
+        dispatch_dimension<float>::apply(r, distribution, size, dimension, coordinate);
+    else if ( coordinate == "double" )
+        dispatch_dimension<double>::apply(r, distribution, size, dimension, coordinate);
+    else if ( coordinate == "int32" )
+        dispatch_dimension<boost::int32_t>::apply(r, distribution, size, dimension, coordinate);
+    else
+        throw std::invalid_argument("unknown coordinate type " + coordinate);
+}
+
+void write(std::ostream & os, options const& opt, std::vector<kd_benchmark::result> const& results)
+{
+    if ( opt.format == "csv" )
+    {
+        kd_benchmark::write_csv_header(os);
+        BOOST_FOREACH(kd_benchmark::result const& r, results)
+            kd_benchmark::write_csv(os, r);
+    }
+    else
+    {
+        os << "[\n";
+        for ( std::size_t i = 0 ; i < results.size() ; ++i )
+        {
+            os << "  ";
+            kd_benchmark::write_json(os, results[i]);
+            os << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        os << "]\n";
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    options opt;
+
+    try
+    {
+        for ( int i = 1 ; i + 1 < argc ; i += 2 )
+        {
+            std::string const name = argv[i];
+            std::string const value = argv[i + 1];
+            if ( name == "--distributions" )
+                opt.distributions = split_list<std::string>(value);
+            else if ( name == "--sizes" )
+                opt.sizes = split_list<std::size_t>(value);
+            else if ( name == "--dimensions" )
+                opt.dimensions = split_list<std::size_t>(value);
+            else if ( name == "--coordinates" )
+                opt.coordinates = split_list<std::string>(value);
+            else if ( name == "--queries" )
+                opt.queries = boost::lexical_cast<std::size_t>(value);
+            else if ( name == "--repeat" )
+                opt.repeat = (std::max)(boost::lexical_cast<std::size_t>(value), std::size_t(1));
+            else if ( name == "--format" )
+                opt.format = value;
+            else if ( name == "--output" )
+                opt.output = value;
+            else
+                throw std::invalid_argument("unknown option " + name);
+        }
+        if ( argc % 2 == 0 )
+            throw std::invalid_argument("missing value of " + std::string(argv[argc - 1]));
+        if ( opt.format != "json" && opt.format != "csv" )
+            throw std::invalid_argument("unknown format " + opt.format);
+
+        runner r(opt);
+        BOOST_FOREACH(std::string const& coordinate, opt.coordinates)
+        BOOST_FOREACH(std::size_t dimension, opt.dimensions)
+        BOOST_FOREACH(std::string const& distribution, opt.distributions)
+        BOOST_FOREACH(std::size_t size, opt.sizes)
+        {
+            run(r, distribution, size, dimension, coordinate);
+        }
+
+        if ( opt.output.empty() )
+        {
+            write(std::cout, opt, r.results());
+        }
+        else
+        {
+            std::ofstream file(opt.output.c_str());
+            write(file, opt, r.results());
+            if ( ! file )
+                throw std::runtime_error("can't write " + opt.output);
+        }
+    }
+    catch ( std::exception const& e )
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
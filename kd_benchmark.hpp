@@ -0,0 +1,127 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef KD_BENCHMARK_HPP
+#define KD_BENCHMARK_HPP
+
+// The utilities shared by kd_sort.cpp and kd_benchmark.cpp
+
+#include <algorithm>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace kd_benchmark {
+
+// the peak resident set size, available only on Linux
+// the peak is reset to the current resident set size
+inline void reset_peak_rss()
+{
+#ifdef __linux__
+    std::ofstream f("/proc/self/clear_refs");
+    f << "5";
+#endif
+}
+
+// in kB, 0 if not available
+inline std::size_t peak_rss()
+{
+#ifdef __linux__
+    std::ifstream f("/proc/self/status");
+    std::string line;
+    while ( std::getline(f, line) )
+    {
+        if ( line.compare(0, 6, "VmHWM:") == 0 )
+        {
+            std::istringstream ss(line.substr(6));
+            std::size_t kb = 0;
+            ss >> kb;
+            return kb;
+        }
+    }
+#endif
+    return 0;
+}
+
+// the median and the 99th percentile of the samples, the samples are sorted
+inline void percentiles(std::vector<double> & samples, double & median, double & p99)
+{
+    median = p99 = 0;
+    if ( samples.empty() )
+        return;
+
+    std::sort(samples.begin(), samples.end());
+    median = samples[samples.size() / 2];
+    p99 = samples[(samples.size() * 99 + 99) / 100 - 1];
+}
+
+// One measured operation, a row of the report
+struct result
+{
+    result()
+        : size(0), dimension(0), count(0)
+        , median_ns(0), p99_ns(0), throughput(0)
+        , peak_rss_kb(0), errors(0)
+        , nodes(0), leaf_values(0), distances(0), prunes(0), max_depth(0)
+    {}
+
+    std::string distribution;
+    std::size_t size;
+    std::size_t dimension;
+    std::string coordinate;
+    std::string algorithm;
+    std::string operation;      // "build", "query" or "batch"
+    std::size_t count;          // the number of measured repetitions or queries
+    double median_ns;           // per build or per query
+    double p99_ns;
+    double throughput;          // values per second for builds, queries per second for queries
+    std::size_t peak_rss_kb;    // the increase of the peak RSS during the builds
+    std::size_t errors;         // the results different than the reference ones
+    // the traversal counters of the instrumented queries, per query, see kd_traversal_stats.hpp
+    double nodes;
+    double leaf_values;
+    double distances;
+    double prunes;
+    std::size_t max_depth;      // the maximum for all of the queries
+};
+
+inline void write_csv_header(std::ostream & os)
+{
+    os << "distribution,size,dimension,coordinate,algorithm,operation,count,"
+          "median_ns,p99_ns,throughput,peak_rss_kb,errors,"
+          "nodes,leaf_values,distances,prunes,max_depth\n";
+}
+
+inline void write_csv(std::ostream & os, result const& r)
+{
+    os << r.distribution << ',' << r.size << ',' << r.dimension << ',' << r.coordinate << ','
+       << r.algorithm << ',' << r.operation << ',' << r.count << ','
+       << r.median_ns << ',' << r.p99_ns << ',' << r.throughput << ','
+       << r.peak_rss_kb << ',' << r.errors << ','
+       << r.nodes << ',' << r.leaf_values << ',' << r.distances << ','
+       << r.prunes << ',' << r.max_depth << '\n';
+}
+
+// the names contain only the identifier-like characters so aren't escaped
+inline void write_json(std::ostream & os, result const& r)
+{
+    os << "{\"distribution\": \"" << r.distribution << "\", \"size\": " << r.size
+       << ", \"dimension\": " << r.dimension << ", \"coordinate\": \"" << r.coordinate
+       << "\", \"algorithm\": \"" << r.algorithm << "\", \"operation\": \"" << r.operation
+       << "\", \"count\": " << r.count
+       << ", \"median_ns\": " << r.median_ns << ", \"p99_ns\": " << r.p99_ns
+       << ", \"throughput\": " << r.throughput
+       << ", \"peak_rss_kb\": " << r.peak_rss_kb << ", \"errors\": " << r.errors
+       << ", \"nodes\": " << r.nodes << ", \"leaf_values\": " << r.leaf_values
+       << ", \"distances\": " << r.distances << ", \"prunes\": " << r.prunes
+       << ", \"max_depth\": " << r.max_depth << "}";
+}
+
+} // namespace kd_benchmark
+
+#endif // KD_BENCHMARK_HPP
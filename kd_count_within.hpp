@@ -0,0 +1,356 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_COUNT_WITHIN_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_COUNT_WITHIN_HPP
+
+#include <vector>
+
+#include "kd_sort.hpp"
+#include "kd_sort_spread.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// The aggregate of the values of some elements, the min and max are defined
+// only if count > 0
+template <typename T>
+struct kd_aggregate
+{
+    kd_aggregate()
+        : count(0), sum(0), min(0), max(0)
+    {}
+
+    inline void add(T const& v)
+    {
+        if ( count == 0 )
+        {
+            min = max = v;
+        }
+        else
+        {
+            if ( v < min )
+                min = v;
+            if ( max < v )
+                max = v;
+        }
+        sum += v;
+        ++count;
+    }
+
+    inline void add(kd_aggregate const& other)
+    {
+        if ( other.count == 0 )
+            return;
+
+        if ( count == 0 )
+        {
+            min = other.min;
+            max = other.max;
+        }
+        else
+        {
+            if ( other.min < min )
+                min = other.min;
+            if ( max < other.max )
+                max = other.max;
+        }
+        sum += other.sum;
+        count += other.count;
+    }
+
+    std::size_t count;
+    T sum;
+    T min;
+    T max;
+};
+
+// The aggregates of the subranges of the nodes of the kd_sort() layout,
+// including the leaves. The nodes are numbered like in kd_split_axes.
+template <typename T>
+class kd_node_aggregates
+{
+public:
+    typedef T value_type;
+    typedef kd_aggregate<T> aggregate_type;
+
+    // the nodes are [1, nodes_count)
+    inline void reset(std::size_t nodes_count)
+    {
+        m_aggregates.assign(nodes_count, aggregate_type());
+    }
+
+    inline std::size_t nodes_count() const
+    {
+        return m_aggregates.size();
+    }
+
+    inline aggregate_type const& operator[](std::size_t node) const
+    {
+        BOOST_ASSERT(node < m_aggregates.size());
+        return m_aggregates[node];
+    }
+
+    inline aggregate_type & operator[](std::size_t node)
+    {
+        BOOST_ASSERT(node < m_aggregates.size());
+        return m_aggregates[node];
+    }
+
+private:
+    std::vector<aggregate_type> m_aggregates;
+};
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_build_aggregates_impl
+{
+    template <typename It, typename T, typename ValueFunction>
+    static inline void apply(It first, It last, std::size_t node,
+                             kd_node_aggregates<T> & aggregates, ValueFunction const& value_function)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        kd_aggregate<T> & aggregate = aggregates[node];
+
+        if ( size > ValuesMin )
+        {
+            std::size_t lsize = size / 2;
+            It nth = first + lsize;
+
+            apply(first, nth, 2 * node, aggregates, value_function);
+            apply(nth+1, last, 2 * node + 1, aggregates, value_function);
+
+            aggregate.add(static_cast<T>(value_function(*nth)));
+            aggregate.add(aggregates[2 * node]);
+            aggregate.add(aggregates[2 * node + 1]);
+        }
+        else
+        {
+            for ( ; first != last ; ++first )
+            {
+                aggregate.add(static_cast<T>(value_function(*first)));
+            }
+        }
+    }
+};
+
+// Calculates the aggregates of the values returned by the value_function
+// for the elements of the range sorted with kd_sort(), e.g. the weights of
+// the Points. The sum, min and max of any subtree are then known in O(1)
+// by kd_aggregate_within().
+template <std::size_t ValuesMin, typename RandomIt, typename T, typename ValueFunction>
+inline void kd_build_aggregates(RandomIt first, RandomIt last,
+                                kd_node_aggregates<T> & aggregates, ValueFunction const& value_function)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+
+    std::size_t const size = static_cast<std::size_t>(std::distance(first, last));
+    // the leaves are the children of the split nodes or the root
+    aggregates.reset(2 * kd_split_axes_nodes_count<ValuesMin>(size));
+    if ( size > 0 )
+    {
+        kd_build_aggregates_impl<point_type, ValuesMin>::apply(first, last, 1, aggregates, value_function);
+    }
+}
+
+template <typename RandomIt, typename T, typename ValueFunction>
+inline void kd_build_aggregates(RandomIt first, RandomIt last,
+                                kd_node_aggregates<T> & aggregates, ValueFunction const& value_function)
+{
+    kd_build_aggregates<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, aggregates, value_function);
+}
+
+// ---------------------------------------------------------------------- //
+
+// The region of a node is bounded by the medians of its ancestors. The bits
+// of covered are set for the sides of the region inside the box, the lower
+// and upper one for each axis. If all of them are set the whole subtree is
+// in the box and is passed to the visitor at once. So no coordinates are
+// stored, only the size of the subrange or the precalculated aggregate of
+// the node is needed.
+// Only the Points are supported, see kd_query_within_impl.
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_count_within_impl
+{
+    BOOST_MPL_ASSERT_MSG((boost::is_same<typename geometry::tag<Point>::type, point_tag>::value),
+                         NOT_IMPLEMENTED_FOR_THIS_VALUE_TYPE, (Point));
+
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+    static const std::size_t all_covered = (std::size_t(1) << (2 * dimension<Point>::value)) - 1;
+    static const std::size_t min_covered = std::size_t(1) << (2 * I);
+    static const std::size_t max_covered = std::size_t(1) << (2 * I + 1);
+
+    template <typename It, typename Box, typename Visitor>
+    static inline void per_branch(It first, It last, std::size_t node, Box const& box,
+                                  std::size_t covered, Visitor & visitor)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size == 0 )
+        {
+            return;
+        }
+        else if ( covered == all_covered )
+        {
+            visitor.subtree(first, last, node);
+        }
+        else if ( size > ValuesMin )
+        {
+            kd_count_within_impl<Point, next_dimension, ValuesMin>::apply(first, last, node, box, covered, visitor);
+        }
+        else
+        {
+            for ( ; first != last ; ++first )
+            {
+                if ( geometry::covered_by(*first, box) )
+                {
+                    visitor.value(*first);
+                }
+            }
+        }
+    }
+
+    template <typename It, typename Box, typename Visitor>
+    static inline void apply(It first, It last, std::size_t node, Box const& box,
+                             std::size_t covered, Visitor & visitor)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        It nth = first + lsize;
+
+        if ( geometry::covered_by(*nth, box) )
+        {
+            visitor.value(*nth);
+        }
+
+        bool const not_less = ! kd_less<I>(*nth, box);
+        bool const not_greater = ! kd_less<I>(box, *nth);
+
+        // the values in the left half are not greater than the median on axis I
+        // so their region is bounded by the median from above
+        if ( not_less )
+        {
+            per_branch(first, nth, 2 * node, box,
+                       not_greater ? (covered | max_covered) : covered,
+                       visitor);
+        }
+        // analogically the values in the right half are bounded from below
+        if ( not_greater )
+        {
+            per_branch(nth+1, last, 2 * node + 1, box,
+                       not_less ? (covered | min_covered) : covered,
+                       visitor);
+        }
+    }
+};
+
+struct kd_count_visitor
+{
+    kd_count_visitor() : count(0) {}
+
+    template <typename It>
+    inline void subtree(It first, It last, std::size_t )
+    {
+        count += static_cast<std::size_t>(std::distance(first, last));
+    }
+
+    template <typename Value>
+    inline void value(Value const& )
+    {
+        ++count;
+    }
+
+    std::size_t count;
+};
+
+template <typename T, typename ValueFunction>
+struct kd_aggregate_visitor
+{
+    kd_aggregate_visitor(kd_node_aggregates<T> const& a, ValueFunction const& vf)
+        : aggregates(a), value_function(vf)
+    {}
+
+    template <typename It>
+    inline void subtree(It , It , std::size_t node)
+    {
+        result.add(aggregates[node]);
+    }
+
+    template <typename Value>
+    inline void value(Value const& v)
+    {
+        result.add(static_cast<T>(value_function(v)));
+    }
+
+    kd_node_aggregates<T> const& aggregates;
+    ValueFunction const& value_function;
+    kd_aggregate<T> result;
+};
+
+// ---------------------------------------------------------------------- //
+
+// returns the number of values covered by the box, the same as the number
+// returned by kd_query_within() but the subtrees inside the box aren't traversed
+template <std::size_t ValuesMin, typename RandomIt, typename Box>
+inline std::size_t kd_count_within(RandomIt first, RandomIt last, Box const& box)
+{
+    if ( std::distance(first, last) < 1 )
+        return 0;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+
+    kd_count_visitor visitor;
+    // the root is the branch of a node on the last axis
+    kd_count_within_impl<point_type, dimension<point_type>::value - 1, ValuesMin>
+        ::per_branch(first, last, 1, box, 0, visitor);
+
+    return visitor.count;
+}
+
+template <typename RandomIt, typename Box>
+inline std::size_t kd_count_within(RandomIt first, RandomIt last, Box const& box)
+{
+    return kd_count_within<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, box);
+}
+
+// returns the aggregate of the values of the elements covered by the box
+// the aggregates must be built by kd_build_aggregates() with the same
+// value_function and ValuesMin
+template <std::size_t ValuesMin, typename RandomIt, typename Box, typename T, typename ValueFunction>
+inline kd_aggregate<T> kd_aggregate_within(RandomIt first, RandomIt last, Box const& box,
+                                           kd_node_aggregates<T> const& aggregates,
+                                           ValueFunction const& value_function)
+{
+    kd_aggregate_visitor<T, ValueFunction> visitor(aggregates, value_function);
+
+    if ( std::distance(first, last) < 1 )
+        return visitor.result;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+
+    // the root is the branch of a node on the last axis
+    kd_count_within_impl<point_type, dimension<point_type>::value - 1, ValuesMin>
+        ::per_branch(first, last, 1, box, 0, visitor);
+
+    return visitor.result;
+}
+
+template <typename RandomIt, typename Box, typename T, typename ValueFunction>
+inline kd_aggregate<T> kd_aggregate_within(RandomIt first, RandomIt last, Box const& box,
+                                           kd_node_aggregates<T> const& aggregates,
+                                           ValueFunction const& value_function)
+{
+    return kd_aggregate_within<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, box, aggregates, value_function);
+}
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_COUNT_WITHIN_HPP
@@ -0,0 +1,381 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_DYNAMIC_INDEX_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_DYNAMIC_INDEX_HPP
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "kd_sort.hpp"
+#include "kd_tombstones.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// The values are stored in kd_sort()ed runs of sizes being the powers of 2
+// (Bentley-Saxe logarithmic method). The run of size 2^i exists if the i-th bit
+// of the number of values is set. An insertion merges the runs the same way
+// as the binary addition carries the bits, then the merged runs are sorted
+// again. Each value is moved to a greater run at most log(n) times so the
+// amortized insertion cost is O(log^2 n).
+// The queries are performed for each run, sharing the pruning bound. The runs
+// further than the bound are skipped using their envelopes. The nearest queries
+// visit the runs in the order of the distances to their envelopes so the bound
+// is small early and the remaining runs are skipped at once. The runs without
+// erased values are traversed by kd_nearest_impl like the static ranges.
+// If the values are inserted in the spatial order, e.g. along a path, the
+// envelopes barely overlap and most of the runs are skipped. If the values are
+// inserted in random order all envelopes contain the point and no run is
+// skipped, so the query is slower than kd_nearest() of one kd_sort()ed range.
+// The erased values are marked in the tombstones of their runs. If the fraction
+// of the dead values of a run exceeds the threshold the alive values of this run
+// are removed and inserted again. The dead values of the merged runs are dropped
+// by the insertions.
+template <typename Value>
+class kd_dynamic_index
+{
+public:
+    typedef Value value_type;
+    typedef std::vector<Value> run_type;
+    typedef typename run_type::const_iterator const_iterator;
+    typedef typename geometry::default_comparable_distance_result<Value>::type cdist_type;
+    typedef typename geometry::point_type<Value>::type point_type;
+    typedef geometry::model::box<point_type> box_type;
+
+    explicit kd_dynamic_index(double max_dead_fraction = 0.5)
+        : m_size(0)
+        , m_dead_count(0)
+        , m_max_dead_fraction(max_dead_fraction)
+    {}
+
+    void insert(Value const& value)
+    {
+        insert(&value, &value + 1);
+    }
+
+    template <typename It>
+    void insert(It first, It last)
+    {
+        std::size_t const count = static_cast<std::size_t>(std::distance(first, last));
+        if ( count < 1 )
+            return;
+
+        // the runs above the highest changed bit are not modified
+        std::size_t levels = 0;
+        for ( std::size_t changed = m_size ^ (m_size + count) ; changed > 0 ; changed >>= 1 )
+            ++levels;
+        if ( m_runs.size() < levels )
+        {
+            m_runs.resize(levels);
+            m_boxes.resize(levels);
+            m_tombstones.resize(levels);
+        }
+
+        // the merged values are fewer than 2^levels even if there are no dead values
+        run_type merged(first, last);
+        std::size_t new_size = m_size;
+        for ( std::size_t i = 0 ; i < levels ; ++i )
+        {
+            run_type & r = m_runs[i];
+            for ( std::size_t j = 0 ; j < r.size() ; ++j )
+            {
+                if ( ! m_tombstones[i].is_dead(j) )
+                    merged.push_back(r[j]);
+            }
+            new_size -= r.size();
+            m_dead_count -= m_tombstones[i].dead_count();
+            run_type().swap(r);
+            m_tombstones[i].reset(0);
+        }
+        new_size += merged.size();
+
+        for ( std::size_t i = levels ; i-- > 0 ; )
+        {
+            std::size_t const run_size = std::size_t(1) << i;
+            if ( new_size & run_size )
+            {
+                m_runs[i].assign(merged.end() - run_size, merged.end());
+                merged.resize(merged.size() - run_size);
+                kd_sort(m_runs[i].begin(), m_runs[i].end());
+                m_tombstones[i].reset(run_size);
+                geometry::envelope(m_runs[i].front(), m_boxes[i]);
+                for ( const_iterator it = m_runs[i].begin() + 1 ; it != m_runs[i].end() ; ++it )
+                    geometry::expand(m_boxes[i], *it);
+            }
+        }
+
+        BOOST_ASSERT(merged.empty());
+        m_size = new_size;
+    }
+
+    // marks one value equal to the passed one as erased, returns false if there is none
+    template <typename V>
+    bool erase(V const& value)
+    {
+        for ( std::size_t i = m_runs.size() ; i-- > 0 ; )
+        {
+            run_type const& r = m_runs[i];
+            if ( r.empty() || ! geometry::covered_by(value, m_boxes[i]) )
+                continue;
+
+            if ( kd_erase(r.begin(), r.end(), m_tombstones[i], value) )
+            {
+                ++m_dead_count;
+                if ( m_tombstones[i].dead_fraction() > m_max_dead_fraction )
+                    rebuild(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // the number of alive values
+    std::size_t size() const
+    {
+        return m_size - m_dead_count;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    // the number of erased values still stored in the runs
+    std::size_t dead_count() const
+    {
+        return m_dead_count;
+    }
+
+    void clear()
+    {
+        m_runs.clear();
+        m_boxes.clear();
+        m_tombstones.clear();
+        m_size = 0;
+        m_dead_count = 0;
+    }
+
+    std::size_t levels() const
+    {
+        return m_runs.size();
+    }
+
+    // the run of size 2^level, empty if the level-th bit of the size is not set
+    // the erased values are still stored in the run
+    run_type const& run(std::size_t level) const
+    {
+        return m_runs[level];
+    }
+
+    kd_tombstones const& tombstones(std::size_t level) const
+    {
+        return m_tombstones[level];
+    }
+
+    template <typename V>
+    bool binary_search(V const& value) const
+    {
+        for ( std::size_t i = m_runs.size() ; i-- > 0 ; )
+        {
+            if ( ! m_runs[i].empty()
+              && geometry::covered_by(value, m_boxes[i])
+              && kd_binary_search(m_runs[i].begin(), m_runs[i].end(), m_tombstones[i], value) )
+                return true;
+        }
+        return false;
+    }
+
+    template <typename Point>
+    bool nearest(Point const& point, Value & result) const
+    {
+        if ( empty() )
+            return false;
+
+        run_distance order[max_levels];
+        std::size_t const count = runs_by_distance(point, order);
+
+        kd_nearest_one_result<const_iterator, cdist_type> nearest;
+        for ( std::size_t j = 0 ; j < count ; ++j )
+        {
+            // the following runs are further
+            if ( nearest.is_full() && ! (order[j].first < nearest.greatest_cdist()) )
+                break;
+
+            std::size_t const i = order[j].second;
+            run_type const& r = m_runs[i];
+            bool found_exact = false;
+            if ( m_tombstones[i].dead_count() == 0 )
+            {
+                const_iterator it = nearest.is_full() ? nearest.it() : r.begin();
+                cdist_type cdist = nearest.is_full() ? nearest.greatest_cdist()
+                                                     : geometry::comparable_distance(point, *it);
+                found_exact = kd_nearest_impl<Value>::apply(r.begin(), r.end(), point, it, cdist);
+                nearest.update(it, cdist);
+            }
+            else
+            {
+                kd_alive_result<kd_nearest_one_result<const_iterator, cdist_type>, const_iterator>
+                    alive(nearest, r.begin(), m_tombstones[i]);
+                found_exact = kd_nearest_k_impl<Value>::apply(r.begin(), r.end(), point, alive);
+            }
+
+            if ( found_exact )
+                break;
+        }
+
+        if ( ! nearest.is_full() )
+            return false;
+
+        result = *nearest.it();
+
+        return true;
+    }
+
+    // writes at most k closest values sorted by distance, returns the number of values written
+    template <typename Point, typename OutIt>
+    std::size_t nearest(Point const& point, std::size_t k, OutIt out_it) const
+    {
+        if ( empty() || k < 1 )
+            return 0;
+
+        run_distance order[max_levels];
+        std::size_t const count = runs_by_distance(point, order);
+
+        kd_nearest_k_result<const_iterator, cdist_type> result(k, size());
+        for ( std::size_t j = 0 ; j < count ; ++j )
+        {
+            // the following runs are further
+            if ( result.is_full() && ! (order[j].first < result.greatest_cdist()) )
+                break;
+
+            if ( nearest_in_run(order[j].second, point, result) )
+                break;
+        }
+
+        result.finish(out_it);
+
+        return result.size();
+    }
+
+    // writes the values covered by the box, returns the number of values written
+    // only the Points are supported, see kd_query_within_impl
+    template <typename Box, typename OutIt>
+    std::size_t query_within(Box const& box, OutIt out_it) const
+    {
+        std::size_t count = 0;
+        for ( std::size_t i = m_runs.size() ; i-- > 0 ; )
+        {
+            run_type const& r = m_runs[i];
+            if ( r.empty() || ! geometry::intersects(box, m_boxes[i]) )
+                continue;
+
+            if ( m_tombstones[i].dead_count() == 0 )
+                kd_query_within_impl<Value>::apply(r.begin(), r.end(), box, out_it, count);
+            else
+                kd_query_within_impl<Value, 0, BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN, kd_alive_filter<const_iterator> >
+                    ::apply(r.begin(), r.end(), box, out_it, count, kd_alive_filter<const_iterator>(r.begin(), m_tombstones[i]));
+        }
+        return count;
+    }
+
+    // writes the (value, comparable distance) pairs of the values within the distance
+    // from the point, returns the number of values written
+    // only the Points are supported, see kd_within_distance_impl
+    template <typename Point, typename Distance, typename OutIt>
+    std::size_t within_distance(Point const& point, Distance const& distance, OutIt out_it) const
+    {
+        cdist_type max_cdist = distance;
+        max_cdist *= max_cdist;
+
+        std::size_t count = 0;
+        for ( std::size_t i = m_runs.size() ; i-- > 0 ; )
+        {
+            run_type const& r = m_runs[i];
+            if ( r.empty() || max_cdist < geometry::comparable_distance(point, m_boxes[i]) )
+                continue;
+
+            if ( m_tombstones[i].dead_count() == 0 )
+                kd_within_distance_impl<Value>::apply(r.begin(), r.end(), point, max_cdist, out_it, count);
+            else
+                kd_within_distance_impl<Value, 0, BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN, kd_alive_filter<const_iterator> >
+                    ::apply(r.begin(), r.end(), point, max_cdist, out_it, count, kd_alive_filter<const_iterator>(r.begin(), m_tombstones[i]));
+        }
+        return count;
+    }
+
+private:
+    static const std::size_t max_levels = sizeof(std::size_t) * 8;
+    typedef std::pair<cdist_type, std::size_t> run_distance;
+
+    // writes the (comparable distance to the envelope, level) pairs of the non-empty
+    // runs sorted by distance, returns the number of runs
+    template <typename Point>
+    std::size_t runs_by_distance(Point const& point, run_distance * order) const
+    {
+        std::size_t count = 0;
+        for ( std::size_t i = m_runs.size() ; i-- > 0 ; )
+        {
+            if ( ! m_runs[i].empty() )
+                order[count++] = run_distance(geometry::comparable_distance(point, m_boxes[i]), i);
+        }
+        // the greater run first if the distances are equal, e.g. if the point is inside both
+        std::stable_sort(order, order + count, less_distance);
+        return count;
+    }
+
+    static inline bool less_distance(run_distance const& l, run_distance const& r)
+    {
+        return l.first < r.first;
+    }
+
+    // returns true if nothing closer may be found
+    template <typename Point, typename Result>
+    bool nearest_in_run(std::size_t i, Point const& point, Result & result) const
+    {
+        run_type const& r = m_runs[i];
+
+        if ( m_tombstones[i].dead_count() == 0 )
+            return kd_nearest_k_impl<Value>::apply(r.begin(), r.end(), point, result);
+
+        kd_alive_result<Result, const_iterator> alive(result, r.begin(), m_tombstones[i]);
+        return kd_nearest_k_impl<Value>::apply(r.begin(), r.end(), point, alive);
+    }
+
+    // removes the run and inserts its alive values again
+    void rebuild(std::size_t i)
+    {
+        run_type alive;
+        alive.reserve(m_runs[i].size() - m_tombstones[i].dead_count());
+        for ( std::size_t j = 0 ; j < m_runs[i].size() ; ++j )
+        {
+            if ( ! m_tombstones[i].is_dead(j) )
+                alive.push_back(m_runs[i][j]);
+        }
+
+        m_size -= m_runs[i].size();
+        m_dead_count -= m_tombstones[i].dead_count();
+        run_type().swap(m_runs[i]);
+        m_tombstones[i].reset(0);
+
+        insert(alive.begin(), alive.end());
+    }
+
+    std::vector<run_type> m_runs;
+    std::vector<box_type> m_boxes; // the envelopes of the runs
+    std::vector<kd_tombstones> m_tombstones;
+    std::size_t m_size; // the number of values stored in the runs, including the dead ones
+    std::size_t m_dead_count;
+    double m_max_dead_fraction;
+};
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_DYNAMIC_INDEX_HPP
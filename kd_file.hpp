@@ -0,0 +1,268 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_FILE_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_FILE_HPP
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/type_traits/has_trivial_copy.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
+
+#include <boost/geometry.hpp>
+
+#include "kd_sort.hpp"
+#include "kd_sort_blocked.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// The file contains the header followed by the elements stored exactly as
+// in memory, starting at the offset aligned to kd_file_alignment. So the mapped
+// elements may be passed directly to the queries, e.g.
+//   kd_mapped_file<P> file("index.kd", kd_file_layout_kd_sort);
+//   kd_nearest(file.begin(), file.end(), point, result);
+// The files are not portable between the platforms with different endianness,
+// floating point formats or padding of the elements. This is checked when
+// the file is opened. The layout and its parameters the file is going to be
+// queried with are checked as well since the queries of a different layout,
+// ValuesMin or BlockHeight silently return wrong results.
+
+enum kd_file_layout
+{
+    kd_file_layout_kd_sort = 1,
+    kd_file_layout_left_balanced = 2,
+    kd_file_layout_blocked = 3
+};
+
+enum kd_file_coordinate
+{
+    kd_file_coordinate_unknown = 0,
+    kd_file_coordinate_float = 1,
+    kd_file_coordinate_double = 2,
+    kd_file_coordinate_int32 = 3,
+    kd_file_coordinate_int64 = 4,
+    kd_file_coordinate_long_double = 5
+};
+
+template <typename T> struct kd_file_coordinate_code
+{ static const boost::uint32_t value = kd_file_coordinate_unknown; };
+template <> struct kd_file_coordinate_code<float>
+{ static const boost::uint32_t value = kd_file_coordinate_float; };
+template <> struct kd_file_coordinate_code<double>
+{ static const boost::uint32_t value = kd_file_coordinate_double; };
+template <> struct kd_file_coordinate_code<long double>
+{ static const boost::uint32_t value = kd_file_coordinate_long_double; };
+template <> struct kd_file_coordinate_code<boost::int32_t>
+{ static const boost::uint32_t value = kd_file_coordinate_int32; };
+template <> struct kd_file_coordinate_code<boost::int64_t>
+{ static const boost::uint32_t value = kd_file_coordinate_int64; };
+
+static const boost::uint32_t kd_file_version = 1;
+static const boost::uint32_t kd_file_byte_order = 0x01020304;
+static const std::size_t kd_file_alignment = 64;
+
+struct kd_file_header
+{
+    char magic[8];                    // "KDSORT\0\0"
+    boost::uint32_t version;          // kd_file_version
+    boost::uint32_t byte_order;       // kd_file_byte_order written natively
+    boost::uint32_t dimension;
+    boost::uint32_t coordinate;       // kd_file_coordinate
+    boost::uint32_t is_box;           // 1 for Boxes, 0 for Points
+    boost::uint32_t value_size;       // sizeof(Value)
+    boost::uint32_t layout;           // kd_file_layout
+    boost::uint32_t values_min;       // used by kd_sort(), 0 otherwise
+    boost::uint32_t block_height;     // used by kd_sort_blocked(), 0 otherwise
+    boost::uint32_t reserved;
+    boost::uint64_t count;            // the number of elements
+    boost::uint64_t data_offset;      // the offset of the first element
+};
+
+class kd_file_error
+    : public std::runtime_error
+{
+public:
+    explicit kd_file_error(std::string const& what)
+        : std::runtime_error(what)
+    {}
+};
+
+template <typename Value>
+struct kd_file_value_traits
+{
+    BOOST_MPL_ASSERT_MSG((boost::has_trivial_copy<Value>::value && boost::has_trivial_destructor<Value>::value),
+                         VALUE_MUST_BE_TRIVIALLY_COPYABLE, (Value));
+
+    typedef typename coordinate_type<Value>::type coordinate_type;
+
+    BOOST_MPL_ASSERT_MSG((kd_file_coordinate_code<coordinate_type>::value != kd_file_coordinate_unknown),
+                         NOT_IMPLEMENTED_FOR_THIS_COORDINATE_TYPE, (coordinate_type));
+
+    static const boost::uint32_t is_box = boost::is_same<typename geometry::tag<Value>::type, box_tag>::value ? 1 : 0;
+
+    static inline kd_file_header header(std::size_t count, kd_file_layout layout,
+                                        std::size_t values_min, std::size_t block_height)
+    {
+        kd_file_header result;
+        std::memset(&result, 0, sizeof(kd_file_header));
+        std::memcpy(result.magic, "KDSORT\0\0", 8);
+        result.version = kd_file_version;
+        result.byte_order = kd_file_byte_order;
+        result.dimension = static_cast<boost::uint32_t>(dimension<Value>::value);
+        result.coordinate = kd_file_coordinate_code<coordinate_type>::value;
+        result.is_box = is_box;
+        result.value_size = static_cast<boost::uint32_t>(sizeof(Value));
+        result.layout = layout;
+        result.values_min = static_cast<boost::uint32_t>(layout_values_min(layout, values_min));
+        result.block_height = static_cast<boost::uint32_t>(layout_block_height(layout, block_height));
+        result.count = count;
+        result.data_offset = (sizeof(kd_file_header) + kd_file_alignment - 1) / kd_file_alignment * kd_file_alignment;
+        return result;
+    }
+
+    // throws kd_file_error if the elements stored in the file can't be used as Values
+    static inline void check(kd_file_header const& h, std::size_t file_size)
+    {
+        if ( std::memcmp(h.magic, "KDSORT\0\0", 8) != 0 )
+            throw kd_file_error("not a kd file");
+        if ( h.byte_order != kd_file_byte_order )
+            throw kd_file_error("invalid byte order");
+        if ( h.version != kd_file_version )
+            throw kd_file_error("unsupported version");
+        if ( h.dimension != dimension<Value>::value
+          || h.coordinate != kd_file_coordinate_code<coordinate_type>::value
+          || h.is_box != is_box
+          || h.value_size != sizeof(Value) )
+            throw kd_file_error("incompatible value type");
+        if ( h.data_offset % kd_file_alignment != 0
+          || h.data_offset < sizeof(kd_file_header)
+          || h.data_offset > file_size
+          || h.count > (file_size - h.data_offset) / sizeof(Value) )
+            throw kd_file_error("truncated file");
+    }
+
+    // throws kd_file_error if the elements stored in the file can't be queried
+    // with the algorithms of the layout using values_min and block_height
+    static inline void check(kd_file_header const& h, kd_file_layout layout,
+                             std::size_t values_min, std::size_t block_height)
+    {
+        if ( h.layout != static_cast<boost::uint32_t>(layout) )
+            throw kd_file_error("incompatible layout");
+        if ( h.values_min != layout_values_min(layout, values_min) )
+            throw kd_file_error("incompatible values_min");
+        if ( h.block_height != layout_block_height(layout, block_height) )
+            throw kd_file_error("incompatible block_height");
+    }
+
+private:
+    // only the parameters used by the layout are stored
+    static inline std::size_t layout_values_min(kd_file_layout layout, std::size_t values_min)
+    {
+        return layout == kd_file_layout_kd_sort ? values_min : 0;
+    }
+
+    // 0 is the default height, see kd_sort_blocked()
+    static inline std::size_t layout_block_height(kd_file_layout layout, std::size_t block_height)
+    {
+        if ( layout != kd_file_layout_blocked )
+            return 0;
+        return block_height != 0 ? block_height : kd_blocked_default_height<Value>::value;
+    }
+};
+
+// ---------------------------------------------------------------------- //
+
+// writes the range sorted with the algorithm corresponding to the layout
+template <typename RandomIt>
+inline void kd_file_write(std::string const& path, RandomIt first, RandomIt last,
+                          kd_file_layout layout,
+                          std::size_t values_min = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN,
+                          std::size_t block_height = 0)
+{
+    typedef typename boost::iterator_value<RandomIt>::type value_type;
+    typedef kd_file_value_traits<value_type> traits;
+
+    std::size_t const count = static_cast<std::size_t>(std::distance(first, last));
+    kd_file_header const header = traits::header(count, layout, values_min, block_height);
+
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    if ( ! file )
+        throw kd_file_error("can't create " + path);
+
+    char padding[kd_file_alignment] = {};
+    file.write(reinterpret_cast<char const*>(&header), sizeof(kd_file_header));
+    file.write(padding, static_cast<std::streamsize>(header.data_offset - sizeof(kd_file_header)));
+
+    for ( ; first != last ; ++first )
+    {
+        value_type const& v = *first;
+        file.write(reinterpret_cast<char const*>(&v), sizeof(value_type));
+    }
+
+    if ( ! file.flush() )
+        throw kd_file_error("can't write " + path);
+}
+
+// The elements of the file mapped into memory read-only.
+template <typename Value>
+class kd_mapped_file
+    : boost::noncopyable
+{
+    typedef kd_file_value_traits<Value> traits;
+
+public:
+    typedef Value value_type;
+    typedef Value const* const_iterator;
+
+    // the layout and its parameters must be the ones used to query the elements,
+    // block_height equal to 0 is the default height, see kd_sort_blocked()
+    kd_mapped_file(std::string const& path, kd_file_layout layout,
+                   std::size_t values_min = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN,
+                   std::size_t block_height = 0)
+        : m_mapping(path.c_str(), boost::interprocess::read_only)
+        , m_region(m_mapping, boost::interprocess::read_only)
+    {
+        if ( m_region.get_size() < sizeof(kd_file_header) )
+            throw kd_file_error("truncated file");
+
+        std::memcpy(&m_header, m_region.get_address(), sizeof(kd_file_header));
+        traits::check(m_header, m_region.get_size());
+        traits::check(m_header, layout, values_min, block_height);
+
+        m_first = reinterpret_cast<Value const*>(
+                    static_cast<char const*>(m_region.get_address()) + m_header.data_offset);
+    }
+
+    inline const_iterator begin() const { return m_first; }
+    inline const_iterator end() const { return m_first + m_header.count; }
+    inline std::size_t size() const { return static_cast<std::size_t>(m_header.count); }
+
+    inline kd_file_layout layout() const { return static_cast<kd_file_layout>(m_header.layout); }
+    inline std::size_t values_min() const { return m_header.values_min; }
+    inline std::size_t block_height() const { return m_header.block_height; }
+    inline kd_file_header const& header() const { return m_header; }
+
+private:
+    boost::interprocess::file_mapping m_mapping;
+    boost::interprocess::mapped_region m_region;
+    kd_file_header m_header;
+    Value const* m_first;
+};
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_FILE_HPP
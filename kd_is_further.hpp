@@ -91,6 +91,37 @@ inline bool kd_is_further(G1 const& l, G2 const& r, CDist const& smallest_cdist)
     return kd_is_further_impl<I, G1, G2>::apply(l, r, smallest_cdist);
 }
 
+// the axis known at runtime, used by the iterative traversals
+
+template <std::size_t I, std::size_t Dimension>
+struct kd_is_further_by_axis_impl
+{
+    template <typename G1, typename G2, typename CDist>
+    static inline bool apply(std::size_t axis, G1 const& l, G2 const& r, CDist const& smallest_cdist)
+    {
+        return axis == I ?
+               kd_is_further<I>(l, r, smallest_cdist) :
+               kd_is_further_by_axis_impl<I+1, Dimension>::apply(axis, l, r, smallest_cdist);
+    }
+};
+
+template <std::size_t Dimension>
+struct kd_is_further_by_axis_impl<Dimension, Dimension>
+{
+    template <typename G1, typename G2, typename CDist>
+    static inline bool apply(std::size_t , G1 const& , G2 const& , CDist const& )
+    {
+        BOOST_ASSERT(false);
+        return false;
+    }
+};
+
+template <typename G1, typename G2, typename CDist>
+inline bool kd_is_further_by_axis(std::size_t axis, G1 const& l, G2 const& r, CDist const& smallest_cdist)
+{
+    return kd_is_further_by_axis_impl<0, dimension<G1>::value>::apply(axis, l, r, smallest_cdist);
+}
+
 }}}} // namespace boost::geometry::index::detail
 
 #endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_IS_FURTHER_HPP
@@ -0,0 +1,808 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include <boost/geometry.hpp>
+#include <boost/type_traits/is_pointer.hpp>
+#include <boost/type_traits/is_same.hpp>
+
+// The vectorized kernels are available for GCC and Clang on x86,
+// the instruction set is chosen at runtime.
+// Define BOOST_GEOMETRY_INDEX_DETAIL_KD_NO_SIMD to always use the scalar code.
+#if !defined(BOOST_GEOMETRY_INDEX_DETAIL_KD_NO_SIMD) \
+ && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_SIMD
+#include <immintrin.h>
+#endif
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// Kernels processing the coordinates of count cartesian points of dimension dim
+// stored one after another. The comparable distances are calculated in double,
+// in the same order as in the pythagoras strategy, so the results are identical.
+// The equality test is the same as the one in math::equals().
+// The coordinates of 2d points are loaded at once and separated in the registers,
+// the coordinates of the other points are gathered.
+// The leaves use the kernels only if they have at least
+// BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_MIN values, so with the default
+// ValuesMin = 8 (leaves of 8-15 values) the kernels never run and the leaves
+// are scanned by the scalar loops. They're meant for larger ValuesMin.
+namespace kd_simd {
+
+enum level { scalar = 0, sse2, avx2, avx512 };
+
+template <typename T>
+inline double cdist(T const* c, std::size_t dim, double const* q)
+{
+    double result = 0;
+    for ( std::size_t d = 0 ; d < dim ; ++d )
+    {
+        double const v = double(c[d]) - q[d];
+        result = v * v + result;
+    }
+    return result;
+}
+
+template <typename T>
+inline void cdists_scalar(T const* c, std::size_t count, std::size_t dim, double const* q, double * out)
+{
+    for ( std::size_t i = 0 ; i < count ; ++i )
+        out[i] = cdist(c + i * dim, dim, q);
+}
+
+template <typename T>
+inline std::size_t find_equal_scalar(T const* c, std::size_t first, std::size_t count, std::size_t dim, T const* q)
+{
+    for ( std::size_t i = first ; i < count ; ++i )
+    {
+        std::size_t d = 0;
+        for ( ; d < dim && math::equals(c[i * dim + d], q[d]) ; ++d ) {}
+        if ( d == dim )
+            return i;
+    }
+    return count;
+}
+
+#ifdef BOOST_GEOMETRY_INDEX_DETAIL_KD_SIMD
+
+// the bits of the 2d points having both coordinates equal
+// in a mask of the coordinates of consecutive points
+inline unsigned both_equal2(unsigned mask)
+{
+    return mask & (mask >> 1) & 0x55555555u;
+}
+
+// SSE2
+
+__attribute__((target("sse2")))
+inline __m128d load2(double const* c, std::size_t dim)
+{
+    return _mm_set_pd(c[dim], c[0]);
+}
+
+__attribute__((target("sse2")))
+inline __m128d load2(float const* c, std::size_t dim)
+{
+    return _mm_set_pd(double(c[dim]), double(c[0]));
+}
+
+// the coordinates of a 2d point
+__attribute__((target("sse2")))
+inline __m128d load_point2(double const* c)
+{
+    return _mm_loadu_pd(c);
+}
+
+__attribute__((target("sse2")))
+inline __m128d load_point2(float const* c)
+{
+    return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(c))));
+}
+
+__attribute__((target("sse2")))
+inline __m128d equals_sse2(__m128d a, __m128d b)
+{
+    __m128d const sign = _mm_set1_pd(-0.0);
+    __m128d const one = _mm_set1_pd(1.0);
+    __m128d const eps = _mm_set1_pd(std::numeric_limits<double>::epsilon());
+    __m128d const max = _mm_set1_pd((std::numeric_limits<double>::max)());
+
+    __m128d abs_a = _mm_andnot_pd(sign, a);
+    __m128d abs_b = _mm_andnot_pd(sign, b);
+    __m128d factor = _mm_max_pd(_mm_max_pd(abs_a, abs_b), one);
+    __m128d close = _mm_cmple_pd(_mm_andnot_pd(sign, _mm_sub_pd(a, b)), _mm_mul_pd(eps, factor));
+    __m128d finite = _mm_and_pd(_mm_cmple_pd(abs_a, max), _mm_cmple_pd(abs_b, max));
+    return _mm_or_pd(_mm_cmpeq_pd(a, b), _mm_and_pd(finite, close));
+}
+
+__attribute__((target("sse2")))
+inline __m128 equals_sse2(__m128 a, __m128 b)
+{
+    __m128 const sign = _mm_set1_ps(-0.0f);
+    __m128 const one = _mm_set1_ps(1.0f);
+    __m128 const eps = _mm_set1_ps(std::numeric_limits<float>::epsilon());
+    __m128 const max = _mm_set1_ps((std::numeric_limits<float>::max)());
+
+    __m128 abs_a = _mm_andnot_ps(sign, a);
+    __m128 abs_b = _mm_andnot_ps(sign, b);
+    __m128 factor = _mm_max_ps(_mm_max_ps(abs_a, abs_b), one);
+    __m128 close = _mm_cmple_ps(_mm_andnot_ps(sign, _mm_sub_ps(a, b)), _mm_mul_ps(eps, factor));
+    __m128 finite = _mm_and_ps(_mm_cmple_ps(abs_a, max), _mm_cmple_ps(abs_b, max));
+    return _mm_or_ps(_mm_cmpeq_ps(a, b), _mm_and_ps(finite, close));
+}
+
+template <typename T>
+__attribute__((target("sse2")))
+inline void cdists_sse2(T const* c, std::size_t count, std::size_t dim, double const* q, double * out)
+{
+    std::size_t i = 0;
+    if ( dim == 2 )
+    {
+        __m128d const qv = _mm_set_pd(q[1], q[0]);
+        for ( ; i + 2 <= count ; i += 2 )
+        {
+            __m128d v0 = _mm_sub_pd(load_point2(c + i * 2), qv);
+            __m128d v1 = _mm_sub_pd(load_point2(c + i * 2 + 2), qv);
+            v0 = _mm_mul_pd(v0, v0);
+            v1 = _mm_mul_pd(v1, v1);
+            // x0 + y0, x1 + y1
+            _mm_storeu_pd(out + i, _mm_add_pd(_mm_unpacklo_pd(v0, v1), _mm_unpackhi_pd(v0, v1)));
+        }
+    }
+    else
+    {
+        for ( ; i + 2 <= count ; i += 2 )
+        {
+            __m128d acc = _mm_setzero_pd();
+            for ( std::size_t d = 0 ; d < dim ; ++d )
+            {
+                __m128d v = _mm_sub_pd(load2(c + i * dim + d, dim), _mm_set1_pd(q[d]));
+                acc = _mm_add_pd(_mm_mul_pd(v, v), acc);
+            }
+            _mm_storeu_pd(out + i, acc);
+        }
+    }
+    cdists_scalar(c + i * dim, count - i, dim, q, out + i);
+}
+
+__attribute__((target("sse2")))
+inline std::size_t find_equal_sse2(double const* c, std::size_t count, std::size_t dim, double const* q)
+{
+    std::size_t i = 0;
+    if ( dim == 2 )
+    {
+        __m128d const qv = _mm_set_pd(q[1], q[0]);
+        for ( ; i < count ; ++i )
+        {
+            if ( _mm_movemask_pd(equals_sse2(_mm_loadu_pd(c + i * 2), qv)) == 3 )
+                return i;
+        }
+        return count;
+    }
+
+    for ( ; i + 2 <= count ; i += 2 )
+    {
+        __m128d all = _mm_castsi128_pd(_mm_set1_epi32(-1));
+        for ( std::size_t d = 0 ; d < dim ; ++d )
+        {
+            __m128d a = _mm_set_pd(c[(i + 1) * dim + d], c[i * dim + d]);
+            all = _mm_and_pd(all, equals_sse2(a, _mm_set1_pd(q[d])));
+        }
+        int mask = _mm_movemask_pd(all);
+        if ( mask != 0 )
+            return i + __builtin_ctz(mask);
+    }
+    return find_equal_scalar(c, i, count, dim, q);
+}
+
+__attribute__((target("sse2")))
+inline std::size_t find_equal_sse2(float const* c, std::size_t count, std::size_t dim, float const* q)
+{
+    std::size_t i = 0;
+    if ( dim == 2 )
+    {
+        __m128 const qv = _mm_set_ps(q[1], q[0], q[1], q[0]);
+        for ( ; i + 2 <= count ; i += 2 )
+        {
+            unsigned mask = both_equal2(_mm_movemask_ps(equals_sse2(_mm_loadu_ps(c + i * 2), qv)));
+            if ( mask != 0 )
+                return i + __builtin_ctz(mask) / 2;
+        }
+        return find_equal_scalar(c, i, count, dim, q);
+    }
+
+    for ( ; i + 4 <= count ; i += 4 )
+    {
+        __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for ( std::size_t d = 0 ; d < dim ; ++d )
+        {
+            float const* p = c + i * dim + d;
+            __m128 a = _mm_set_ps(p[3 * dim], p[2 * dim], p[dim], p[0]);
+            all = _mm_and_ps(all, equals_sse2(a, _mm_set1_ps(q[d])));
+        }
+        int mask = _mm_movemask_ps(all);
+        if ( mask != 0 )
+            return i + __builtin_ctz(mask);
+    }
+    return find_equal_scalar(c, i, count, dim, q);
+}
+
+// AVX2
+
+__attribute__((target("avx2")))
+inline __m256d load4(double const* c, std::size_t dim)
+{
+    long long const s = static_cast<long long>(dim);
+    return _mm256_i64gather_pd(c, _mm256_set_epi64x(3 * s, 2 * s, s, 0), 8);
+}
+
+__attribute__((target("avx2")))
+inline __m256d load4(float const* c, std::size_t dim)
+{
+    int const s = static_cast<int>(dim);
+    return _mm256_cvtps_pd(_mm_i32gather_ps(c, _mm_set_epi32(3 * s, 2 * s, s, 0), 4));
+}
+
+// the coordinates of two 2d points
+__attribute__((target("avx2")))
+inline __m256d load_points2(double const* c)
+{
+    return _mm256_loadu_pd(c);
+}
+
+__attribute__((target("avx2")))
+inline __m256d load_points2(float const* c)
+{
+    return _mm256_cvtps_pd(_mm_loadu_ps(c));
+}
+
+__attribute__((target("avx2")))
+inline __m256d equals_avx2(__m256d a, __m256d b)
+{
+    __m256d const sign = _mm256_set1_pd(-0.0);
+    __m256d const one = _mm256_set1_pd(1.0);
+    __m256d const eps = _mm256_set1_pd(std::numeric_limits<double>::epsilon());
+    __m256d const max = _mm256_set1_pd((std::numeric_limits<double>::max)());
+
+    __m256d abs_a = _mm256_andnot_pd(sign, a);
+    __m256d abs_b = _mm256_andnot_pd(sign, b);
+    __m256d factor = _mm256_max_pd(_mm256_max_pd(abs_a, abs_b), one);
+    __m256d close = _mm256_cmp_pd(_mm256_andnot_pd(sign, _mm256_sub_pd(a, b)), _mm256_mul_pd(eps, factor), _CMP_LE_OQ);
+    __m256d finite = _mm256_and_pd(_mm256_cmp_pd(abs_a, max, _CMP_LE_OQ), _mm256_cmp_pd(abs_b, max, _CMP_LE_OQ));
+    return _mm256_or_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ), _mm256_and_pd(finite, close));
+}
+
+__attribute__((target("avx2")))
+inline __m256 equals_avx2(__m256 a, __m256 b)
+{
+    __m256 const sign = _mm256_set1_ps(-0.0f);
+    __m256 const one = _mm256_set1_ps(1.0f);
+    __m256 const eps = _mm256_set1_ps(std::numeric_limits<float>::epsilon());
+    __m256 const max = _mm256_set1_ps((std::numeric_limits<float>::max)());
+
+    __m256 abs_a = _mm256_andnot_ps(sign, a);
+    __m256 abs_b = _mm256_andnot_ps(sign, b);
+    __m256 factor = _mm256_max_ps(_mm256_max_ps(abs_a, abs_b), one);
+    __m256 close = _mm256_cmp_ps(_mm256_andnot_ps(sign, _mm256_sub_ps(a, b)), _mm256_mul_ps(eps, factor), _CMP_LE_OQ);
+    __m256 finite = _mm256_and_ps(_mm256_cmp_ps(abs_a, max, _CMP_LE_OQ), _mm256_cmp_ps(abs_b, max, _CMP_LE_OQ));
+    return _mm256_or_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ), _mm256_and_ps(finite, close));
+}
+
+template <typename T>
+__attribute__((target("avx2")))
+inline void cdists_avx2(T const* c, std::size_t count, std::size_t dim, double const* q, double * out)
+{
+    std::size_t i = 0;
+    if ( dim == 2 )
+    {
+        __m256d const qv = _mm256_set_pd(q[1], q[0], q[1], q[0]);
+        for ( ; i + 4 <= count ; i += 4 )
+        {
+            __m256d v0 = _mm256_sub_pd(load_points2(c + i * 2), qv);
+            __m256d v1 = _mm256_sub_pd(load_points2(c + i * 2 + 4), qv);
+            v0 = _mm256_mul_pd(v0, v0);
+            v1 = _mm256_mul_pd(v1, v1);
+            // x0 + y0, x2 + y2, x1 + y1, x3 + y3
+            __m256d s = _mm256_hadd_pd(v0, v1);
+            _mm256_storeu_pd(out + i, _mm256_permute4x64_pd(s, _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+    }
+    else
+    {
+        for ( ; i + 4 <= count ; i += 4 )
+        {
+            __m256d acc = _mm256_setzero_pd();
+            for ( std::size_t d = 0 ; d < dim ; ++d )
+            {
+                __m256d v = _mm256_sub_pd(load4(c + i * dim + d, dim), _mm256_set1_pd(q[d]));
+                acc = _mm256_add_pd(_mm256_mul_pd(v, v), acc);
+            }
+            _mm256_storeu_pd(out + i, acc);
+        }
+    }
+    cdists_sse2(c + i * dim, count - i, dim, q, out + i);
+}
+
+__attribute__((target("avx2")))
+inline std::size_t find_equal_avx2(double const* c, std::size_t count, std::size_t dim, double const* q)
+{
+    std::size_t i = 0;
+    if ( dim == 2 )
+    {
+        __m256d const qv = _mm256_set_pd(q[1], q[0], q[1], q[0]);
+        for ( ; i + 2 <= count ; i += 2 )
+        {
+            unsigned mask = both_equal2(_mm256_movemask_pd(equals_avx2(_mm256_loadu_pd(c + i * 2), qv)));
+            if ( mask != 0 )
+                return i + __builtin_ctz(mask) / 2;
+        }
+    }
+    else
+    {
+        for ( ; i + 4 <= count ; i += 4 )
+        {
+            __m256d all = _mm256_castsi256_pd(_mm256_set1_epi32(-1));
+            for ( std::size_t d = 0 ; d < dim ; ++d )
+            {
+                all = _mm256_and_pd(all, equals_avx2(load4(c + i * dim + d, dim), _mm256_set1_pd(q[d])));
+            }
+            int mask = _mm256_movemask_pd(all);
+            if ( mask != 0 )
+                return i + __builtin_ctz(mask);
+        }
+    }
+    return i + find_equal_sse2(c + i * dim, count - i, dim, q);
+}
+
+__attribute__((target("avx2")))
+inline std::size_t find_equal_avx2(float const* c, std::size_t count, std::size_t dim, float const* q)
+{
+    std::size_t i = 0;
+    if ( dim == 2 )
+    {
+        __m256 const qv = _mm256_set_ps(q[1], q[0], q[1], q[0], q[1], q[0], q[1], q[0]);
+        for ( ; i + 4 <= count ; i += 4 )
+        {
+            unsigned mask = both_equal2(_mm256_movemask_ps(equals_avx2(_mm256_loadu_ps(c + i * 2), qv)));
+            if ( mask != 0 )
+                return i + __builtin_ctz(mask) / 2;
+        }
+    }
+    else
+    {
+        int const s = static_cast<int>(dim);
+        __m256i const indexes = _mm256_set_epi32(7 * s, 6 * s, 5 * s, 4 * s, 3 * s, 2 * s, s, 0);
+        for ( ; i + 8 <= count ; i += 8 )
+        {
+            __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for ( std::size_t d = 0 ; d < dim ; ++d )
+            {
+                __m256 a = _mm256_i32gather_ps(c + i * dim + d, indexes, 4);
+                all = _mm256_and_ps(all, equals_avx2(a, _mm256_set1_ps(q[d])));
+            }
+            int mask = _mm256_movemask_ps(all);
+            if ( mask != 0 )
+                return i + __builtin_ctz(mask);
+        }
+    }
+    return i + find_equal_sse2(c + i * dim, count - i, dim, q);
+}
+
+// AVX-512, the 256-bit masked loads of the float coordinates require AVX512VL
+
+// only the first count points are loaded, the rest of the lanes is zeroed
+
+__attribute__((target("avx512f,avx512vl")))
+inline __m512d load8(double const* c, std::size_t dim, std::size_t count)
+{
+    long long const s = static_cast<long long>(dim);
+    __mmask8 const mask = static_cast<__mmask8>((1u << count) - 1);
+    return _mm512_mask_i64gather_pd(_mm512_setzero_pd(), mask,
+                                    _mm512_set_epi64(7 * s, 6 * s, 5 * s, 4 * s, 3 * s, 2 * s, s, 0), c, 8);
+}
+
+__attribute__((target("avx512f,avx512vl")))
+inline __m512d load8(float const* c, std::size_t dim, std::size_t count)
+{
+    int const s = static_cast<int>(dim);
+    __m256 const mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(count)),
+                                                               _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0)));
+    return _mm512_maskz_cvtps_pd(0xFF, _mm256_mask_i32gather_ps(_mm256_setzero_ps(), c,
+                                                                _mm256_set_epi32(7 * s, 6 * s, 5 * s, 4 * s, 3 * s, 2 * s, s, 0),
+                                                                mask, 4));
+}
+
+// the first count coordinates of 2d points, at most 8
+__attribute__((target("avx512f,avx512vl")))
+inline __m512d load_coords8(double const* c, std::size_t count)
+{
+    return _mm512_maskz_loadu_pd(static_cast<__mmask8>((1u << count) - 1), c);
+}
+
+__attribute__((target("avx512f,avx512vl")))
+inline __m512d load_coords8(float const* c, std::size_t count)
+{
+    return _mm512_maskz_cvtps_pd(0xFF, _mm256_maskz_loadu_ps(static_cast<__mmask8>((1u << count) - 1), c));
+}
+
+__attribute__((target("avx512f,avx512vl")))
+inline __mmask8 equals_avx512(__m512d a, __m512d b)
+{
+    __m512d const one = _mm512_set1_pd(1.0);
+    __m512d const eps = _mm512_set1_pd(std::numeric_limits<double>::epsilon());
+    __m512d const max = _mm512_set1_pd((std::numeric_limits<double>::max)());
+
+    __m512d abs_a = _mm512_abs_pd(a);
+    __m512d abs_b = _mm512_abs_pd(b);
+    __m512d factor = _mm512_maskz_max_pd(0xFF, _mm512_maskz_max_pd(0xFF, abs_a, abs_b), one);
+    __mmask8 close = _mm512_cmp_pd_mask(_mm512_abs_pd(_mm512_sub_pd(a, b)), _mm512_mul_pd(eps, factor), _CMP_LE_OQ);
+    __mmask8 finite = _mm512_cmp_pd_mask(abs_a, max, _CMP_LE_OQ) & _mm512_cmp_pd_mask(abs_b, max, _CMP_LE_OQ);
+    return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ) | (finite & close);
+}
+
+__attribute__((target("avx512f,avx512vl")))
+inline __mmask16 equals_avx512(__m512 a, __m512 b)
+{
+    __m512 const one = _mm512_set1_ps(1.0f);
+    __m512 const eps = _mm512_set1_ps(std::numeric_limits<float>::epsilon());
+    __m512 const max = _mm512_set1_ps((std::numeric_limits<float>::max)());
+
+    __m512 abs_a = _mm512_abs_ps(a);
+    __m512 abs_b = _mm512_abs_ps(b);
+    __m512 factor = _mm512_maskz_max_ps(0xFFFF, _mm512_maskz_max_ps(0xFFFF, abs_a, abs_b), one);
+    __mmask16 close = _mm512_cmp_ps_mask(_mm512_abs_ps(_mm512_sub_ps(a, b)), _mm512_mul_ps(eps, factor), _CMP_LE_OQ);
+    __mmask16 finite = _mm512_cmp_ps_mask(abs_a, max, _CMP_LE_OQ) & _mm512_cmp_ps_mask(abs_b, max, _CMP_LE_OQ);
+    return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ) | (finite & close);
+}
+
+template <typename T>
+__attribute__((target("avx512f,avx512vl")))
+inline void cdists_avx512(T const* c, std::size_t count, std::size_t dim, double const* q, double * out)
+{
+    if ( dim == 2 )
+    {
+        __m512d const qv = _mm512_set_pd(q[1], q[0], q[1], q[0], q[1], q[0], q[1], q[0]);
+        __m512i const even = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+        __m512i const odd = _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1);
+        for ( std::size_t i = 0 ; i < count ; i += 8 )
+        {
+            std::size_t const n = (std::min)(count - i, std::size_t(8));
+            __m512d v0 = _mm512_sub_pd(load_coords8(c + i * 2, (std::min)(2 * n, std::size_t(8))), qv);
+            __m512d v1 = _mm512_sub_pd(load_coords8(c + i * 2 + 8, 2 * n > 8 ? 2 * n - 8 : 0), qv);
+            v0 = _mm512_mul_pd(v0, v0);
+            v1 = _mm512_mul_pd(v1, v1);
+            // the squares aren't contracted with the sums of the separated coordinates
+            __m512d s = _mm512_add_pd(_mm512_permutex2var_pd(v0, even, v1), _mm512_permutex2var_pd(v0, odd, v1));
+            _mm512_mask_storeu_pd(out + i, static_cast<__mmask8>((1u << n) - 1), s);
+        }
+        return;
+    }
+
+    for ( std::size_t i = 0 ; i < count ; i += 8 )
+    {
+        std::size_t const n = (std::min)(count - i, std::size_t(8));
+        __m512d acc = _mm512_setzero_pd();
+        for ( std::size_t d = 0 ; d < dim ; ++d )
+        {
+            __m512d v = _mm512_sub_pd(load8(c + i * dim + d, dim, n), _mm512_set1_pd(q[d]));
+            // avx512f enables FMA, the explicit rounding prevents the contraction
+            // so the result is the same as in the scalar code
+            // the zero-masked variants don't read the undefined source operand
+            acc = _mm512_maskz_add_round_pd(0xFF,
+                                            _mm512_maskz_mul_round_pd(0xFF, v, v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC),
+                                            acc, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        }
+        _mm512_mask_storeu_pd(out + i, static_cast<__mmask8>((1u << n) - 1), acc);
+    }
+}
+
+__attribute__((target("avx512f,avx512vl")))
+inline std::size_t find_equal_avx512(double const* c, std::size_t count, std::size_t dim, double const* q)
+{
+    std::size_t i = 0;
+    if ( dim == 2 )
+    {
+        __m512d const qv = _mm512_set_pd(q[1], q[0], q[1], q[0], q[1], q[0], q[1], q[0]);
+        for ( ; i + 4 <= count ; i += 4 )
+        {
+            unsigned mask = both_equal2(equals_avx512(_mm512_loadu_pd(c + i * 2), qv));
+            if ( mask != 0 )
+                return i + __builtin_ctz(mask) / 2;
+        }
+    }
+    else
+    {
+        for ( ; i + 8 <= count ; i += 8 )
+        {
+            __mmask8 all = 0xFF;
+            for ( std::size_t d = 0 ; d < dim && all != 0 ; ++d )
+            {
+                all &= equals_avx512(load8(c + i * dim + d, dim, 8), _mm512_set1_pd(q[d]));
+            }
+            if ( all != 0 )
+                return i + __builtin_ctz(all);
+        }
+    }
+    return i + find_equal_avx2(c + i * dim, count - i, dim, q);
+}
+
+__attribute__((target("avx512f,avx512vl")))
+inline std::size_t find_equal_avx512(float const* c, std::size_t count, std::size_t dim, float const* q)
+{
+    std::size_t i = 0;
+    if ( dim == 2 )
+    {
+        __m512 const qv = _mm512_set_ps(q[1], q[0], q[1], q[0], q[1], q[0], q[1], q[0],
+                                        q[1], q[0], q[1], q[0], q[1], q[0], q[1], q[0]);
+        for ( ; i + 8 <= count ; i += 8 )
+        {
+            unsigned mask = both_equal2(equals_avx512(_mm512_loadu_ps(c + i * 2), qv));
+            if ( mask != 0 )
+                return i + __builtin_ctz(mask) / 2;
+        }
+    }
+    else
+    {
+        int const s = static_cast<int>(dim);
+        __m512i const indexes = _mm512_mullo_epi32(_mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0),
+                                                   _mm512_set1_epi32(s));
+        for ( ; i + 16 <= count ; i += 16 )
+        {
+            __mmask16 all = 0xFFFF;
+            for ( std::size_t d = 0 ; d < dim && all != 0 ; ++d )
+            {
+                __m512 a = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, indexes, c + i * dim + d, 4);
+                all &= equals_avx512(a, _mm512_set1_ps(q[d]));
+            }
+            if ( all != 0 )
+                return i + __builtin_ctz(all);
+        }
+    }
+    return i + find_equal_avx2(c + i * dim, count - i, dim, q);
+}
+
+inline level detect_level()
+{
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") )
+        return avx512;
+    if ( __builtin_cpu_supports("avx2") )
+        return avx2;
+    if ( __builtin_cpu_supports("sse2") )
+        return sse2;
+    return scalar;
+}
+
+#else // BOOST_GEOMETRY_INDEX_DETAIL_KD_SIMD
+
+inline level detect_level()
+{
+    return scalar;
+}
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_SIMD
+
+inline level current_level()
+{
+    static const level result = detect_level();
+    return result;
+}
+
+// the level must not be greater than current_level()
+template <typename T>
+inline void cdists(level l, T const* c, std::size_t count, std::size_t dim, double const* q, double * out)
+{
+#ifdef BOOST_GEOMETRY_INDEX_DETAIL_KD_SIMD
+    switch ( l )
+    {
+    case avx512: cdists_avx512(c, count, dim, q, out); return;
+    case avx2: cdists_avx2(c, count, dim, q, out); return;
+    case sse2: cdists_sse2(c, count, dim, q, out); return;
+    default: break;
+    }
+#endif
+    cdists_scalar(c, count, dim, q, out);
+}
+
+template <typename T>
+inline void cdists(T const* c, std::size_t count, std::size_t dim, double const* q, double * out)
+{
+    cdists(current_level(), c, count, dim, q, out);
+}
+
+// returns count if there is no equal point
+template <typename T>
+inline std::size_t find_equal(level l, T const* c, std::size_t count, std::size_t dim, T const* q)
+{
+#ifdef BOOST_GEOMETRY_INDEX_DETAIL_KD_SIMD
+    switch ( l )
+    {
+    case avx512: return find_equal_avx512(c, count, dim, q);
+    case avx2: return find_equal_avx2(c, count, dim, q);
+    case sse2: return find_equal_sse2(c, count, dim, q);
+    default: break;
+    }
+#endif
+    return find_equal_scalar(c, 0, count, dim, q);
+}
+
+template <typename T>
+inline std::size_t find_equal(T const* c, std::size_t count, std::size_t dim, T const* q)
+{
+    return find_equal(current_level(), c, count, dim, q);
+}
+
+} // namespace kd_simd
+
+// ---------------------------------------------------------------------- //
+
+// The kernels are used for contiguous ranges of float or double cartesian
+// model::points queried with a value of the same type.
+template <typename Point>
+struct kd_leaf_simd_point
+{
+    static const bool value = false;
+};
+
+template <typename T, std::size_t D>
+struct kd_leaf_simd_point< model::point<T, D, cs::cartesian> >
+{
+    static const bool value = (boost::is_same<T, float>::value || boost::is_same<T, double>::value)
+                           && sizeof(model::point<T, D, cs::cartesian>) == D * sizeof(T);
+};
+
+template <typename It>
+struct kd_leaf_simd_iterator
+{
+    typedef typename boost::iterator_value<It>::type point_type;
+
+    static const bool value = boost::is_pointer<It>::value
+                           || boost::is_same<It, typename std::vector<point_type>::iterator>::value
+                           || boost::is_same<It, typename std::vector<point_type>::const_iterator>::value;
+};
+
+template <typename It, typename Value>
+struct kd_leaf_simd_enabled
+{
+    typedef typename boost::iterator_value<It>::type point_type;
+
+    static const bool value = kd_leaf_simd_point<point_type>::value
+                           && kd_leaf_simd_iterator<It>::value
+                           && boost::is_same<point_type, Value>::value;
+};
+
+// ---------------------------------------------------------------------- //
+
+// the number of elements processed at once in the leaves of kd_nearest()
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_BLOCK 16
+
+// the smallest leaf scanned by the kernels, the smaller ones are scanned faster
+// by the scalar loops
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_MIN
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_MIN 32
+#endif
+
+template <typename It, typename Value, bool Enabled = kd_leaf_simd_enabled<It, Value>::value>
+struct kd_leaf_nearest
+{
+    template <typename CDist>
+    static inline bool apply(It first, It last, Value const& point, It & out_it, CDist & smallest_cdist)
+    {
+        for ( ; first != last ; ++first )
+        {
+            CDist cdist = geometry::comparable_distance(point, *first);
+            if ( cdist < smallest_cdist )
+            {
+                smallest_cdist = cdist;
+                out_it = first;
+            }
+
+            if ( math::equals(smallest_cdist, CDist(0)) )
+                return true;
+        }
+
+        return false;
+    }
+};
+
+template <typename It, typename Value>
+struct kd_leaf_nearest<It, Value, true>
+{
+    typedef typename boost::iterator_value<It>::type point_type;
+    typedef typename coordinate_type<point_type>::type coordinate_type;
+    static const std::size_t dim = dimension<point_type>::value;
+
+    template <typename CDist>
+    static inline bool apply(It first, It last, Value const& point, It & out_it, CDist & smallest_cdist)
+    {
+        BOOST_MPL_ASSERT((boost::is_same<CDist, double>));
+
+        // the scalar scan stops after the first value if the Point was already found
+        if ( std::distance(first, last) < BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_MIN
+          || (first != last && math::equals(smallest_cdist, CDist(0))) )
+            return kd_leaf_nearest<It, Value, false>::apply(first, last, point, out_it, smallest_cdist);
+
+        double q[dim];
+        for ( std::size_t d = 0 ; d < dim ; ++d )
+            q[d] = double(reinterpret_cast<coordinate_type const*>(&point)[d]);
+
+        double cdists[BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_BLOCK];
+
+        while ( first != last )
+        {
+            std::size_t count = static_cast<std::size_t>(std::distance(first, last));
+            if ( count > BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_BLOCK )
+                count = BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_BLOCK;
+
+            kd_simd::cdists(reinterpret_cast<coordinate_type const*>(&*first), count, dim, q, cdists);
+
+            for ( std::size_t i = 0 ; i < count ; ++i )
+            {
+                // smallest_cdist isn't equal to 0 until it's changed
+                if ( cdists[i] < smallest_cdist )
+                {
+                    smallest_cdist = cdists[i];
+                    out_it = first + i;
+
+                    if ( math::equals(smallest_cdist, CDist(0)) )
+                        return true;
+                }
+            }
+
+            first += count;
+        }
+
+        return false;
+    }
+};
+
+template <typename It, typename Value, bool Enabled = kd_leaf_simd_enabled<It, Value>::value>
+struct kd_leaf_binary_search
+{
+    static inline bool apply(It first, It last, Value const& value)
+    {
+        for ( ; first != last ; ++first )
+        {
+            if ( geometry::equals(*first, value) )
+                return true;
+        }
+
+        return false;
+    }
+};
+
+template <typename It, typename Value>
+struct kd_leaf_binary_search<It, Value, true>
+{
+    typedef typename boost::iterator_value<It>::type point_type;
+    typedef typename coordinate_type<point_type>::type coordinate_type;
+    static const std::size_t dim = dimension<point_type>::value;
+
+    static inline bool apply(It first, It last, Value const& value)
+    {
+        std::size_t const count = static_cast<std::size_t>(std::distance(first, last));
+        if ( count < BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_MIN )
+            return kd_leaf_binary_search<It, Value, false>::apply(first, last, value);
+
+        return kd_simd::find_equal(reinterpret_cast<coordinate_type const*>(&*first), count, dim,
+                                   reinterpret_cast<coordinate_type const*>(&value)) < count;
+    }
+};
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_HPP
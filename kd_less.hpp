@@ -70,6 +70,48 @@ inline bool kd_less(G1 const& l, G2 const& r)
     return kd_less_impl<I, G1, G2>::apply(l, r);
 }
 
+// kd_less() as a function object, unlike the pointer to kd_less() it's
+// inlined also by the recursive algorithms, e.g. kd_floyd_rivest_select
+template <std::size_t I, typename G>
+struct kd_less_function
+{
+    inline bool operator()(G const& l, G const& r) const
+    {
+        return kd_less_impl<I, G, G>::apply(l, r);
+    }
+};
+
+// the axis known at runtime, used by the iterative traversals
+
+template <std::size_t I, std::size_t Dimension>
+struct kd_less_by_axis_impl
+{
+    template <typename G1, typename G2>
+    static inline bool apply(std::size_t axis, G1 const& l, G2 const& r)
+    {
+        return axis == I ?
+               kd_less<I>(l, r) :
+               kd_less_by_axis_impl<I+1, Dimension>::apply(axis, l, r);
+    }
+};
+
+template <std::size_t Dimension>
+struct kd_less_by_axis_impl<Dimension, Dimension>
+{
+    template <typename G1, typename G2>
+    static inline bool apply(std::size_t , G1 const& , G2 const& )
+    {
+        BOOST_ASSERT(false);
+        return false;
+    }
+};
+
+template <typename G1, typename G2>
+inline bool kd_less_by_axis(std::size_t axis, G1 const& l, G2 const& r)
+{
+    return kd_less_by_axis_impl<0, dimension<G1>::value>::apply(axis, l, r);
+}
+
 }}}} // namespace boost::geometry::index::detail
 
 #endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_LESS_HPP
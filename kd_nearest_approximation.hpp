@@ -0,0 +1,88 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_APPROXIMATION_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_APPROXIMATION_HPP
+
+#include <boost/geometry.hpp>
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// The pruning bound of the exact nearest neighbour search, the Bound of
+// kd_nearest_impl and kd_nearest_left_balanced_impl.
+struct kd_nearest_exact
+{
+    // the comparable distance used by kd_is_further()
+    template <typename CDist>
+    static inline CDist const& bound(CDist const& smallest_cdist)
+    {
+        return smallest_cdist;
+    }
+
+    // returns true if the search should stop
+    static inline bool visit(std::size_t = 1)
+    {
+        return false;
+    }
+};
+
+// The state of the approximate nearest neighbour search. A branch is pruned
+// if the distance to the splitting plane multiplied by (1+epsilon) is greater
+// than the distance to the closest value found so far. So the distance to
+// the returned value is at most (1+epsilon) times greater than the distance
+// to the nearest one. The comparable distances are squared so the pruning
+// bound is the comparable distance divided by (1+epsilon)^2.
+// If max_visited is greater than 0 the search stops after checking this many
+// values, then the result isn't bounded by epsilon. The values of a leaf are
+// checked at once so the search may check up to ValuesMin more values.
+// The epsilon pruning pays off in the higher dimensions, where the exact search
+// checks many leaves around the query (see the kd_nearest(epsilon) rows of
+// kd_benchmark --dimensions 8). In 2d the exact search checks only a few more
+// values than the descent to the first leaf, so the approximate search isn't
+// faster there and may be slower. max_visited bounds the work in any dimension.
+template <typename CDist>
+class kd_nearest_approximation
+{
+public:
+    typedef typename select_most_precise<CDist, double>::type bound_type;
+
+    kd_nearest_approximation(double epsilon, std::size_t max_visited)
+        : m_factor(bound_type(1) / ((bound_type(1) + epsilon) * (bound_type(1) + epsilon)))
+        , m_max_visited(max_visited)
+        , m_visited(0)
+    {}
+
+    // the comparable distance used by kd_is_further()
+    inline bound_type bound(CDist const& smallest_cdist) const
+    {
+        return bound_type(smallest_cdist) * m_factor;
+    }
+
+    // returns true if the budget is exhausted
+    inline bool visit(std::size_t count = 1)
+    {
+        m_visited += count;
+        return m_max_visited > 0 && m_visited >= m_max_visited;
+    }
+
+    inline std::size_t visited() const
+    {
+        return m_visited;
+    }
+
+private:
+    bound_type m_factor;
+    std::size_t m_max_visited;
+    std::size_t m_visited;
+};
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_APPROXIMATION_HPP
@@ -0,0 +1,153 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_BATCH_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_BATCH_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "kd_sort.hpp"
+#include "kd_sort_left_balanced.hpp"
+#include "kd_sort_indexes.hpp"
+#include "kd_task_pool.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// the number of queries processed by one task
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_BATCH_CHUNK
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_BATCH_CHUNK 1024
+#endif
+
+// ---------------------------------------------------------------------- //
+
+struct kd_nearest_batch_query
+{
+    template <typename RandomIt, typename Point, typename Value>
+    static inline bool apply(RandomIt first, RandomIt last, Point const& point, Value & result)
+    {
+        return kd_nearest(first, last, point, result);
+    }
+};
+
+struct kd_nearest_left_balanced_batch_query
+{
+    template <typename RandomIt, typename Point, typename Value>
+    static inline bool apply(RandomIt first, RandomIt last, Point const& point, Value & result)
+    {
+        return kd_nearest_left_balanced(first, last, point, result);
+    }
+};
+
+template <typename Query>
+struct kd_nearest_batch_impl
+{
+    template <typename RandomIt, typename QueryIt, typename IndexIt, typename ResultIt>
+    static inline void apply_chunk(RandomIt first, RandomIt last,
+                                   QueryIt queries,
+                                   IndexIt indexes_first, IndexIt indexes_last,
+                                   ResultIt results,
+                                   std::size_t /*worker*/)
+    {
+        for ( ; indexes_first != indexes_last ; ++indexes_first )
+        {
+            std::size_t const i = *indexes_first;
+            Query::apply(first, last, *(queries + i), *(results + i));
+        }
+    }
+
+    template <typename RandomIt, typename QueryIt, typename ResultIt>
+    static inline bool apply(RandomIt first, RandomIt last,
+                             QueryIt queries_first, QueryIt queries_last,
+                             ResultIt results,
+                             kd_task_pool & pool, std::size_t chunk_size)
+    {
+        typedef typename boost::iterator_value<QueryIt>::type query_type;
+        typedef std::vector<std::size_t>::const_iterator index_iterator;
+
+        if ( std::distance(first, last) < 1 )
+            return false;
+
+        std::size_t const count = static_cast<std::size_t>(std::distance(queries_first, queries_last));
+        if ( count < 1 )
+            return true;
+
+        // the queries close to each other are processed one after another
+        // in order to reuse the nodes which are already in the cache
+        std::vector<std::size_t> indexes(count);
+        for ( std::size_t i = 0 ; i < count ; ++i )
+            indexes[i] = i;
+
+        if ( count > 1 )
+            kd_sort_indexes_impl<query_type>::apply(queries_first, indexes.begin(), indexes.end());
+
+        if ( chunk_size < 1 )
+            chunk_size = 1;
+
+        for ( std::size_t i = 0 ; i < count ; i += chunk_size )
+        {
+            index_iterator chunk_first = indexes.begin() + i;
+            index_iterator chunk_last = indexes.begin() + (std::min)(i + chunk_size, count);
+            pool.push(0, boost::bind(&kd_nearest_batch_impl::template apply_chunk<RandomIt, QueryIt, index_iterator, ResultIt>,
+                                     first, last, queries_first, chunk_first, chunk_last, results, _1));
+        }
+
+        pool.wait();
+
+        return true;
+    }
+};
+
+// For each query point in [queries_first, queries_last) writes the nearest value
+// to the corresponding element of the range starting at results.
+// Both QueryIt and ResultIt must be random access iterators.
+template <typename RandomIt, typename QueryIt, typename ResultIt>
+inline bool kd_nearest_batch(RandomIt first, RandomIt last,
+                             QueryIt queries_first, QueryIt queries_last,
+                             ResultIt results,
+                             kd_task_pool & pool,
+                             std::size_t chunk_size = BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_BATCH_CHUNK)
+{
+    return kd_nearest_batch_impl<kd_nearest_batch_query>
+                ::apply(first, last, queries_first, queries_last, results, pool, chunk_size);
+}
+
+template <typename RandomIt, typename QueryIt, typename ResultIt>
+inline bool kd_nearest_batch(RandomIt first, RandomIt last,
+                             QueryIt queries_first, QueryIt queries_last,
+                             ResultIt results)
+{
+    kd_task_pool pool;
+    return kd_nearest_batch(first, last, queries_first, queries_last, results, pool);
+}
+
+template <typename RandomIt, typename QueryIt, typename ResultIt>
+inline bool kd_nearest_left_balanced_batch(RandomIt first, RandomIt last,
+                                           QueryIt queries_first, QueryIt queries_last,
+                                           ResultIt results,
+                                           kd_task_pool & pool,
+                                           std::size_t chunk_size = BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_BATCH_CHUNK)
+{
+    return kd_nearest_batch_impl<kd_nearest_left_balanced_batch_query>
+                ::apply(first, last, queries_first, queries_last, results, pool, chunk_size);
+}
+
+template <typename RandomIt, typename QueryIt, typename ResultIt>
+inline bool kd_nearest_left_balanced_batch(RandomIt first, RandomIt last,
+                                           QueryIt queries_first, QueryIt queries_last,
+                                           ResultIt results)
+{
+    kd_task_pool pool;
+    return kd_nearest_left_balanced_batch(first, last, queries_first, queries_last, results, pool);
+}
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_BATCH_HPP
@@ -0,0 +1,463 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_JOIN_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_JOIN_HPP
+
+#include <limits>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "kd_sort.hpp"
+#include "kd_soa_index.hpp"
+#include "kd_task_pool.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// the maximum number of queries processed by one task
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_JOIN_CHUNK
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_JOIN_CHUNK 4096
+#endif
+
+// ---------------------------------------------------------------------- //
+
+// The split coordinates of the medians of the nodes of the kd_sort() layout,
+// per position in the range. The positions of the values of the leaves
+// aren't set.
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_join_splits_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It>
+    static inline void apply(It first, std::size_t f, std::size_t l, std::vector<double> & splits)
+    {
+        if ( l - f <= ValuesMin )
+            return;
+
+        std::size_t const nth = f + (l - f) / 2;
+        splits[nth] = static_cast<double>(geometry::get<I>(*(first + nth)));
+        kd_join_splits_impl<Point, next_dimension, ValuesMin>::apply(first, f, nth, splits);
+        kd_join_splits_impl<Point, next_dimension, ValuesMin>::apply(first, nth + 1, l, splits);
+    }
+};
+
+// ---------------------------------------------------------------------- //
+
+// The k nearest values of all of the queries, the query and reference ranges
+// are both sorted with kd_sort(). Each query is searched for bottom-up, the
+// leaf of the reference tree containing the query is scanned first and then
+// the ancestors of the leaf are visited starting from the closest one. The
+// median and the other child of an ancestor are visited only if the split
+// plane is closer than the kth closest value found so far. So unlike
+// kd_nearest_k() the query doesn't calculate the distances to the medians on
+// the path from the root and the far subtrees are pruned with the kth
+// distance of the own leaf.
+// If the ranges are the same the query isn't its own neighbour. The other
+// values equal to the query are. Then the query tree is the reference tree,
+// the path of the query is known and the values of a leaf are compared with
+// each other once for both of them.
+// Only the Points are supported, see kd_query_within_impl.
+template <typename RandomIt, typename QueryIt, typename ResultIt,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+class kd_nearest_join_impl
+    : boost::noncopyable
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typedef typename boost::iterator_value<QueryIt>::type query_type;
+
+    BOOST_MPL_ASSERT_MSG((boost::is_same<typename geometry::tag<point_type>::type, point_tag>::value),
+                         NOT_IMPLEMENTED_FOR_THIS_VALUE_TYPE, (point_type));
+    BOOST_MPL_ASSERT_MSG((boost::is_same<typename geometry::tag<query_type>::type, point_tag>::value),
+                         NOT_IMPLEMENTED_FOR_THIS_QUERY_TYPE, (query_type));
+
+    static const std::size_t dimension = geometry::dimension<point_type>::value;
+
+    // a subrange of the reference tree and the axis of its split plane
+    struct node
+    {
+        node(std::size_t f_, std::size_t l_, std::size_t axis_)
+            : f(f_), l(l_), axis(axis_)
+        {}
+
+        std::size_t size() const { return l - f; }
+        bool is_leaf() const { return size() <= ValuesMin; }
+        std::size_t nth() const { return f + size() / 2; }
+        node left() const { return node(f, nth(), (axis + 1) % dimension); }
+        node right() const { return node(nth() + 1, l, (axis + 1) % dimension); }
+
+        std::size_t f, l, axis;
+    };
+
+    // the ancestors of a node, starting from the root
+    typedef std::vector<node> path_type;
+
+public:
+    kd_nearest_join_impl(RandomIt first, RandomIt last,
+                         QueryIt queries_first, QueryIt queries_last,
+                         std::size_t k, ResultIt results, bool self)
+        : m_first(first)
+        , m_size(static_cast<std::size_t>(std::distance(first, last)))
+        , m_queries(queries_first)
+        , m_queries_size(static_cast<std::size_t>(std::distance(queries_first, queries_last)))
+        , m_k(k)
+        , m_results(results)
+        , m_self(self)
+    {
+        m_splits.resize(m_size);
+        if ( m_size > 0 )
+            kd_join_splits_impl<point_type, 0, ValuesMin>::apply(first, 0, m_size, m_splits);
+
+        m_cdists.assign(m_queries_size * m_k, (std::numeric_limits<double>::max)());
+        for ( std::size_t i = 0 ; i < m_queries_size * m_k ; ++i )
+            *(m_results + i) = m_size;
+    }
+
+    // the subtrees of the query tree or the chunks of the queries are
+    // processed by separate tasks, each one writes only the results of its
+    // own queries
+    void apply(kd_task_pool & pool, std::size_t chunk_size)
+    {
+        if ( m_size < 1 || m_queries_size < 1 || m_k < 1 )
+            return;
+
+        chunk_size = (std::max)(chunk_size, std::size_t(1));
+
+        std::vector<std::size_t> medians;
+        if ( m_self )
+        {
+            path_type path;
+            schedule(node(0, m_size, 0), path, pool, chunk_size, medians);
+        }
+        else
+        {
+            for ( std::size_t f = 0 ; f < m_queries_size ; f += chunk_size )
+            {
+                std::size_t const l = (std::min)(f + chunk_size, m_queries_size);
+                pool.push(0, boost::bind(&kd_nearest_join_impl::run_queries, this, f, l, _1));
+            }
+        }
+        // the medians of the top nodes at once, there are few of them
+        if ( ! medians.empty() )
+            pool.push(0, boost::bind(&kd_nearest_join_impl::run_medians, this, boost::cref(medians), _1));
+
+        pool.wait();
+    }
+
+private:
+    void schedule(node const& q, path_type & path, kd_task_pool & pool, std::size_t chunk_size,
+                  std::vector<std::size_t> & medians)
+    {
+        if ( q.size() < 1 )
+            return;
+
+        if ( q.size() <= chunk_size || q.is_leaf() )
+        {
+            pool.push(0, boost::bind(&kd_nearest_join_impl::run, this, q, path, _1));
+            return;
+        }
+
+        medians.push_back(q.nth());
+        path.push_back(q);
+        schedule(q.left(), path, pool, chunk_size, medians);
+        schedule(q.right(), path, pool, chunk_size, medians);
+        path.pop_back();
+    }
+
+    void run(node const& q, path_type const& path, std::size_t /*worker*/)
+    {
+        path_type own_path(path);
+        self_join(q, own_path);
+    }
+
+    void run_medians(std::vector<std::size_t> const& medians, std::size_t /*worker*/)
+    {
+        path_type path;
+        for ( std::size_t i = 0 ; i < medians.size() ; ++i )
+            locate(medians[i], path);
+    }
+
+    void run_queries(std::size_t f, std::size_t l, std::size_t /*worker*/)
+    {
+        path_type path;
+        for ( std::size_t qi = f ; qi < l ; ++qi )
+            locate(qi, path);
+    }
+
+    inline double kth_cdist(std::size_t i) const
+    {
+        return m_cdists[i * m_k + m_k - 1];
+    }
+
+    // the closest values of the query are sorted by cdist
+    inline void insert(std::size_t q, std::size_t r, double cdist)
+    {
+        double * cdists = &m_cdists[q * m_k];
+        std::size_t i = m_k - 1;
+        for ( ; i > 0 && cdist < cdists[i - 1] ; --i )
+        {
+            cdists[i] = cdists[i - 1];
+            *(m_results + (q * m_k + i)) = *(m_results + (q * m_k + i - 1));
+        }
+        cdists[i] = cdist;
+        *(m_results + (q * m_k + i)) = r;
+    }
+
+    inline void scan(std::size_t qi, std::size_t f, std::size_t l)
+    {
+        for ( std::size_t ri = f ; ri < l ; ++ri )
+        {
+            if ( m_self && qi == ri )
+                continue;
+
+            double const cdist = double(geometry::comparable_distance(*(m_queries + qi), *(m_first + ri)));
+            if ( cdist < kth_cdist(qi) )
+            {
+                insert(qi, ri, cdist);
+                // k values equal to the query are found
+                if ( kth_cdist(qi) == 0 )
+                    return;
+            }
+        }
+    }
+
+    // the values of the leaf of the self join are the queries and the
+    // references of each other
+    inline void scan_leaf(node const& n)
+    {
+        for ( std::size_t i = n.f ; i < n.l ; ++i )
+        {
+            for ( std::size_t j = i + 1 ; j < n.l ; ++j )
+            {
+                double const cdist = double(geometry::comparable_distance(*(m_first + i), *(m_first + j)));
+                if ( cdist < kth_cdist(i) )
+                    insert(i, j, cdist);
+                if ( cdist < kth_cdist(j) )
+                    insert(j, i, cdist);
+            }
+        }
+    }
+
+    // the values on the other side of the split plane aren't closer than the
+    // plane, as in kd_is_further() the node is pruned if the plane is further
+    // than the kth closest value
+    inline bool is_further(std::size_t qi, double axis_dist) const
+    {
+        return kth_cdist(qi) < axis_dist * axis_dist;
+    }
+
+    // the top-down traversal of the reference node, the closer child first
+    void search(std::size_t qi, double const* p, node const& r)
+    {
+        if ( r.size() < 1 )
+            return;
+
+        if ( r.is_leaf() )
+        {
+            scan(qi, r.f, r.l);
+            return;
+        }
+
+        std::size_t const nth = r.nth();
+        scan(qi, nth, nth + 1);
+
+        double const axis_dist = p[r.axis] - m_splits[nth];
+        node const closer = axis_dist <= 0 ? r.left() : r.right();
+        node const further = axis_dist <= 0 ? r.right() : r.left();
+
+        search(qi, p, closer);
+        if ( ! is_further(qi, axis_dist) )
+            search(qi, p, further);
+    }
+
+    // the ancestors of the node containing the query, the closest one first
+    void ascend(std::size_t qi, double const* p, path_type const& path, node child)
+    {
+        for ( std::size_t i = path.size() ; i > 0 ; --i )
+        {
+            // k values equal to the query are found
+            if ( kth_cdist(qi) == 0 )
+                return;
+
+            node const& a = path[i - 1];
+            std::size_t const nth = a.nth();
+            if ( ! is_further(qi, p[a.axis] - m_splits[nth]) )
+            {
+                scan(qi, nth, nth + 1);
+                search(qi, p, child.f == a.f ? a.right() : a.left());
+            }
+            child = a;
+        }
+    }
+
+    // the query is searched for from the leaf it would be stored in
+    void locate(std::size_t qi, path_type & path)
+    {
+        double p[dimension];
+        kd_soa_copy_coords<0, dimension>::apply(*(m_queries + qi), p);
+
+        path.clear();
+        node n(0, m_size, 0);
+        while ( ! n.is_leaf() )
+        {
+            path.push_back(n);
+            n = p[n.axis] < m_splits[n.nth()] ? n.left() : n.right();
+        }
+
+        scan(qi, n.f, n.l);
+        ascend(qi, p, path, n);
+    }
+
+    // the query subtree of the self join, the path contains its ancestors
+    void self_join(node const& q, path_type & path)
+    {
+        double p[dimension];
+
+        if ( q.is_leaf() )
+        {
+            scan_leaf(q);
+            for ( std::size_t qi = q.f ; qi < q.l ; ++qi )
+            {
+                kd_soa_copy_coords<0, dimension>::apply(*(m_first + qi), p);
+                ascend(qi, p, path, q);
+            }
+            return;
+        }
+
+        // the median is on the split plane, both children are searched
+        std::size_t const nth = q.nth();
+        kd_soa_copy_coords<0, dimension>::apply(*(m_first + nth), p);
+        search(nth, p, q.left());
+        search(nth, p, q.right());
+        ascend(nth, p, path, q);
+
+        path.push_back(q);
+        self_join(q.left(), path);
+        self_join(q.right(), path);
+        path.pop_back();
+    }
+
+    RandomIt m_first;
+    std::size_t m_size;
+    QueryIt m_queries;
+    std::size_t m_queries_size;
+    std::size_t m_k;
+    ResultIt m_results;
+    bool m_self;
+
+    // the split coordinates of the medians of the reference tree
+    std::vector<double> m_splits;
+    // the k closest cdists per query
+    std::vector<double> m_cdists;
+};
+
+// ---------------------------------------------------------------------- //
+
+// For each query in [queries_first, queries_last) writes the positions in
+// [first, last) of k closest values, sorted by distance, to the elements
+// [i*k, i*k+k) of the range starting at results. If there are less than k
+// values the rest of the positions are equal to the size of the range.
+// Both ranges must be sorted with kd_sort() with the same ValuesMin.
+// ResultIt must be a random access iterator of integral values.
+template <std::size_t ValuesMin, typename RandomIt, typename QueryIt, typename ResultIt>
+inline bool kd_nearest_join(RandomIt first, RandomIt last,
+                            QueryIt queries_first, QueryIt queries_last,
+                            std::size_t k, ResultIt results,
+                            kd_task_pool & pool,
+                            std::size_t chunk_size = BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_JOIN_CHUNK)
+{
+    if ( std::distance(first, last) < 1 )
+        return false;
+
+    kd_nearest_join_impl<RandomIt, QueryIt, ResultIt, ValuesMin>
+        join(first, last, queries_first, queries_last, k, results, false);
+    join.apply(pool, chunk_size);
+
+    return true;
+}
+
+template <std::size_t ValuesMin, typename RandomIt, typename QueryIt, typename ResultIt>
+inline bool kd_nearest_join(RandomIt first, RandomIt last,
+                            QueryIt queries_first, QueryIt queries_last,
+                            std::size_t k, ResultIt results)
+{
+    kd_task_pool pool;
+    return kd_nearest_join<ValuesMin>(first, last, queries_first, queries_last, k, results, pool);
+}
+
+template <typename RandomIt, typename QueryIt, typename ResultIt>
+inline bool kd_nearest_join(RandomIt first, RandomIt last,
+                            QueryIt queries_first, QueryIt queries_last,
+                            std::size_t k, ResultIt results,
+                            kd_task_pool & pool,
+                            std::size_t chunk_size = BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_JOIN_CHUNK)
+{
+    return kd_nearest_join<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+                (first, last, queries_first, queries_last, k, results, pool, chunk_size);
+}
+
+template <typename RandomIt, typename QueryIt, typename ResultIt>
+inline bool kd_nearest_join(RandomIt first, RandomIt last,
+                            QueryIt queries_first, QueryIt queries_last,
+                            std::size_t k, ResultIt results)
+{
+    return kd_nearest_join<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+                (first, last, queries_first, queries_last, k, results);
+}
+
+// The same as kd_nearest_join() for the range against itself, e.g. for all
+// nearest neighbours. The value isn't its own neighbour. The results of the
+// ith value of the range are [i*k, i*k+k).
+template <std::size_t ValuesMin, typename RandomIt, typename ResultIt>
+inline bool kd_nearest_self_join(RandomIt first, RandomIt last,
+                                 std::size_t k, ResultIt results,
+                                 kd_task_pool & pool,
+                                 std::size_t chunk_size = BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_JOIN_CHUNK)
+{
+    if ( std::distance(first, last) < 1 )
+        return false;
+
+    kd_nearest_join_impl<RandomIt, RandomIt, ResultIt, ValuesMin>
+        join(first, last, first, last, k, results, true);
+    join.apply(pool, chunk_size);
+
+    return true;
+}
+
+template <std::size_t ValuesMin, typename RandomIt, typename ResultIt>
+inline bool kd_nearest_self_join(RandomIt first, RandomIt last,
+                                 std::size_t k, ResultIt results)
+{
+    kd_task_pool pool;
+    return kd_nearest_self_join<ValuesMin>(first, last, k, results, pool);
+}
+
+template <typename RandomIt, typename ResultIt>
+inline bool kd_nearest_self_join(RandomIt first, RandomIt last,
+                                 std::size_t k, ResultIt results,
+                                 kd_task_pool & pool,
+                                 std::size_t chunk_size = BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_JOIN_CHUNK)
+{
+    return kd_nearest_self_join<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+                (first, last, k, results, pool, chunk_size);
+}
+
+template <typename RandomIt, typename ResultIt>
+inline bool kd_nearest_self_join(RandomIt first, RandomIt last,
+                                 std::size_t k, ResultIt results)
+{
+    return kd_nearest_self_join<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, k, results);
+}
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_JOIN_HPP
@@ -0,0 +1,100 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_K_RESULT_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_K_RESULT_HPP
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <boost/geometry.hpp>
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// k closest elements found so far, stored in a max-heap
+// so the k-th distance used for pruning is always at the front
+template <typename It, typename CDist>
+class kd_nearest_k_result
+{
+    typedef std::pair<CDist, It> element_type;
+
+    static inline bool first_less(element_type const& l, element_type const& r)
+    {
+        return l.first < r.first;
+    }
+
+public:
+    typedef CDist distance_type;
+
+    // at most values_count values may be found so k may be greater
+    kd_nearest_k_result(std::size_t k, std::size_t values_count)
+        : m_k(k)
+    {
+        m_heap.reserve((std::min)(k, values_count));
+    }
+
+    // returns true if the k-th distance is 0, nothing closer may be found
+    inline bool update(It it, CDist const& cdist)
+    {
+        if ( m_heap.size() < m_k )
+        {
+            m_heap.push_back(std::make_pair(cdist, it));
+            std::push_heap(m_heap.begin(), m_heap.end(), first_less);
+        }
+        else if ( cdist < m_heap.front().first )
+        {
+            std::pop_heap(m_heap.begin(), m_heap.end(), first_less);
+            m_heap.back().first = cdist;
+            m_heap.back().second = it;
+            std::push_heap(m_heap.begin(), m_heap.end(), first_less);
+        }
+
+        return is_full() && math::equals(m_heap.front().first, CDist(0));
+    }
+
+    inline bool is_full() const
+    {
+        return m_heap.size() >= m_k;
+    }
+
+    // valid only if is_full()
+    inline CDist const& greatest_cdist() const
+    {
+        return m_heap.front().first;
+    }
+
+    inline std::size_t size() const
+    {
+        return m_heap.size();
+    }
+
+    // sorts the elements by distance and copies the values
+    template <typename OutIt>
+    inline OutIt finish(OutIt out_it)
+    {
+        std::sort_heap(m_heap.begin(), m_heap.end(), first_less);
+        for ( typename std::vector<element_type>::const_iterator it = m_heap.begin() ;
+              it != m_heap.end() ; ++it )
+        {
+            *out_it = *(it->second);
+            ++out_it;
+        }
+        return out_it;
+    }
+
+private:
+    std::size_t m_k;
+    std::vector<element_type> m_heap;
+};
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_NEAREST_K_RESULT_HPP
@@ -0,0 +1,615 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_QUANTIZED_INDEX_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_QUANTIZED_INDEX_HPP
+
+#include <cmath>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/integer_traits.hpp>
+
+#include "kd_sort.hpp"
+#include "kd_sort_spread.hpp"
+#include "kd_soa_index.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// The bounds of a block of values. A coordinate x is stored as the offset q
+// such that lo(q) <= x <= hi(q). The bounds are calculated the same way
+// during the build and the queries so they're conservative also with the
+// rounding errors.
+template <typename Quantized, std::size_t Dimension>
+struct kd_quantized_block
+{
+    static const Quantized max_offset = boost::integer_traits<Quantized>::const_max;
+
+    kd_quantized_block()
+    {
+        for ( std::size_t d = 0 ; d < Dimension ; ++d )
+            min[d] = scale[d] = 0;
+    }
+
+    inline double lo(std::size_t d, Quantized q) const
+    {
+        return min[d] + double(q) * scale[d];
+    }
+
+    inline double hi(std::size_t d, Quantized q) const
+    {
+        return min[d] + (double(q) + 1) * scale[d];
+    }
+
+    inline Quantized quantize(std::size_t d, double x) const
+    {
+        if ( ! (0 < scale[d]) )
+            return 0;
+
+        double const f = std::floor((x - min[d]) / scale[d]);
+        Quantized q = f <= 0 ? 0
+                    : f >= double(max_offset) ? max_offset
+                    : static_cast<Quantized>(f);
+        while ( q > 0 && x < lo(d, q) )
+            --q;
+        while ( q < max_offset && hi(d, q) < x )
+            ++q;
+        return q;
+    }
+
+    // the comparable distance between the point and the bounds of the value
+    inline double lower_cdist(Quantized const* q, double const* point) const
+    {
+        double result = 0;
+        for ( std::size_t d = 0 ; d < Dimension ; ++d )
+        {
+            double const l = lo(d, q[d]);
+            double const h = hi(d, q[d]);
+            double const diff = point[d] < l ? l - point[d]
+                              : h < point[d] ? point[d] - h
+                              : 0;
+            result += diff * diff;
+        }
+        return result;
+    }
+
+    inline bool may_equal(Quantized const* q, double const* point) const
+    {
+        for ( std::size_t d = 0 ; d < Dimension ; ++d )
+        {
+            if ( point[d] < lo(d, q[d]) || hi(d, q[d]) < point[d] )
+                return false;
+        }
+        return true;
+    }
+
+    double min[Dimension];
+    double scale[Dimension];
+};
+
+// The arrays of kd_quantized_index passed to the traversals
+template <typename Quantized, std::size_t Dimension, std::size_t BlockSize>
+struct kd_quantized_view
+{
+    typedef Quantized quantized_type;
+    typedef kd_quantized_block<Quantized, Dimension> block_type;
+    static const std::size_t dimension = Dimension;
+    static const std::size_t block_size = BlockSize;
+
+    double const* splits;
+    block_type const* blocks;
+    Quantized const* coords;
+    std::size_t nodes_count;
+
+    inline Quantized const* at(std::size_t i) const
+    {
+        return coords + i * Dimension;
+    }
+
+    // the block of the leaf node
+    inline block_type const& block(std::size_t node) const
+    {
+        return blocks[block_index(node, nodes_count)];
+    }
+
+    // The leaves are at most on the level of the nodes [nodes_count, 2 * nodes_count).
+    // A leaf is stored at the position of its leftmost descendant on this level so
+    // there are at most nodes_count blocks.
+    static inline std::size_t block_index(std::size_t node, std::size_t nodes_count)
+    {
+        while ( node < nodes_count )
+            node *= 2;
+        BOOST_ASSERT(node < 2 * nodes_count);
+        return node - nodes_count;
+    }
+};
+
+// ---------------------------------------------------------------------- //
+
+// In the blocks the traversal and the pruning are done on the bounds of the
+// quantized coordinates. The full precision value is read only if the bounds
+// of the value are closer than the closest value found so far.
+template <typename View, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN,
+          typename Stats = kd_default_stats>
+struct kd_quantized_block_nearest_impl
+{
+    static const std::size_t next_dimension = (I+1) % View::dimension;
+    typedef typename View::block_type block_type;
+
+    template <typename It, typename Value>
+    static inline bool update_one(View const& view, block_type const& block, It first, std::size_t i,
+                                  Value const& point, double const* p,
+                                  std::size_t & out_i, double & smallest_cdist)
+    {
+        if ( ! (block.lower_cdist(view.at(i), p) < smallest_cdist) )
+            return false;
+
+        Stats::distance();
+        double const cdist = double(geometry::comparable_distance(point, *(first + i)));
+        if ( cdist < smallest_cdist )
+        {
+            smallest_cdist = cdist;
+            out_i = i;
+        }
+
+        return math::equals(smallest_cdist, 0.0);
+    }
+
+    template <typename It, typename Value>
+    static inline bool per_branch(View const& view, block_type const& block, It first,
+                                  std::size_t f, std::size_t l,
+                                  Value const& point, double const* p,
+                                  std::size_t & out_i, double & smallest_cdist)
+    {
+        if ( l - f > ValuesMin )
+        {
+            return kd_quantized_block_nearest_impl<View, next_dimension, ValuesMin, Stats>
+                        ::apply(view, block, first, f, l, point, p, out_i, smallest_cdist);
+        }
+
+        Stats::leaf(l - f);
+        for ( ; f != l ; ++f )
+        {
+            if ( update_one(view, block, first, f, point, p, out_i, smallest_cdist) )
+                return true;
+        }
+
+        return false;
+    }
+
+    template <typename It, typename Value>
+    static inline bool apply(View const& view, block_type const& block, It first,
+                             std::size_t f, std::size_t l,
+                             Value const& point, double const* p,
+                             std::size_t & out_i, double & smallest_cdist)
+    {
+        typename Stats::scope scope;
+        Stats::node();
+
+        std::size_t const nth = f + (l - f) / 2;
+
+        if ( update_one(view, block, first, nth, point, p, out_i, smallest_cdist) )
+            return true;
+
+        // the splitting plane is somewhere between lo and hi
+        typename View::quantized_type const q = view.at(nth)[I];
+        double const lo = block.lo(I, q);
+        double const hi = block.hi(I, q);
+
+        if ( p[I] < lo )
+        {
+            if ( per_branch(view, block, first, f, nth, point, p, out_i, smallest_cdist) )
+                return true;
+
+            double const axis = lo - p[I];
+            if ( smallest_cdist < axis * axis )
+            {
+                Stats::prune();
+                return false;
+            }
+
+            return per_branch(view, block, first, nth + 1, l, point, p, out_i, smallest_cdist);
+        }
+        else if ( hi < p[I] )
+        {
+            if ( per_branch(view, block, first, nth + 1, l, point, p, out_i, smallest_cdist) )
+                return true;
+
+            double const axis = p[I] - hi;
+            if ( smallest_cdist < axis * axis )
+            {
+                Stats::prune();
+                return false;
+            }
+
+            return per_branch(view, block, first, f, nth, point, p, out_i, smallest_cdist);
+        }
+        else
+        {
+            return per_branch(view, block, first, f, nth, point, p, out_i, smallest_cdist)
+                || per_branch(view, block, first, nth + 1, l, point, p, out_i, smallest_cdist);
+        }
+    }
+};
+
+// Above the blocks the exact coordinates of the splitting planes are stored
+// so the pruning is the same as in kd_nearest_impl.
+template <typename View, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN,
+          typename Stats = kd_default_stats>
+struct kd_quantized_nearest_impl
+{
+    static const std::size_t next_dimension = (I+1) % View::dimension;
+
+    template <typename It, typename Value>
+    static inline bool per_branch(View const& view, It first, std::size_t f, std::size_t l, std::size_t node,
+                                  Value const& point, double const* p,
+                                  std::size_t & out_i, double & smallest_cdist)
+    {
+        if ( l - f > View::block_size )
+        {
+            return kd_quantized_nearest_impl<View, next_dimension, ValuesMin, Stats>
+                        ::apply(view, first, f, l, node, point, p, out_i, smallest_cdist);
+        }
+        else
+        {
+            return kd_quantized_block_nearest_impl<View, I, ValuesMin, Stats>
+                        ::per_branch(view, view.block(node), first, f, l, point, p, out_i, smallest_cdist);
+        }
+    }
+
+    template <typename It, typename Value>
+    static inline bool apply(View const& view, It first, std::size_t f, std::size_t l, std::size_t node,
+                             Value const& point, double const* p,
+                             std::size_t & out_i, double & smallest_cdist)
+    {
+        typename Stats::scope scope;
+        Stats::node();
+
+        std::size_t const nth = f + (l - f) / 2;
+        double const c = view.splits[node];
+        double axis_cdist = p[I] - c;
+        axis_cdist *= axis_cdist;
+
+        // the median can't be closer than the plane
+        if ( ! (smallest_cdist < axis_cdist) )
+        {
+            Stats::distance();
+            double const cdist = double(geometry::comparable_distance(point, *(first + nth)));
+            if ( cdist < smallest_cdist )
+            {
+                smallest_cdist = cdist;
+                out_i = nth;
+                if ( math::equals(smallest_cdist, 0.0) )
+                    return true;
+            }
+        }
+
+        if ( p[I] < c )
+        {
+            if ( per_branch(view, first, f, nth, 2 * node, point, p, out_i, smallest_cdist) )
+                return true;
+
+            if ( smallest_cdist < axis_cdist )
+            {
+                Stats::prune();
+                return false;
+            }
+
+            return per_branch(view, first, nth + 1, l, 2 * node + 1, point, p, out_i, smallest_cdist);
+        }
+        else if ( c < p[I] )
+        {
+            if ( per_branch(view, first, nth + 1, l, 2 * node + 1, point, p, out_i, smallest_cdist) )
+                return true;
+
+            if ( smallest_cdist < axis_cdist )
+            {
+                Stats::prune();
+                return false;
+            }
+
+            return per_branch(view, first, f, nth, 2 * node, point, p, out_i, smallest_cdist);
+        }
+        else
+        {
+            return per_branch(view, first, f, nth, 2 * node, point, p, out_i, smallest_cdist)
+                || per_branch(view, first, nth + 1, l, 2 * node + 1, point, p, out_i, smallest_cdist);
+        }
+    }
+};
+
+// ---------------------------------------------------------------------- //
+
+template <typename View, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_quantized_block_binary_search_impl
+{
+    static const std::size_t next_dimension = (I+1) % View::dimension;
+    typedef typename View::block_type block_type;
+
+    template <typename It, typename Value>
+    static inline bool check_one(View const& view, block_type const& block, It first, std::size_t i,
+                                 Value const& value, double const* v)
+    {
+        return block.may_equal(view.at(i), v)
+            && geometry::equals(*(first + i), value);
+    }
+
+    template <typename It, typename Value>
+    static inline bool per_branch(View const& view, block_type const& block, It first,
+                                  std::size_t f, std::size_t l, Value const& value, double const* v)
+    {
+        if ( l - f > ValuesMin )
+        {
+            return kd_quantized_block_binary_search_impl<View, next_dimension, ValuesMin>
+                        ::apply(view, block, first, f, l, value, v);
+        }
+
+        for ( ; f != l ; ++f )
+        {
+            if ( check_one(view, block, first, f, value, v) )
+                return true;
+        }
+
+        return false;
+    }
+
+    template <typename It, typename Value>
+    static inline bool apply(View const& view, block_type const& block, It first,
+                             std::size_t f, std::size_t l, Value const& value, double const* v)
+    {
+        std::size_t const nth = f + (l - f) / 2;
+
+        if ( check_one(view, block, first, nth, value, v) )
+            return true;
+
+        typename View::quantized_type const q = view.at(nth)[I];
+
+        if ( v[I] < block.lo(I, q) )
+        {
+            return per_branch(view, block, first, f, nth, value, v);
+        }
+        else if ( block.hi(I, q) < v[I] )
+        {
+            return per_branch(view, block, first, nth + 1, l, value, v);
+        }
+        else
+        {
+            return per_branch(view, block, first, f, nth, value, v)
+                || per_branch(view, block, first, nth + 1, l, value, v);
+        }
+    }
+};
+
+template <typename View, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_quantized_binary_search_impl
+{
+    static const std::size_t next_dimension = (I+1) % View::dimension;
+
+    template <typename It, typename Value>
+    static inline bool per_branch(View const& view, It first, std::size_t f, std::size_t l, std::size_t node,
+                                  Value const& value, double const* v)
+    {
+        if ( l - f > View::block_size )
+        {
+            return kd_quantized_binary_search_impl<View, next_dimension, ValuesMin>
+                        ::apply(view, first, f, l, node, value, v);
+        }
+        else
+        {
+            return kd_quantized_block_binary_search_impl<View, I, ValuesMin>
+                        ::per_branch(view, view.block(node), first, f, l, value, v);
+        }
+    }
+
+    template <typename It, typename Value>
+    static inline bool apply(View const& view, It first, std::size_t f, std::size_t l, std::size_t node,
+                             Value const& value, double const* v)
+    {
+        std::size_t const nth = f + (l - f) / 2;
+        double const c = view.splits[node];
+
+        if ( v[I] < c )
+        {
+            return per_branch(view, first, f, nth, 2 * node, value, v);
+        }
+        else if ( c < v[I] )
+        {
+            return per_branch(view, first, nth + 1, l, 2 * node + 1, value, v);
+        }
+        else
+        {
+            return geometry::equals(*(first + nth), value)
+                || per_branch(view, first, f, nth, 2 * node, value, v)
+                || per_branch(view, first, nth + 1, l, 2 * node + 1, value, v);
+        }
+    }
+};
+
+// ---------------------------------------------------------------------- //
+
+// The compact index of the Points sorted with kd_sort(). The range is divided
+// into the blocks, the subranges of at most BlockSize values created by the
+// median recursion. The coordinates of the values of each block are stored as
+// the Quantized offsets relative to the bounding box of the block, e.g. 4 bytes
+// per 2D point for 16-bit offsets. Above the blocks only the coordinates of the
+// splitting planes are stored. The nodes are numbered like in kd_split_axes.
+// The queries traverse the compact arrays and read the full precision values
+// from the sorted range only for the candidates which may be the result, so the
+// range may be stored in a slower memory, e.g. mapped from a file, see kd_file.
+// The results are exact.
+template <typename Point, typename Quantized = boost::uint16_t, std::size_t BlockSize = 256>
+class kd_quantized_index
+{
+    BOOST_MPL_ASSERT_MSG((boost::is_same<typename geometry::tag<Point>::type, point_tag>::value),
+                         NOT_IMPLEMENTED_FOR_THIS_VALUE_TYPE, (Point));
+    BOOST_MPL_ASSERT_MSG((BlockSize > BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN),
+                         BLOCK_SIZE_MUST_BE_GREATER_THAN_VALUES_MIN, (kd_quantized_index));
+
+public:
+    static const std::size_t dimension = geometry::dimension<Point>::value;
+    typedef kd_quantized_view<Quantized, dimension, BlockSize> view_type;
+    typedef typename view_type::block_type block_type;
+
+    kd_quantized_index()
+        : m_size(0)
+    {}
+
+    // sorts the range with kd_sort() and stores the quantized coordinates
+    template <typename RandomIt>
+    void build(RandomIt first, RandomIt last)
+    {
+        m_size = static_cast<std::size_t>(std::distance(first, last));
+        kd_sort(first, last);
+
+        std::size_t const nodes_count = kd_split_axes_nodes_count<BlockSize>(m_size);
+        m_splits.assign(nodes_count, 0.0);
+        // the blocks are the children of the nodes above or the root
+        // there are fewer splitting nodes than nodes_count so at most nodes_count leaves
+        m_blocks.assign(nodes_count, block_type());
+        m_coords.assign(m_size * dimension, Quantized(0));
+
+        if ( m_size > 0 )
+            build_node(first, 0, m_size, 1, 0);
+    }
+
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+    // the memory used by the index without the sorted range
+    std::size_t bytes() const
+    {
+        return m_splits.size() * sizeof(double)
+             + m_blocks.size() * sizeof(block_type)
+             + m_coords.size() * sizeof(Quantized);
+    }
+
+    // the range must be the one passed to build()
+    template <typename RandomIt, typename Value>
+    bool binary_search(RandomIt first, Value const& value) const
+    {
+        if ( m_size < 1 )
+            return false;
+
+        double v[dimension];
+        kd_soa_copy_coords<0, dimension>::apply(value, v);
+
+        // the root block is the branch of a node on the last axis
+        return m_size > BlockSize ?
+               kd_quantized_binary_search_impl<view_type>::apply(view(), first, 0, m_size, 1, value, v) :
+               kd_quantized_block_binary_search_impl<view_type, dimension - 1>::per_branch(view(), view().block(1), first, 0, m_size, value, v);
+    }
+
+    // the range must be the one passed to build(), the result is the position in the range
+    template <typename RandomIt, typename Value>
+    bool nearest(RandomIt first, Value const& point, std::size_t & result) const
+    {
+        if ( m_size < 1 )
+            return false;
+
+        double p[dimension];
+        kd_soa_copy_coords<0, dimension>::apply(point, p);
+
+        std::size_t out_i = 0;
+        double cdist = double(geometry::comparable_distance(point, *first));
+
+        if ( m_size > BlockSize )
+        {
+            kd_quantized_nearest_impl<view_type, 0, BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN, kd_default_stats>
+                ::apply(view(), first, 0, m_size, 1, point, p, out_i, cdist);
+        }
+        else
+        {
+            // the root block is the branch of a node on the last axis
+            kd_quantized_block_nearest_impl<view_type, dimension - 1, BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN, kd_default_stats>
+                ::per_branch(view(), view().block(1), first, 0, m_size, point, p, out_i, cdist);
+        }
+
+        result = out_i;
+
+        return true;
+    }
+
+private:
+    template <typename RandomIt>
+    void build_node(RandomIt first, std::size_t f, std::size_t l, std::size_t node, std::size_t axis)
+    {
+        if ( l - f <= BlockSize )
+        {
+            build_block(first, f, l, m_blocks[view_type::block_index(node, m_splits.size())]);
+            return;
+        }
+
+        std::size_t const nth = f + (l - f) / 2;
+        double c[dimension];
+        kd_soa_copy_coords<0, dimension>::apply(*(first + nth), c);
+        m_splits[node] = c[axis];
+
+        std::size_t const next_axis = (axis + 1) % dimension;
+        build_node(first, f, nth, 2 * node, next_axis);
+        build_node(first, nth + 1, l, 2 * node + 1, next_axis);
+    }
+
+    template <typename RandomIt>
+    void build_block(RandomIt first, std::size_t f, std::size_t l, block_type & block)
+    {
+        double mins[dimension], maxs[dimension], c[dimension];
+        kd_soa_copy_coords<0, dimension>::apply(*(first + f), mins);
+        std::copy(mins, mins + dimension, maxs);
+        for ( std::size_t i = f + 1 ; i < l ; ++i )
+        {
+            kd_soa_copy_coords<0, dimension>::apply(*(first + i), c);
+            for ( std::size_t d = 0 ; d < dimension ; ++d )
+            {
+                if ( c[d] < mins[d] )
+                    mins[d] = c[d];
+                if ( maxs[d] < c[d] )
+                    maxs[d] = c[d];
+            }
+        }
+
+        for ( std::size_t d = 0 ; d < dimension ; ++d )
+        {
+            block.min[d] = mins[d];
+            block.scale[d] = (maxs[d] - mins[d]) / double(block_type::max_offset);
+        }
+
+        for ( std::size_t i = f ; i < l ; ++i )
+        {
+            kd_soa_copy_coords<0, dimension>::apply(*(first + i), c);
+            for ( std::size_t d = 0 ; d < dimension ; ++d )
+                m_coords[i * dimension + d] = block.quantize(d, c[d]);
+        }
+    }
+
+    view_type view() const
+    {
+        view_type result;
+        result.splits = m_splits.empty() ? 0 : &m_splits[0];
+        result.blocks = &m_blocks[0];
+        result.coords = &m_coords[0];
+        result.nodes_count = m_splits.size();
+        return result;
+    }
+
+    std::size_t m_size;
+    std::vector<double> m_splits;
+    std::vector<block_type> m_blocks;
+    std::vector<Quantized> m_coords;
+};
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_QUANTIZED_INDEX_HPP
@@ -0,0 +1,432 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_SOA_INDEX_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_SOA_INDEX_HPP
+
+#include <vector>
+
+#include <boost/array.hpp>
+
+#include "kd_sort.hpp"
+#include "kd_sort_indexes.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+template <std::size_t I, std::size_t Dimension>
+struct kd_soa_copy_coords
+{
+    template <typename Point, typename T>
+    static inline void apply(Point const& point, T * out)
+    {
+        out[I] = static_cast<T>(geometry::get<I>(point));
+        kd_soa_copy_coords<I+1, Dimension>::apply(point, out);
+    }
+};
+
+template <std::size_t Dimension>
+struct kd_soa_copy_coords<Dimension, Dimension>
+{
+    template <typename Point, typename T>
+    static inline void apply(Point const&, T *) {}
+};
+
+template <std::size_t I, std::size_t Dimension>
+struct kd_soa_copy_box_coords
+{
+    template <typename Box, typename T>
+    static inline void apply(Box const& box, T * min_out, T * max_out)
+    {
+        min_out[I] = static_cast<T>(geometry::get<min_corner, I>(box));
+        max_out[I] = static_cast<T>(geometry::get<max_corner, I>(box));
+        kd_soa_copy_box_coords<I+1, Dimension>::apply(box, min_out, max_out);
+    }
+};
+
+template <std::size_t Dimension>
+struct kd_soa_copy_box_coords<Dimension, Dimension>
+{
+    template <typename Box, typename T>
+    static inline void apply(Box const&, T *, T *) {}
+};
+
+// ---------------------------------------------------------------------- //
+
+// In all of the traversals below only the coordinates of the split axis are read
+// in the internal nodes. The other coordinates of the median are read only if
+// the median may be the result. In the leaves all coordinates are read.
+
+// The coordinates of the value V may have a different type than the ones
+// of the index T, they are not converted to T.
+template <typename T, typename V, std::size_t Dimension, std::size_t I = 0>
+struct kd_soa_binary_search_impl
+{
+    static const std::size_t next_dimension = (I+1) % Dimension;
+
+    static inline bool equals(T const* const* coords, std::size_t i, V const* value)
+    {
+        for ( std::size_t d = 0 ; d < Dimension ; ++d )
+        {
+            if ( ! math::equals(coords[d][i], value[d]) )
+                return false;
+        }
+        return true;
+    }
+
+    static inline bool per_branch(T const* const* coords, std::size_t first, std::size_t last, V const* value)
+    {
+        if ( last - first > BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN )
+        {
+            return kd_soa_binary_search_impl<T, V, Dimension, next_dimension>::apply(coords, first, last, value);
+        }
+        else
+        {
+            for ( ; first != last ; ++first )
+            {
+                if ( equals(coords, first, value) )
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    static inline bool apply(T const* const* coords, std::size_t first, std::size_t last, V const* value)
+    {
+        std::size_t size = last - first;
+        std::size_t nth = first + size / 2;
+        T const& c = coords[I][nth];
+
+        if ( math::equals(c, value[I]) && equals(coords, nth, value) )
+            return true;
+
+        if ( size == 1 )
+            return false;
+
+        if ( value[I] < c )
+        {
+            return per_branch(coords, first, nth, value);
+        }
+        else if ( c < value[I] )
+        {
+            return per_branch(coords, nth+1, last, value);
+        }
+        else
+        {
+            return per_branch(coords, first, nth, value)
+                || per_branch(coords, nth+1, last, value);
+        }
+    }
+};
+
+// ---------------------------------------------------------------------- //
+
+template <typename T, std::size_t Dimension, std::size_t I = 0>
+struct kd_soa_nearest_impl
+{
+    static const std::size_t next_dimension = (I+1) % Dimension;
+
+    // the same order of operations as in the pythagoras strategy
+    static inline double cdist(T const* const* coords, std::size_t i, double const* point)
+    {
+        double result = 0;
+        for ( std::size_t d = 0 ; d < Dimension ; ++d )
+        {
+            double const v = double(coords[d][i]) - point[d];
+            result = v * v + result;
+        }
+        return result;
+    }
+
+    static inline bool update_one(T const* const* coords, std::size_t i, double const* point,
+                                  std::size_t & out_i, double & smallest_cdist)
+    {
+        double c = cdist(coords, i, point);
+        if ( c < smallest_cdist )
+        {
+            smallest_cdist = c;
+            out_i = i;
+        }
+
+        return math::equals(smallest_cdist, 0.0);
+    }
+
+    static inline bool per_branch(T const* const* coords, std::size_t first, std::size_t last, double const* point,
+                                  std::size_t & out_i, double & smallest_cdist)
+    {
+        if ( last - first > BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN )
+        {
+            if ( kd_soa_nearest_impl<T, Dimension, next_dimension>::apply(coords, first, last, point, out_i, smallest_cdist) )
+                return true;
+        }
+        else
+        {
+            for ( ; first != last ; ++first )
+            {
+                if ( update_one(coords, first, point, out_i, smallest_cdist) )
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    static inline bool apply(T const* const* coords, std::size_t first, std::size_t last, double const* point,
+                             std::size_t & out_i, double & smallest_cdist)
+    {
+        std::size_t nth = first + (last - first) / 2;
+        double const c = coords[I][nth];
+        double axis_cdist = point[I] - c;
+        axis_cdist *= axis_cdist;
+
+        // the median can't be closer than the plane
+        if ( ! (smallest_cdist < axis_cdist) )
+        {
+            if ( update_one(coords, nth, point, out_i, smallest_cdist) )
+                return true;
+        }
+
+        if ( point[I] < c )
+        {
+            if ( per_branch(coords, first, nth, point, out_i, smallest_cdist) )
+                return true;
+
+            if ( smallest_cdist < axis_cdist )
+                return false;
+
+            return per_branch(coords, nth+1, last, point, out_i, smallest_cdist);
+        }
+        else if ( c < point[I] )
+        {
+            if ( per_branch(coords, nth+1, last, point, out_i, smallest_cdist) )
+                return true;
+
+            if ( smallest_cdist < axis_cdist )
+                return false;
+
+            return per_branch(coords, first, nth, point, out_i, smallest_cdist);
+        }
+        else
+        {
+            if ( per_branch(coords, first, nth, point, out_i, smallest_cdist) )
+                return true;
+
+            return per_branch(coords, nth+1, last, point, out_i, smallest_cdist);
+        }
+    }
+};
+
+// ---------------------------------------------------------------------- //
+
+// The corners of the box have the coordinates of type C, see kd_soa_binary_search_impl
+template <typename T, typename C, std::size_t Dimension, std::size_t I = 0>
+struct kd_soa_query_within_impl
+{
+    static const std::size_t next_dimension = (I+1) % Dimension;
+
+    template <typename OutIt>
+    static inline void update_one(T const* const* coords, std::size_t i,
+                                  C const* min_corner, C const* max_corner,
+                                  std::size_t const* permutation, OutIt & out_it, std::size_t & count)
+    {
+        for ( std::size_t d = 0 ; d < Dimension ; ++d )
+        {
+            if ( coords[d][i] < min_corner[d] || max_corner[d] < coords[d][i] )
+                return;
+        }
+
+        *out_it = permutation[i];
+        ++out_it;
+        ++count;
+    }
+
+    template <typename OutIt>
+    static inline void per_branch(T const* const* coords, std::size_t first, std::size_t last,
+                                  C const* min_corner, C const* max_corner,
+                                  std::size_t const* permutation, OutIt & out_it, std::size_t & count)
+    {
+        if ( last - first > BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN )
+        {
+            kd_soa_query_within_impl<T, C, Dimension, next_dimension>
+                ::apply(coords, first, last, min_corner, max_corner, permutation, out_it, count);
+        }
+        else
+        {
+            for ( ; first != last ; ++first )
+            {
+                update_one(coords, first, min_corner, max_corner, permutation, out_it, count);
+            }
+        }
+    }
+
+    template <typename OutIt>
+    static inline void apply(T const* const* coords, std::size_t first, std::size_t last,
+                             C const* min_corner, C const* max_corner,
+                             std::size_t const* permutation, OutIt & out_it, std::size_t & count)
+    {
+        std::size_t nth = first + (last - first) / 2;
+        T const& c = coords[I][nth];
+
+        bool const not_less = ! (c < min_corner[I]);
+        bool const not_greater = ! (max_corner[I] < c);
+
+        if ( not_less && not_greater )
+        {
+            update_one(coords, nth, min_corner, max_corner, permutation, out_it, count);
+        }
+        if ( not_less )
+        {
+            per_branch(coords, first, nth, min_corner, max_corner, permutation, out_it, count);
+        }
+        if ( not_greater )
+        {
+            per_branch(coords, nth+1, last, min_corner, max_corner, permutation, out_it, count);
+        }
+    }
+};
+
+// ---------------------------------------------------------------------- //
+
+// The Structure of Arrays kd index of Points. The points are ordered by the same
+// median recursion as in kd_sort(), the coordinates are stored in a separate array
+// per dimension along with the positions of the points in the original range.
+// The queries return these positions.
+template <typename Point>
+class kd_soa_index
+{
+    BOOST_MPL_ASSERT_MSG((boost::is_same<typename geometry::tag<Point>::type, point_tag>::value),
+                         NOT_IMPLEMENTED_FOR_THIS_VALUE_TYPE, (Point));
+
+public:
+    typedef typename geometry::coordinate_type<Point>::type coordinate_type;
+    static const std::size_t dimension = geometry::dimension<Point>::value;
+
+    kd_soa_index() {}
+
+    template <typename RandomIt>
+    kd_soa_index(RandomIt first, RandomIt last)
+    {
+        build(first, last);
+    }
+
+    template <typename RandomIt>
+    void build(RandomIt first, RandomIt last)
+    {
+        std::size_t const count = static_cast<std::size_t>(std::distance(first, last));
+
+        m_permutation.resize(count);
+        for ( std::size_t i = 0 ; i < count ; ++i )
+            m_permutation[i] = i;
+
+        if ( count > 1 )
+            kd_sort_indexes_impl<Point>::apply(first, m_permutation.begin(), m_permutation.end());
+
+        for ( std::size_t d = 0 ; d < dimension ; ++d )
+            m_coords[d].resize(count);
+
+        coordinate_type point[dimension];
+        for ( std::size_t i = 0 ; i < count ; ++i )
+        {
+            kd_soa_copy_coords<0, dimension>::apply(*(first + m_permutation[i]), point);
+            for ( std::size_t d = 0 ; d < dimension ; ++d )
+                m_coords[d][i] = point[d];
+        }
+    }
+
+    std::size_t size() const
+    {
+        return m_permutation.size();
+    }
+
+    // the position in the original range of the i-th point of the index
+    std::size_t original_index(std::size_t i) const
+    {
+        return m_permutation[i];
+    }
+
+    template <typename Value>
+    bool binary_search(Value const& value) const
+    {
+        if ( size() < 1 )
+            return false;
+
+        // not converted to coordinate_type, otherwise e.g. the index of integral
+        // coordinates would contain the truncated floating point value
+        typedef typename geometry::coordinate_type<Value>::type value_coordinate_type;
+        value_coordinate_type v[dimension];
+        kd_soa_copy_coords<0, dimension>::apply(value, v);
+
+        coords_ptrs_type coords = coords_ptrs();
+        return kd_soa_binary_search_impl<coordinate_type, value_coordinate_type, dimension>
+                    ::apply(coords.data(), 0, size(), v);
+    }
+
+    template <typename Value>
+    bool nearest(Value const& point, std::size_t & result) const
+    {
+        if ( size() < 1 )
+            return false;
+
+        double p[dimension];
+        kd_soa_copy_coords<0, dimension>::apply(point, p);
+
+        coords_ptrs_type coords = coords_ptrs();
+        std::size_t out_i = 0;
+        double cdist = kd_soa_nearest_impl<coordinate_type, dimension>::cdist(coords.data(), 0, p);
+
+        kd_soa_nearest_impl<coordinate_type, dimension>
+            ::apply(coords.data(), 0, size(), p, out_i, cdist);
+
+        result = m_permutation[out_i];
+
+        return true;
+    }
+
+    // writes the positions of the points covered by the box,
+    // returns the number of positions written
+    template <typename Box, typename OutIt>
+    std::size_t query_within(Box const& box, OutIt out_it) const
+    {
+        if ( size() < 1 )
+            return 0;
+
+        // not converted to coordinate_type, the box would be shrunk or enlarged
+        typedef typename geometry::coordinate_type<Box>::type box_coordinate_type;
+        box_coordinate_type min_c[dimension];
+        box_coordinate_type max_c[dimension];
+        kd_soa_copy_box_coords<0, dimension>::apply(box, min_c, max_c);
+
+        coords_ptrs_type coords = coords_ptrs();
+        std::size_t count = 0;
+        kd_soa_query_within_impl<coordinate_type, box_coordinate_type, dimension>
+            ::apply(coords.data(), 0, size(), min_c, max_c, &m_permutation[0], out_it, count);
+
+        return count;
+    }
+
+private:
+    typedef boost::array<coordinate_type const*, dimension> coords_ptrs_type;
+
+    // called only if the index is not empty
+    coords_ptrs_type coords_ptrs() const
+    {
+        coords_ptrs_type result;
+        for ( std::size_t d = 0 ; d < dimension ; ++d )
+            result[d] = &m_coords[d][0];
+        return result;
+    }
+
+    boost::array<std::vector<coordinate_type>, dimension> m_coords;
+    std::vector<std::size_t> m_permutation;
+};
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_SOA_INDEX_HPP
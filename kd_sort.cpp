@@ -4,8 +4,17 @@
 // Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
 // http://www.boost.org/LICENSE_1_0.txt)
 
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
 #include <boost/chrono.hpp>
 #include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/random.hpp>
 #include <boost/tuple/tuple.hpp>
 
@@ -14,6 +23,23 @@
 
 #include "kd_sort.hpp"
 #include "kd_sort_left_balanced.hpp"
+#include "kd_sort_parallel.hpp"
+#include "kd_nearest_batch.hpp"
+#include "kd_nearest_join.hpp"
+#include "kd_soa_index.hpp"
+#include "kd_sort_spread.hpp"
+#include "kd_sort_three_way.hpp"
+#include "kd_sort_sampled.hpp"
+#include "kd_quantized_index.hpp"
+#include "kd_count_within.hpp"
+#include "kd_sort_blocked.hpp"
+#include "kd_sort_extents.hpp"
+#include "kd_sort_indexes.hpp"
+#include "kd_file.hpp"
+#include "kd_dynamic_index.hpp"
+#include "kd_tombstones.hpp"
+
+#include "kd_benchmark.hpp"
 
 typedef boost::tuple<float, float, float, float> pt_data;
 
@@ -34,6 +60,18 @@ void print(B const& b)
               << bg::get<bg::max_corner, 0>(b) << ", " <<  bg::get<bg::max_corner, 1>(b);
 }
 
+// a coordinate of the result of a query, added to the dummy so the compiler
+// can't remove the query
+double first_coordinate(P const& p)
+{
+    return bg::get<0>(p);
+}
+
+double first_coordinate(B const& b)
+{
+    return bg::get<bg::min_corner, 0>(b);
+}
+
 #ifndef TEST_BOXES
 typedef P V;
 P to_v(pt_data const& c)
@@ -48,188 +86,2241 @@ B to_v(pt_data const& c)
 }
 #endif
 
-int main()
+// the result of a query, zeroed so it's not used uninitialized
+// if the query fails and the failure is reported
+V zero_v()
+{
+    V result;
+    bg::assign_zero(result);
+    return result;
+}
+
+// the heavy values, moved whole by kd_sort() or indexed
+struct record_payload
+{
+    char data[200 - sizeof(V)];
+};
+typedef std::pair<V, record_payload> record;
+
+// the same as the record but adapted to the concept of V so kd_sort() can move it
+struct heavy_value
+{
+    V indexable;
+    record_payload payload;
+};
+
+namespace boost { namespace geometry { namespace traits {
+
+template <> struct tag<heavy_value> { typedef geometry::tag<V>::type type; };
+template <> struct coordinate_type<heavy_value> { typedef geometry::coordinate_type<V>::type type; };
+template <> struct coordinate_system<heavy_value> { typedef geometry::coordinate_system<V>::type type; };
+template <> struct dimension<heavy_value> : geometry::dimension<V> {};
+template <> struct point_type<heavy_value> { typedef geometry::point_type<V>::type type; };
+
+template <std::size_t D>
+struct access<heavy_value, D>
+{
+    static inline double get(heavy_value const& v) { return geometry::get<D>(v.indexable); }
+    static inline void set(heavy_value & v, double value) { geometry::set<D>(v.indexable, value); }
+};
+
+template <std::size_t Index, std::size_t D>
+struct indexed_access<heavy_value, Index, D>
+{
+    static inline double get(heavy_value const& v) { return geometry::get<Index, D>(v.indexable); }
+    static inline void set(heavy_value & v, double value) { geometry::set<Index, D>(v.indexable, value); }
+};
+
+}}} // namespace boost::geometry::traits
+
+B to_query_box(pt_data const& c)
+{
+    return B(P(boost::get<0>(c), boost::get<1>(c)), P(boost::get<0>(c) + 20, boost::get<1>(c) + 20));
+}
+
+struct tune_times
+{
+    float sort, binary_search, nearest;
+};
+
+// builds and queries the data with the maximum number of values in a leaf
+// equal to ValuesMin
+template <std::size_t ValuesMin>
+tune_times tune_leaf_size(std::vector<pt_data> const& coords)
 {
     typedef boost::chrono::thread_clock clock_t;
     typedef boost::chrono::duration<float> dur_t;
 
-#if !defined(_DEBUG) || defined(NDEBUG)
-    size_t values_count = 1000000;
-#else
-    size_t values_count = 100;
-#endif
-
-    std::vector<pt_data> coords;
+    tune_times result;
+    std::vector<V> v(coords.size());
+    std::transform(coords.begin(), coords.end(), v.begin(), to_v);
 
-    //randomize values
     {
-        boost::mt19937 rng;
-        //rng.seed(static_cast<unsigned int>(std::time(0)));
-        boost::uniform_real<float> range_pos(-1000, 1000);
-        boost::variate_generator<boost::mt19937&, boost::uniform_real<float> > rnd_pos(rng, range_pos);
-        boost::uniform_real<float> range_size(10, 50);
-        boost::variate_generator<boost::mt19937&, boost::uniform_real<float> > rnd_size(rng, range_size);
+        clock_t::time_point start = clock_t::now();
+        bgi::detail::kd_sort<ValuesMin>(v.begin(), v.end());
+        result.sort = dur_t(clock_t::now() - start).count();
+    }
 
-        coords.reserve(values_count);
+    std::size_t dummy = 0;
 
-        std::cout << "randomizing data\n";
-        for ( size_t i = 0 ; i < values_count ; ++i )
+    {
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
         {
-            coords.push_back(boost::make_tuple(rnd_pos(), rnd_pos(), rnd_size(), rnd_size()));
+            dummy += int(bgi::detail::kd_binary_search<ValuesMin>(v.begin(), v.end(), to_v(c)));
         }
-        std::cout << "randomized\n";
+        result.binary_search = dur_t(clock_t::now() - start).count();
     }
 
-    for (;;)
     {
-        std::vector<V> v1, v2, v3;
-        
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
         {
-            v1.reserve(values_count);
-            v2.reserve(values_count);
-            v3.reserve(values_count);
-            BOOST_FOREACH(pt_data const& c, coords)
-            {
-                v1.push_back(to_v(c));
-                v2.push_back(to_v(c));
-                v3.push_back(to_v(c));
-            }
+            P p(boost::get<0>(c), 0);
+            V r = zero_v();
+            dummy += int(bgi::detail::kd_nearest<ValuesMin>(v.begin(), v.end(), p, r))
+                   + int(first_coordinate(r) != 0);
         }
+        result.nearest = dur_t(clock_t::now() - start).count();
+    }
 
-        std::cout << "------------------------------------------------" << std::endl;
+    std::cout << ValuesMin << '\t' << result.sort << '\t' << result.binary_search
+              << '\t' << result.nearest << "\t(dummy: " << dummy << ')' << std::endl;
 
+    return result;
+}
+
+// measures the leaf sizes 1 - 128 on this machine and data
+// the best one may be set with BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN
+void tune_leaf_sizes(std::vector<pt_data> const& coords)
+{
+    std::size_t const sizes[] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    tune_times times[8];
+
+    std::cout << "leaf\tkd_sort\tkd_binary_search\tkd_nearest" << std::endl;
+    times[0] = tune_leaf_size<1>(coords);
+    times[1] = tune_leaf_size<2>(coords);
+    times[2] = tune_leaf_size<4>(coords);
+    times[3] = tune_leaf_size<8>(coords);
+    times[4] = tune_leaf_size<16>(coords);
+    times[5] = tune_leaf_size<32>(coords);
+    times[6] = tune_leaf_size<64>(coords);
+    times[7] = tune_leaf_size<128>(coords);
+
+    std::size_t best_sort = 0, best_binary_search = 0, best_nearest = 0, best_queries = 0;
+    for ( std::size_t i = 1 ; i < 8 ; ++i )
+    {
+        if ( times[i].sort < times[best_sort].sort )
+            best_sort = i;
+        if ( times[i].binary_search < times[best_binary_search].binary_search )
+            best_binary_search = i;
+        if ( times[i].nearest < times[best_nearest].nearest )
+            best_nearest = i;
+        if ( times[i].binary_search + times[i].nearest
+           < times[best_queries].binary_search + times[best_queries].nearest )
+            best_queries = i;
+    }
+
+    std::cout << "best kd_sort(): " << sizes[best_sort] << std::endl;
+    std::cout << "best kd_binary_search(): " << sizes[best_binary_search] << std::endl;
+    std::cout << "best kd_nearest(): " << sizes[best_nearest] << std::endl;
+    std::cout << "best queries: " << sizes[best_queries] << std::endl;
+}
+
+// clusters of values around random centers
+void randomize_clustered(std::vector<pt_data> & coords, size_t values_count)
+{
+    boost::mt19937 rng(1);
+    boost::uniform_real<float> range_pos(-1000, 1000);
+    boost::variate_generator<boost::mt19937&, boost::uniform_real<float> > rnd_pos(rng, range_pos);
+    boost::normal_distribution<float> range_offset(0, 5);
+    boost::variate_generator<boost::mt19937&, boost::normal_distribution<float> > rnd_offset(rng, range_offset);
+    boost::uniform_real<float> range_size(10, 50);
+    boost::variate_generator<boost::mt19937&, boost::uniform_real<float> > rnd_size(rng, range_size);
+
+    std::vector<P> centers;
+    for ( size_t i = 0 ; i < 50 ; ++i )
+        centers.push_back(P(rnd_pos(), rnd_pos()));
+
+    coords.reserve(values_count);
+    for ( size_t i = 0 ; i < values_count ; ++i )
+    {
+        P const& c = centers[i % centers.size()];
+        coords.push_back(boost::make_tuple(bg::get<0>(c) + rnd_offset(), bg::get<1>(c) + rnd_offset(),
+                                           rnd_size(), rnd_size()));
+    }
+}
+
+// long and thin, e.g. a road
+void randomize_skewed(std::vector<pt_data> & coords, size_t values_count)
+{
+    boost::mt19937 rng(2);
+    boost::uniform_real<float> range_x(-1000, 1000);
+    boost::variate_generator<boost::mt19937&, boost::uniform_real<float> > rnd_x(rng, range_x);
+    boost::uniform_real<float> range_y(-1, 1);
+    boost::variate_generator<boost::mt19937&, boost::uniform_real<float> > rnd_y(rng, range_y);
+    boost::uniform_real<float> range_size(0.01f, 0.05f);
+    boost::variate_generator<boost::mt19937&, boost::uniform_real<float> > rnd_size(rng, range_size);
+
+    coords.reserve(values_count);
+    for ( size_t i = 0 ; i < values_count ; ++i )
+    {
+        coords.push_back(boost::make_tuple(rnd_x(), rnd_y(), rnd_size(), rnd_size()));
+    }
+}
+
+// snapped to the grid, many values share the same coordinate, e.g. GPS fixes
+// snapped to the cells
+void randomize_snapped(std::vector<pt_data> & coords, size_t values_count)
+{
+    boost::mt19937 rng(3);
+    boost::uniform_int<int> range_cell(-100, 100);
+    boost::variate_generator<boost::mt19937&, boost::uniform_int<int> > rnd_cell(rng, range_cell);
+    boost::uniform_real<float> range_size(10, 50);
+    boost::variate_generator<boost::mt19937&, boost::uniform_real<float> > rnd_size(rng, range_size);
+
+    coords.reserve(values_count);
+    for ( size_t i = 0 ; i < values_count ; ++i )
+    {
+        coords.push_back(boost::make_tuple(float(rnd_cell() * 10), float(rnd_cell() * 10),
+                                           rnd_size(), rnd_size()));
+    }
+}
+
+// the round-robin and the spread-based split axes
+void compare_split_axes(const char * name, std::vector<pt_data> const& coords)
+{
+    typedef boost::chrono::thread_clock clock_t;
+    typedef boost::chrono::duration<float> dur_t;
+
+    std::vector<V> v1(coords.size()), v2(coords.size());
+    std::transform(coords.begin(), coords.end(), v1.begin(), to_v);
+    std::transform(coords.begin(), coords.end(), v2.begin(), to_v);
+    bgi::detail::kd_split_axes<2> axes;
+
+    {
         clock_t::time_point start = clock_t::now();
-        bgi::rtree<V, bgi::linear<8> > rt(v1.begin(), v1.end());
+        bgi::detail::kd_sort(v1.begin(), v1.end());
         dur_t time = clock_t::now() - start;
-        std::cout << time << " - rtree()" << std::endl;
+        std::cout << time << " - kd_sort() " << name << std::endl;
+    }
 
-#ifndef TEST_BOXES
+    {
+        clock_t::time_point start = clock_t::now();
+        bgi::detail::kd_sort_spread(v2.begin(), v2.end(), axes);
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_sort_spread() " << name << std::endl;
+    }
+
+    {
+        std::size_t dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
         {
-            clock_t::time_point start = clock_t::now();
-            std::sort(v1.begin(), v1.end(), bg::less<P>());
-            dur_t time = clock_t::now() - start;
-            std::cout << time << " - std::sort()" << std::endl;
+            P p(boost::get<0>(c) + 0.5f, boost::get<1>(c) + 0.5f);
+            V r = zero_v();
+            dummy += int(bgi::detail::kd_nearest(v1.begin(), v1.end(), p, r))
+                   + int(first_coordinate(r) != 0);
         }
-#endif
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_nearest() " << name << std::endl;
+        std::cout << "dummy: " << dummy << ' ' << std::endl;
+    }
 
+    {
+        std::size_t dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
         {
-            clock_t::time_point start = clock_t::now();
-            bgi::detail::kd_sort(v2.begin(), v2.end());
-            dur_t time = clock_t::now() - start;
-            std::cout << time << " - kd_sort()" << std::endl;
+            P p(boost::get<0>(c) + 0.5f, boost::get<1>(c) + 0.5f);
+            V r = zero_v();
+            dummy += int(bgi::detail::kd_nearest_spread(v2.begin(), v2.end(), axes, p, r))
+                   + int(first_coordinate(r) != 0);
         }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_nearest_spread() " << name << std::endl;
+        std::cout << "dummy: " << dummy << ' ' << std::endl;
+    }
 
+    {
+        std::size_t dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
         {
-            clock_t::time_point start = clock_t::now();
-            bgi::detail::kd_sort_left_balanced(v3.begin(), v3.end());
-            dur_t time = clock_t::now() - start;
-            std::cout << time << " - kd_sort_left_balanced()" << std::endl;
+            dummy += int(bgi::detail::kd_binary_search_spread(v2.begin(), v2.end(), axes, to_v(c)));
         }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_binary_search_spread() " << name << std::endl;
+        std::cout << "dummy: " << dummy << std::endl;
+    }
 
-        std::cout << "------------------------------------------------" << std::endl;
-
+    int errors = 0;
+    BOOST_FOREACH(pt_data const& c, coords)
+    {
+        if ( ! bgi::detail::kd_binary_search_spread(v2.begin(), v2.end(), axes, to_v(c)) )
         {
-            std::size_t dummy = 0;
-            clock_t::time_point start = clock_t::now();
-            BOOST_FOREACH(pt_data const& c, coords)
-            {
-                bool is = rt.count(to_v(c)) > 0;
-
-                dummy += int(is);
-            }
-            dur_t time = clock_t::now() - start;
-            std::cout << time << " - rtree::count()" << std::endl;
-            std::cout << "dummy: " << dummy << std::endl;
+            std::cout << "kd_binary_search_spread results not compatible!" << std::endl;
+            ++errors;
         }
 
 #ifndef TEST_BOXES
+        P p(boost::get<0>(c) + 0.5f, boost::get<1>(c) + 0.5f);
+        V r1, r2;
+        bool const found1 = bgi::detail::kd_nearest(v1.begin(), v1.end(), p, r1);
+        bool const found2 = bgi::detail::kd_nearest_spread(v2.begin(), v2.end(), axes, p, r2);
+        if ( ! found1 || ! found2
+          || bg::comparable_distance(p, r1) != bg::comparable_distance(p, r2) )
         {
-            std::size_t dummy = 0;
-            clock_t::time_point start = clock_t::now();
-            BOOST_FOREACH(pt_data const& c, coords)
-            {
-                bool is = std::binary_search(v1.begin(), v1.end(), to_v(c), bg::less<P>());
-
-                dummy += int(is);
-            }
-            dur_t time = clock_t::now() - start;
-            std::cout << time << " - std::binary_search()" << std::endl;
-            std::cout << "dummy: " << dummy << std::endl;
+            std::cout << "kd_nearest and kd_nearest_spread results not compatible!" << std::endl;
+            print(p); std::cout << std::endl;
+            ++errors;
         }
 #endif
 
+        if ( errors > 10 )
+            break;
+    }
+}
+
+#ifndef TEST_BOXES
+// the median split and the three-way split of the values equal to the median
+void compare_three_way(const char * name, std::vector<pt_data> const& coords)
+{
+    typedef boost::chrono::thread_clock clock_t;
+    typedef boost::chrono::duration<float> dur_t;
+
+    std::vector<V> v1(coords.size()), v2(coords.size());
+    std::transform(coords.begin(), coords.end(), v1.begin(), to_v);
+    std::transform(coords.begin(), coords.end(), v2.begin(), to_v);
+
+    {
+        clock_t::time_point start = clock_t::now();
+        bgi::detail::kd_sort(v1.begin(), v1.end());
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_sort() " << name << std::endl;
+    }
+
+    {
+        clock_t::time_point start = clock_t::now();
+        bgi::detail::kd_sort_three_way(v2.begin(), v2.end());
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_sort_three_way() " << name << std::endl;
+    }
+
+    {
+        std::size_t dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
         {
-            std::size_t dummy = 0;
-            clock_t::time_point start = clock_t::now();
-            BOOST_FOREACH(pt_data const& c, coords)
-            {
-                bool is = bgi::detail::kd_binary_search(v2.begin(), v2.end(), to_v(c));
+            dummy += int(bgi::detail::kd_binary_search(v1.begin(), v1.end(), to_v(c)));
+        }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_binary_search() " << name << std::endl;
+        std::cout << "dummy: " << dummy << std::endl;
+    }
 
-                dummy += int(is);
-            }
-            dur_t time = clock_t::now() - start;
-            std::cout << time << " - kd_binary_search()" << std::endl;
-            std::cout << "dummy: " << dummy << std::endl;
+    {
+        std::size_t dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
+        {
+            dummy += int(bgi::detail::kd_binary_search_three_way(v2.begin(), v2.end(), to_v(c)));
         }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_binary_search_three_way() " << name << std::endl;
+        std::cout << "dummy: " << dummy << std::endl;
+    }
 
-        std::cout << "------------------------------------------------" << std::endl;
+    {
+        std::size_t dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
+        {
+            P p(boost::get<0>(c), 0);
+            V r = zero_v();
+            dummy += int(bgi::detail::kd_nearest(v1.begin(), v1.end(), p, r))
+                   + int(first_coordinate(r) != 0);
+        }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_nearest() " << name << std::endl;
+        std::cout << "dummy: " << dummy << ' ' << std::endl;
+    }
 
+    {
+        std::size_t dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
         {
-            std::size_t dummy = 0;
-            clock_t::time_point start = clock_t::now();
-            BOOST_FOREACH(pt_data const& c, coords)
-            {
-                P p(boost::get<0>(c), 0);
-                V r;
-                dummy += rt.query(bgi::nearest(p, 1), &r);
-            }
-            dur_t time = clock_t::now() - start;
-            std::cout << time << " - rtree::nearest()" << std::endl;
-            std::cout << "dummy: " << dummy << ' ' << std::endl;
+            P p(boost::get<0>(c), 0);
+            V r = zero_v();
+            dummy += int(bgi::detail::kd_nearest_three_way(v2.begin(), v2.end(), p, r))
+                   + int(first_coordinate(r) != 0);
         }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_nearest_three_way() " << name << std::endl;
+        std::cout << "dummy: " << dummy << ' ' << std::endl;
+    }
 
+    int errors = 0;
+    BOOST_FOREACH(pt_data const& c, coords)
+    {
+        if ( ! bgi::detail::kd_binary_search_three_way(v2.begin(), v2.end(), to_v(c)) )
         {
-            std::size_t dummy = 0;
-            clock_t::time_point start = clock_t::now();
-            BOOST_FOREACH(pt_data const& c, coords)
-            {
-                P p(boost::get<0>(c), 0);
-                V r;
-                bool is = bgi::detail::kd_nearest(v2.begin(), v2.end(), p, r);
-                dummy += int(is);
-            }
-            dur_t time = clock_t::now() - start;
-            std::cout << time << " - kd_nearest()" << std::endl;
-            std::cout << "dummy: " << dummy << ' ' << std::endl;
+            std::cout << "kd_binary_search_three_way results not compatible!" << std::endl;
+            ++errors;
         }
 
+        P p(boost::get<0>(c), boost::get<1>(c) + 5);
+        V r1, r2, r3;
+        bool const found1 = bgi::detail::kd_nearest(v1.begin(), v1.end(), p, r1);
+        bool const found2 = bgi::detail::kd_nearest_three_way(v2.begin(), v2.end(), p, r2);
+        // the kd_sort() queries may be used with the three-way layout
+        bool const found3 = bgi::detail::kd_nearest(v2.begin(), v2.end(), p, r3);
+        if ( ! found1 || ! found2 || ! found3
+          || bg::comparable_distance(p, r1) != bg::comparable_distance(p, r2)
+          || bg::comparable_distance(p, r1) != bg::comparable_distance(p, r3) )
         {
-            std::size_t dummy = 0;
-            clock_t::time_point start = clock_t::now();
-            BOOST_FOREACH(pt_data const& c, coords)
-            {
-                P p(boost::get<0>(c), 0);
-                V r;
-                bool is = bgi::detail::kd_nearest_left_balanced(v3.begin(), v3.end(), p, r);
-                dummy += int(is);
-            }
-            dur_t time = clock_t::now() - start;
-            std::cout << time << " - kd_nearest_left_balanced()" << std::endl;
-            std::cout << "dummy: " << dummy << ' ' << std::endl;
+            std::cout << "kd_nearest and kd_nearest_three_way results not compatible!" << std::endl;
+            print(p); std::cout << std::endl;
+            ++errors;
         }
 
-        std::cout << "------------------------------------------------" << std::endl;
+        if ( errors > 10 )
+            break;
+    }
+}
 
-        {
-            int errors = 0;
-            BOOST_FOREACH(pt_data const& c, coords)
-            {
-                P p(boost::get<0>(c), 0);
-                V p1, p2, p3;
-                bool r1 = rt.query(bgi::nearest(p, 1), &p1) > 0;
-                bool r2 = bgi::detail::kd_nearest(v2.begin(), v2.end(), p, p2);
-                bool r3 = bgi::detail::kd_nearest_left_balanced(v3.begin(), v3.end(), p, p3);
-                
+// the compact quantized index and kd_sort() on the same data
+void compare_quantized(const char * name, std::vector<pt_data> const& coords)
+{
+    typedef boost::chrono::thread_clock clock_t;
+    typedef boost::chrono::duration<float> dur_t;
+
+    std::vector<V> v1(coords.size()), v2(coords.size()), v3(coords.size());
+    std::transform(coords.begin(), coords.end(), v1.begin(), to_v);
+    std::transform(coords.begin(), coords.end(), v2.begin(), to_v);
+    std::transform(coords.begin(), coords.end(), v3.begin(), to_v);
+
+    bgi::detail::kd_sort(v1.begin(), v1.end());
+
+    bgi::detail::kd_quantized_index<V> q16;
+    bgi::detail::kd_quantized_index<V, boost::uint8_t, 64> q8;
+    {
+        clock_t::time_point start = clock_t::now();
+        q16.build(v2.begin(), v2.end());
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_quantized_index::build() " << name << std::endl;
+    }
+    q8.build(v3.begin(), v3.end());
+
+    std::cout << "values: " << sizeof(V) * v2.size() << "B"
+              << " 16-bit index: " << q16.bytes() << "B"
+              << " 8-bit index: " << q8.bytes() << "B" << std::endl;
+
+    {
+        std::size_t dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
+        {
+            dummy += int(q16.binary_search(v2.begin(), to_v(c)));
+        }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_quantized_index::binary_search() " << name << std::endl;
+        std::cout << "dummy: " << dummy << std::endl;
+    }
+
+    {
+        std::size_t dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
+        {
+            P p(boost::get<0>(c), 0);
+            V r = zero_v();
+            dummy += int(bgi::detail::kd_nearest(v1.begin(), v1.end(), p, r))
+                   + int(first_coordinate(r) != 0);
+        }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_nearest() " << name << std::endl;
+        std::cout << "dummy: " << dummy << ' ' << std::endl;
+    }
+
+    {
+        std::size_t dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
+        {
+            P p(boost::get<0>(c), 0);
+            std::size_t r = 0;
+            dummy += int(q16.nearest(v2.begin(), p, r)) + r;
+        }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_quantized_index::nearest() " << name << std::endl;
+        std::cout << "dummy: " << dummy << ' ' << std::endl;
+    }
+
+    int errors = 0;
+    BOOST_FOREACH(pt_data const& c, coords)
+    {
+        if ( ! q16.binary_search(v2.begin(), to_v(c))
+          || ! q8.binary_search(v3.begin(), to_v(c)) )
+        {
+            std::cout << "kd_quantized_index::binary_search results not compatible!" << std::endl;
+            ++errors;
+        }
+
+        P p(boost::get<0>(c), boost::get<1>(c) + 5);
+        V r1 = zero_v();
+        std::size_t i16 = 0, i8 = 0;
+        bool const found1 = bgi::detail::kd_nearest(v1.begin(), v1.end(), p, r1);
+        bool const found16 = q16.nearest(v2.begin(), p, i16);
+        bool const found8 = q8.nearest(v3.begin(), p, i8);
+        if ( ! found1 || ! found16 || ! found8
+          || bg::comparable_distance(p, r1) != bg::comparable_distance(p, v2[i16])
+          || bg::comparable_distance(p, r1) != bg::comparable_distance(p, v3[i8]) )
+        {
+            std::cout << "kd_nearest and kd_quantized_index::nearest results not compatible!" << std::endl;
+            print(p); std::cout << std::endl;
+            ++errors;
+        }
+
+        if ( errors > 10 )
+            break;
+    }
+}
+
+// the weight of a Point aggregated by kd_aggregate_within()
+struct value_y
+{
+    double operator()(V const& v) const
+    {
+        return bg::get<1>(v);
+    }
+};
+
+// the counting and aggregating queries and kd_query_within() on the same data
+void compare_count_within(const char * name, std::vector<pt_data> const& coords)
+{
+    typedef boost::chrono::thread_clock clock_t;
+    typedef boost::chrono::duration<float> dur_t;
+
+    std::vector<V> v(coords.size());
+    std::transform(coords.begin(), coords.end(), v.begin(), to_v);
+    bgi::detail::kd_sort(v.begin(), v.end());
+
+    bgi::detail::kd_node_aggregates<double> aggregates;
+    {
+        clock_t::time_point start = clock_t::now();
+        bgi::detail::kd_build_aggregates(v.begin(), v.end(), aggregates, value_y());
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_build_aggregates() " << name << std::endl;
+    }
+
+    // the tiles of a heatmap covering the data
+    std::vector<B> tiles;
+    for ( int y = -1000 ; y < 1000 ; y += 100 )
+        for ( int x = -1000 ; x < 1000 ; x += 100 )
+            tiles.push_back(B(P(x, y), P(x + 100, y + 100)));
+
+    {
+        std::size_t dummy = 0;
+        std::vector<V> r;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
+        {
+            r.clear();
+            dummy += bgi::detail::kd_query_within(v.begin(), v.end(), to_query_box(c), std::back_inserter(r));
+        }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_query_within() " << name << std::endl;
+        std::cout << "dummy: " << dummy << ' ' << std::endl;
+    }
+
+    {
+        std::size_t dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(pt_data const& c, coords)
+        {
+            dummy += bgi::detail::kd_count_within(v.begin(), v.end(), to_query_box(c));
+        }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_count_within() " << name << std::endl;
+        std::cout << "dummy: " << dummy << ' ' << std::endl;
+    }
+
+    {
+        double dummy = 0;
+        std::vector<V> r;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(B const& b, tiles)
+        {
+            r.clear();
+            bgi::detail::kd_query_within(v.begin(), v.end(), b, std::back_inserter(r));
+            BOOST_FOREACH(V const& rv, r)
+                dummy += value_y()(rv);
+        }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_query_within() tiles " << name << std::endl;
+        std::cout << "dummy: " << dummy << ' ' << std::endl;
+    }
+
+    {
+        double dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(B const& b, tiles)
+        {
+            dummy += bgi::detail::kd_aggregate_within(v.begin(), v.end(), b, aggregates, value_y()).sum;
+        }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_aggregate_within() tiles " << name << std::endl;
+        std::cout << "dummy: " << dummy << ' ' << std::endl;
+    }
+
+    int errors = 0;
+    std::vector<V> r;
+    BOOST_FOREACH(pt_data const& c, coords)
+    {
+        B b = to_query_box(c);
+        r.clear();
+        std::size_t count = bgi::detail::kd_query_within(v.begin(), v.end(), b, std::back_inserter(r));
+        if ( count != bgi::detail::kd_count_within(v.begin(), v.end(), b) )
+        {
+            std::cout << "kd_query_within and kd_count_within results not compatible!" << std::endl;
+            print(b); std::cout << std::endl;
+            ++errors;
+        }
+
+        if ( errors > 10 )
+            break;
+    }
+
+    BOOST_FOREACH(B const& b, tiles)
+    {
+        r.clear();
+        bgi::detail::kd_query_within(v.begin(), v.end(), b, std::back_inserter(r));
+        bgi::detail::kd_aggregate<double> expected;
+        BOOST_FOREACH(V const& rv, r)
+            expected.add(value_y()(rv));
+
+        bgi::detail::kd_aggregate<double> a = bgi::detail::kd_aggregate_within(v.begin(), v.end(), b, aggregates, value_y());
+        // the sums may be calculated in different order
+        if ( a.count != expected.count
+          || (a.count > 0 && (a.min != expected.min || a.max != expected.max))
+          || std::abs(a.sum - expected.sum) > 1e-9 * (1 + std::abs(expected.sum)) * (1 + a.count) )
+        {
+            std::cout << "kd_query_within and kd_aggregate_within results not compatible!" << std::endl;
+            print(b); std::cout << std::endl;
+            ++errors;
+        }
+
+        if ( errors > 10 )
+            break;
+    }
+}
+
+// the k nearest joins and the queries of all of the values one by one
+void compare_nearest_join(const char * name, std::vector<pt_data> const& coords)
+{
+    typedef boost::chrono::thread_clock clock_t;
+    // the time of parallel algorithms can't be measured per thread
+    typedef boost::chrono::steady_clock wall_clock_t;
+    typedef boost::chrono::duration<float> dur_t;
+
+    std::vector<V> v(coords.size()), queries(coords.size());
+    std::transform(coords.begin(), coords.end(), v.begin(), to_v);
+    for ( std::size_t i = 0 ; i < coords.size() ; ++i )
+        queries[i] = P(boost::get<0>(coords[i]), boost::get<1>(coords[i]) + 5);
+    bgi::detail::kd_sort(v.begin(), v.end());
+    bgi::detail::kd_sort(queries.begin(), queries.end());
+
+    // the layout of a different ValuesMin
+    std::vector<V> v4(v.begin(), v.end());
+    bgi::detail::kd_sort<4>(v4.begin(), v4.end());
+
+    std::size_t const k = 4;
+    std::vector<std::size_t> r1(v.size()), r2(v.size() * k), r3(queries.size()), r4(v4.size() * k);
+    bgi::detail::kd_task_pool pool;
+
+    {
+        double dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(V const& p, v)
+        {
+            // the first one is the value itself
+            V r[2];
+            bgi::detail::kd_nearest_k(v.begin(), v.end(), p, 2, r);
+            dummy += bg::get<0>(r[1]);
+        }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_nearest_k() all nearest " << name << std::endl;
+        std::cout << "dummy: " << dummy << ' ' << std::endl;
+    }
+
+    {
+        wall_clock_t::time_point start = wall_clock_t::now();
+        bgi::detail::kd_nearest_self_join(v.begin(), v.end(), 1, r1.begin(), pool);
+        dur_t time = wall_clock_t::now() - start;
+        std::cout << time << " - kd_nearest_self_join() all nearest " << name
+                  << " (" << pool.threads_count() << " threads)" << std::endl;
+    }
+
+    {
+        double dummy = 0;
+        clock_t::time_point start = clock_t::now();
+        BOOST_FOREACH(V const& p, v)
+        {
+            V r[k + 1];
+            bgi::detail::kd_nearest_k(v.begin(), v.end(), p, k + 1, r);
+            dummy += bg::get<0>(r[k]);
+        }
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - kd_nearest_k() self knn " << name << std::endl;
+        std::cout << "dummy: " << dummy << ' ' << std::endl;
+    }
+
+    {
+        wall_clock_t::time_point start = wall_clock_t::now();
+        bgi::detail::kd_nearest_self_join(v.begin(), v.end(), k, r2.begin(), pool);
+        dur_t time = wall_clock_t::now() - start;
+        std::cout << time << " - kd_nearest_self_join() self knn " << name
+                  << " (" << pool.threads_count() << " threads)" << std::endl;
+    }
+
+    {
+        wall_clock_t::time_point start = wall_clock_t::now();
+        bgi::detail::kd_nearest_join(v.begin(), v.end(), queries.begin(), queries.end(), 1, r3.begin(), pool);
+        dur_t time = wall_clock_t::now() - start;
+        std::cout << time << " - kd_nearest_join() " << name
+                  << " (" << pool.threads_count() << " threads)" << std::endl;
+    }
+
+    bgi::detail::kd_nearest_self_join<4>(v4.begin(), v4.end(), k, r4.begin(), pool);
+
+    int errors = 0;
+    for ( std::size_t i = 0 ; i < v.size() ; ++i )
+    {
+        V const& p = v[i];
+        V r[k + 1];
+        bgi::detail::kd_nearest_k(v.begin(), v.end(), p, k + 1, r);
+
+        // the value isn't its own neighbour but the equal ones are
+        bool compatible = r1[i] != i
+                       && bg::comparable_distance(p, v[r1[i]]) == bg::comparable_distance(p, r[1]);
+        for ( std::size_t j = 0 ; j < k ; ++j )
+        {
+            compatible = compatible
+                      && r2[i * k + j] != i
+                      && bg::comparable_distance(p, v[r2[i * k + j]]) == bg::comparable_distance(p, r[j + 1]);
+        }
+
+        if ( ! compatible )
+        {
+            std::cout << "kd_nearest_k and kd_nearest_self_join results not compatible!" << std::endl;
+            print(p); std::cout << std::endl;
+            ++errors;
+        }
+
+        V q;
+        bool const found = bgi::detail::kd_nearest(v.begin(), v.end(), queries[i], q);
+        if ( ! found || bg::comparable_distance(queries[i], q) != bg::comparable_distance(queries[i], v[r3[i]]) )
+        {
+            std::cout << "kd_nearest and kd_nearest_join results not compatible!" << std::endl;
+            print(queries[i]); std::cout << std::endl;
+            ++errors;
+        }
+
+        V const& p4 = v4[i];
+        V r4k[k + 1];
+        bgi::detail::kd_nearest_k<4>(v4.begin(), v4.end(), p4, k + 1, r4k);
+        compatible = true;
+        for ( std::size_t j = 0 ; j < k ; ++j )
+        {
+            compatible = compatible
+                      && r4[i * k + j] != i
+                      && bg::comparable_distance(p4, v4[r4[i * k + j]]) == bg::comparable_distance(p4, r4k[j + 1]);
+        }
+
+        if ( ! compatible )
+        {
+            std::cout << "kd_nearest_k and kd_nearest_self_join<4> results not compatible!" << std::endl;
+            print(p4); std::cout << std::endl;
+            ++errors;
+        }
+
+        // kd_nearest_k() for each value is slow
+        if ( errors > 10 || i >= 100000 )
+            break;
+    }
+
+    // the brute force check of a few values, kd_nearest_k() is also checked above
+    for ( std::size_t i = 0 ; i < v.size() && i < 100 ; ++i )
+    {
+        std::vector<double> cdists(v.size());
+        for ( std::size_t j = 0 ; j < v.size() ; ++j )
+            cdists[j] = bg::comparable_distance(v[i], v[j]);
+        // the value itself or an equal one is the first one
+        std::sort(cdists.begin(), cdists.end());
+
+        bool compatible = true;
+        for ( std::size_t j = 0 ; j < k && j + 1 < v.size() ; ++j )
+            compatible = compatible && bg::comparable_distance(v[i], v[r2[i * k + j]]) == cdists[j + 1];
+
+        if ( ! compatible )
+        {
+            std::cout << "brute force and kd_nearest_self_join results not compatible!" << std::endl;
+            print(v[i]); std::cout << std::endl;
+            ++errors;
+        }
+    }
+}
+
+// each value visited by the exact nearest traversals is a median or a value
+// scanned in a leaf and its comparable distance is calculated once
+void check_traversal_stats(const char * name, std::vector<pt_data> const& coords)
+{
+    typedef std::vector<V>::const_iterator it_t;
+    typedef bgi::detail::kd_thread_stats stats;
+    std::size_t const VM = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN;
+
+    std::vector<V> v1(coords.size()), v2(coords.size()), v3(coords.size());
+    std::transform(coords.begin(), coords.end(), v1.begin(), to_v);
+    std::transform(coords.begin(), coords.end(), v2.begin(), to_v);
+    std::transform(coords.begin(), coords.end(), v3.begin(), to_v);
+    bgi::detail::kd_sort(v1.begin(), v1.end());
+    bgi::detail::kd_sort_three_way(v2.begin(), v2.end());
+    bgi::detail::kd_sort_left_balanced(v3.begin(), v3.end());
+
+    bgi::detail::kd_traversal_counters & counters = stats::local();
+    int errors = 0;
+    BOOST_FOREACH(pt_data const& c, coords)
+    {
+        // the traversals stop at the first value equal to the Point
+        P p(boost::get<0>(c), boost::get<1>(c) + 5);
+        for ( int i = 0 ; i < 3 ; ++i )
+        {
+            std::vector<V> const& v = i == 0 ? v1 : (i == 1 ? v2 : v3);
+            it_t out_it = v.begin();
+            double cdist = bg::comparable_distance(p, *out_it);
+
+            counters.reset();
+            if ( i == 0 )
+                bgi::detail::kd_nearest_impl<V, 0, VM, stats>::apply(v.begin(), v.end(), p, out_it, cdist);
+            else if ( i == 1 )
+                bgi::detail::kd_nearest_three_way_impl<V, 0, VM, stats>::apply(v.begin(), v.end(), p, out_it, cdist);
+            else
+                bgi::detail::kd_nearest_left_balanced_impl<V, 0, stats>::apply(v.begin(), 1, v.size(), p, out_it, cdist);
+
+            if ( cdist > 0 && counters.distances != counters.nodes + counters.leaf_values )
+            {
+                std::cout << "kd_traversal_counters of " << (i == 0 ? "kd_nearest" : (i == 1 ? "kd_nearest_three_way" : "kd_nearest_left_balanced"))
+                          << " not compatible! " << name << ' '
+                          << counters.distances << " != " << counters.nodes << " + " << counters.leaf_values << std::endl;
+                ++errors;
+            }
+        }
+
+        if ( errors > 10 )
+            break;
+    }
+}
+#endif
+
+// the leaf kernels of each instruction set available on this machine calculate
+// the same comparable distances as the scalar code and the distance strategy
+// and find the same values equal to the Point as the scalar code
+template <typename T, std::size_t Dim>
+void check_leaf_simd(std::vector<pt_data> const& coords)
+{
+    namespace simd = bgi::detail::kd_simd;
+    typedef bg::model::point<T, Dim, bg::cs::cartesian> point_t;
+    std::size_t const block = BOOST_GEOMETRY_INDEX_DETAIL_KD_LEAF_SIMD_BLOCK;
+
+    std::size_t const n = (std::min)(coords.size(), std::size_t(10000));
+    std::vector<T> c(n * Dim);
+    for ( std::size_t i = 0 ; i < n ; ++i )
+    {
+        float const t[4] = { boost::get<0>(coords[i]), boost::get<1>(coords[i]),
+                             boost::get<2>(coords[i]), boost::get<3>(coords[i]) };
+        for ( std::size_t d = 0 ; d < Dim ; ++d )
+            c[i * Dim + d] = T(t[d]);
+    }
+    // the same layout as the one the leaves of kd_sort reinterpret
+    point_t const* points = reinterpret_cast<point_t const*>(c.data());
+
+    int errors = 0;
+    for ( int l = simd::scalar ; l <= simd::current_level() ; ++l )
+    {
+        for ( std::size_t i = 0 ; i + block + 3 <= n && errors <= 10 ; i += 7 )
+        {
+            std::size_t const count = i % (block + 4);
+            T const* first = &c[i * Dim];
+            std::size_t const j = count > 0 ? (i / 7) % count : 0;
+
+            // a Point between the values, equal to the j-th value,
+            // one ulp away from the j-th value and not equal to any value
+            T q[4][Dim];
+            for ( std::size_t d = 0 ; d < Dim ; ++d )
+            {
+                q[0][d] = (first[d] + first[j * Dim + d]) / 2 + T(0.25);
+                q[1][d] = first[j * Dim + d];
+                q[2][d] = first[j * Dim + d];
+                q[3][d] = first[j * Dim + d] + T(1000);
+            }
+            q[2][0] = std::nextafter(q[2][0], q[2][0] + 1);
+
+            for ( int k = 0 ; k < 4 ; ++k )
+            {
+                double qd[Dim];
+                for ( std::size_t d = 0 ; d < Dim ; ++d )
+                    qd[d] = q[k][d];
+                point_t const& qp = *reinterpret_cast<point_t const*>(q[k]);
+
+                double out[block + 3];
+                simd::cdists(simd::level(l), first, count, Dim, qd, out);
+                for ( std::size_t m = 0 ; m < count ; ++m )
+                {
+                    double const expected = bg::comparable_distance(qp, points[i + m]);
+                    if ( out[m] != expected || out[m] != simd::cdist(first + m * Dim, Dim, qd) )
+                    {
+                        std::cout << "kd_simd::cdists not compatible! level " << l << " dim " << Dim << ' '
+                                  << out[m] << " != " << expected << std::endl;
+                        ++errors;
+                    }
+                }
+
+                std::size_t const found = simd::find_equal(simd::level(l), first, count, Dim, q[k]);
+                std::size_t const expected = simd::find_equal_scalar(first, 0, count, Dim, q[k]);
+                if ( found != expected )
+                {
+                    std::cout << "kd_simd::find_equal not compatible! level " << l << " dim " << Dim << ' '
+                              << found << " != " << expected << std::endl;
+                    ++errors;
+                }
+            }
+        }
+    }
+}
+
+// the speedup of the approximate nearest neighbour search and the distribution
+// of the relative error (1 + error) = distance / exact distance
+void compare_approximate_nearest(std::vector<pt_data> const& coords,
+                                 std::vector<V> const& v2, std::vector<V> const& v3,
+                                 double epsilon, std::size_t max_visited)
+{
+    typedef boost::chrono::thread_clock clock_t;
+    typedef boost::chrono::duration<float> dur_t;
+
+    std::ostringstream name;
+    name << "epsilon=" << epsilon << " max_visited=" << max_visited;
+
+    dur_t times[4];
+    std::vector<V> results[4];
+    for ( int i = 0 ; i < 4 ; ++i )
+    {
+        std::vector<V> & r = results[i];
+        r.resize(coords.size());
+        clock_t::time_point start = clock_t::now();
+        for ( std::size_t j = 0 ; j < coords.size() ; ++j )
+        {
+            P p(boost::get<0>(coords[j]), 0);
+            if ( i == 0 )
+                bgi::detail::kd_nearest(v2.begin(), v2.end(), p, r[j]);
+            else if ( i == 1 )
+                bgi::detail::kd_nearest(v2.begin(), v2.end(), p, r[j], epsilon, max_visited);
+            else if ( i == 2 )
+                bgi::detail::kd_nearest_left_balanced(v3.begin(), v3.end(), p, r[j]);
+            else
+                bgi::detail::kd_nearest_left_balanced(v3.begin(), v3.end(), p, r[j], epsilon, max_visited);
+        }
+        times[i] = clock_t::now() - start;
+    }
+
+    for ( int i = 1 ; i < 4 ; i += 2 )
+    {
+        std::vector<double> errors;
+        errors.reserve(coords.size());
+        std::size_t exact_count = 0;
+        for ( std::size_t j = 0 ; j < coords.size() ; ++j )
+        {
+            P p(boost::get<0>(coords[j]), 0);
+            double d_exact = bg::distance(p, results[i-1][j]);
+            double d = bg::distance(p, results[i][j]);
+            double error = d_exact > 0 ? d / d_exact - 1 : (d > 0 ? 1 : 0);
+            errors.push_back(error);
+            if ( error <= 0 )
+                ++exact_count;
+
+#ifndef TEST_BOXES
+            if ( max_visited == 0 && error > epsilon + 1e-9 )
+            {
+                std::cout << "kd_nearest and kd_nearest(epsilon) results not compatible!" << std::endl;
+                print(p); std::cout << std::endl;
+            }
+#endif
+        }
+
+        std::sort(errors.begin(), errors.end());
+        double mean = 0;
+        BOOST_FOREACH(double e, errors)
+        {
+            mean += e;
+        }
+
+        std::cout << times[i] << " - " << (i == 1 ? "kd_nearest(" : "kd_nearest_left_balanced(") << name.str()
+                  << ") speedup " << (times[i-1].count() / times[i].count()) << std::endl;
+        if ( ! errors.empty() )
+        {
+            std::cout << "error mean " << (mean / errors.size())
+                      << " median " << errors[errors.size() / 2]
+                      << " p99 " << errors[errors.size() * 99 / 100]
+                      << " max " << errors.back()
+                      << " exact " << (100.0 * exact_count / errors.size()) << "%" << std::endl;
+        }
+    }
+}
+
+size_t parse_count(std::string const& str)
+{
+    try
+    {
+        return boost::lexical_cast<size_t>(str);
+    }
+    catch ( boost::bad_lexical_cast const& )
+    {
+        throw std::invalid_argument("invalid number " + str);
+    }
+}
+
+// usage: kd_sort [values_count] [--tune] [--iterations N]
+// Runs all of the algorithms on the same data and checks their results,
+// see kd_benchmark.cpp for the measurements over various data sets.
+int main(int argc, char ** argv)
+{
+    typedef boost::chrono::thread_clock clock_t;
+    // the time of parallel algorithms can't be measured per thread
+    typedef boost::chrono::steady_clock wall_clock_t;
+    typedef boost::chrono::duration<float> dur_t;
+
+    // the number of values can be passed as an argument, e.g. 10M - 1B values,
+    // where the traversals are memory latency bound
+#if !defined(_DEBUG) || defined(NDEBUG)
+    size_t values_count = 1000000;
+#else
+    size_t values_count = 100;
+#endif
+    bool tune = false;
+    size_t iterations = 1;
+    try
+    {
+        for ( int i = 1 ; i < argc ; ++i )
+        {
+            std::string const arg = argv[i];
+            if ( arg == "--help" )
+            {
+                std::cout << "usage: kd_sort [values_count] [--tune] [--iterations N]" << std::endl;
+                return 0;
+            }
+            else if ( arg == "--tune" )
+            {
+                tune = true;
+            }
+            else if ( arg == "--iterations" )
+            {
+                if ( i + 1 >= argc )
+                    throw std::invalid_argument("missing value of " + arg);
+                iterations = parse_count(argv[++i]);
+            }
+            else if ( arg.compare(0, 1, "-") == 0 )
+            {
+                throw std::invalid_argument("unknown option " + arg);
+            }
+            else
+            {
+                values_count = parse_count(arg);
+            }
+        }
+    }
+    catch ( std::exception const& e )
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        std::cerr << "usage: kd_sort [values_count] [--tune] [--iterations N]" << std::endl;
+        return 1;
+    }
+
+    std::size_t const nearest_k = 16;
+#ifndef TEST_BOXES
+    double const within_distance = 10;
+#endif
+
+    std::vector<pt_data> coords;
+
+    //randomize values
+    {
+        boost::mt19937 rng;
+        //rng.seed(static_cast<unsigned int>(std::time(0)));
+        boost::uniform_real<float> range_pos(-1000, 1000);
+        boost::variate_generator<boost::mt19937&, boost::uniform_real<float> > rnd_pos(rng, range_pos);
+        boost::uniform_real<float> range_size(10, 50);
+        boost::variate_generator<boost::mt19937&, boost::uniform_real<float> > rnd_size(rng, range_size);
+
+        coords.reserve(values_count);
+
+        std::cout << "randomizing data\n";
+        for ( size_t i = 0 ; i < values_count ; ++i )
+        {
+            coords.push_back(boost::make_tuple(rnd_pos(), rnd_pos(), rnd_size(), rnd_size()));
+        }
+        std::cout << "randomized\n";
+    }
+
+    std::vector<pt_data> coords_clustered, coords_skewed, coords_snapped;
+    randomize_clustered(coords_clustered, values_count);
+    randomize_skewed(coords_skewed, values_count);
+    randomize_snapped(coords_snapped, values_count);
+
+    if ( tune )
+    {
+        tune_leaf_sizes(coords);
+        return 0;
+    }
+
+    bgi::detail::kd_task_pool pool;
+    std::cout << "threads: " << pool.threads_count() << std::endl;
+    std::cout << "simd level: " << bgi::detail::kd_simd::current_level() << std::endl;
+
+    check_leaf_simd<double, 2>(coords);
+    check_leaf_simd<double, 3>(coords);
+    check_leaf_simd<float, 2>(coords);
+    check_leaf_simd<float, 3>(coords);
+
+    for ( size_t iteration = 0 ; iteration < iterations ; ++iteration )
+    {
+        std::vector<V> v1, v2, v3;
+        
+        {
+            v1.reserve(values_count);
+            v2.reserve(values_count);
+            v3.reserve(values_count);
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                v1.push_back(to_v(c));
+                v2.push_back(to_v(c));
+                v3.push_back(to_v(c));
+            }
+        }
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        clock_t::time_point start = clock_t::now();
+        bgi::rtree<V, bgi::linear<8> > rt(v1.begin(), v1.end());
+        dur_t time = clock_t::now() - start;
+        std::cout << time << " - rtree()" << std::endl;
+
+#ifndef TEST_BOXES
+        {
+            clock_t::time_point start = clock_t::now();
+            std::sort(v1.begin(), v1.end(), bg::less<P>());
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - std::sort()" << std::endl;
+        }
+#endif
+
+        {
+            clock_t::time_point start = clock_t::now();
+            bgi::detail::kd_sort(v2.begin(), v2.end());
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_sort()" << std::endl;
+        }
+
+        {
+            kd_benchmark::reset_peak_rss();
+            std::size_t rss = kd_benchmark::peak_rss();
+            clock_t::time_point start = clock_t::now();
+            bgi::detail::kd_sort_left_balanced(v3.begin(), v3.end());
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_sort_left_balanced() peak RSS +"
+                      << (kd_benchmark::peak_rss() - rss) << " kB" << std::endl;
+        }
+
+        {
+            std::vector<V> v(coords.size()), buffer(coords.size());
+            std::transform(coords.begin(), coords.end(), v.begin(), to_v);
+            kd_benchmark::reset_peak_rss();
+            std::size_t rss = kd_benchmark::peak_rss();
+            clock_t::time_point start = clock_t::now();
+            bgi::detail::kd_sort_left_balanced(v.begin(), v.end(), buffer.begin());
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_sort_left_balanced(buffer) peak RSS +"
+                      << (kd_benchmark::peak_rss() - rss) << " kB" << std::endl;
+            if ( ! std::equal(v.begin(), v.end(), v3.begin(), bg::equals<V, V>) )
+                std::cout << "kd_sort_left_balanced() and kd_sort_left_balanced(buffer) results not compatible!" << std::endl;
+        }
+
+        {
+            std::vector<V> v(coords.size());
+            std::transform(coords.begin(), coords.end(), v.begin(), to_v);
+            kd_benchmark::reset_peak_rss();
+            std::size_t rss = kd_benchmark::peak_rss();
+            clock_t::time_point start = clock_t::now();
+            bgi::detail::kd_sort_left_balanced_in_place(v.begin(), v.end());
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_sort_left_balanced_in_place() peak RSS +"
+                      << (kd_benchmark::peak_rss() - rss) << " kB" << std::endl;
+            if ( ! std::equal(v.begin(), v.end(), v3.begin(), bg::equals<V, V>) )
+                std::cout << "kd_sort_left_balanced() and kd_sort_left_balanced_in_place() results not compatible!" << std::endl;
+        }
+
+        {
+            std::vector<V> v(coords.size());
+            std::transform(coords.begin(), coords.end(), v.begin(), to_v);
+            wall_clock_t::time_point start = wall_clock_t::now();
+            bgi::detail::kd_sort_parallel(v.begin(), v.end(), pool);
+            dur_t time = wall_clock_t::now() - start;
+            std::cout << time << " - kd_sort_parallel()" << std::endl;
+            if ( ! std::equal(v.begin(), v.end(), v2.begin(), bg::equals<V, V>) )
+                std::cout << "kd_sort() and kd_sort_parallel() results not compatible!" << std::endl;
+        }
+
+        {
+            // the layout of a different ValuesMin
+            std::vector<V> v(coords.size()), v4(coords.size());
+            std::transform(coords.begin(), coords.end(), v.begin(), to_v);
+            std::transform(coords.begin(), coords.end(), v4.begin(), to_v);
+            bgi::detail::kd_sort<4>(v4.begin(), v4.end());
+            bgi::detail::kd_sort_parallel<4>(v.begin(), v.end(), pool);
+            if ( ! std::equal(v.begin(), v.end(), v4.begin(), bg::equals<V, V>) )
+                std::cout << "kd_sort<4>() and kd_sort_parallel<4>() results not compatible!" << std::endl;
+        }
+
+        {
+            std::vector<V> v(coords.size());
+            std::transform(coords.begin(), coords.end(), v.begin(), to_v);
+            wall_clock_t::time_point start = wall_clock_t::now();
+            bgi::detail::kd_sort_left_balanced_parallel(v.begin(), v.end(), pool);
+            dur_t time = wall_clock_t::now() - start;
+            std::cout << time << " - kd_sort_left_balanced_parallel()" << std::endl;
+            if ( ! std::equal(v.begin(), v.end(), v3.begin(), bg::equals<V, V>) )
+                std::cout << "kd_sort_left_balanced() and kd_sort_left_balanced_parallel() results not compatible!" << std::endl;
+        }
+
+        {
+            std::vector<V> v(coords.size());
+            std::transform(coords.begin(), coords.end(), v.begin(), to_v);
+            clock_t::time_point start = clock_t::now();
+            bgi::detail::kd_sort_sampled(v.begin(), v.end());
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_sort_sampled()" << std::endl;
+
+            // the medians are the same but the other elements may be ordered differently
+            int errors = 0;
+            for ( std::size_t i = 0 ; i < coords.size() && errors <= 10 ; ++i )
+            {
+                if ( ! bgi::detail::kd_binary_search(v.begin(), v.end(), to_v(coords[i])) )
+                {
+                    std::cout << "kd_sort() and kd_sort_sampled() results not compatible!" << std::endl;
+                    ++errors;
+                }
+            }
+        }
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            std::size_t dummy = 0;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                bool is = rt.count(to_v(c)) > 0;
+
+                dummy += int(is);
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - rtree::count()" << std::endl;
+            std::cout << "dummy: " << dummy << std::endl;
+        }
+
+#ifndef TEST_BOXES
+        {
+            std::size_t dummy = 0;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                bool is = std::binary_search(v1.begin(), v1.end(), to_v(c), bg::less<P>());
+
+                dummy += int(is);
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - std::binary_search()" << std::endl;
+            std::cout << "dummy: " << dummy << std::endl;
+        }
+#endif
+
+        {
+            std::size_t dummy = 0;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                bool is = bgi::detail::kd_binary_search(v2.begin(), v2.end(), to_v(c));
+
+                dummy += int(is);
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_binary_search()" << std::endl;
+            std::cout << "dummy: " << dummy << std::endl;
+        }
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            std::size_t dummy = 0;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), 0);
+                V r;
+                dummy += rt.query(bgi::nearest(p, 1), &r);
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - rtree::nearest()" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+
+        {
+            std::size_t dummy = 0;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), 0);
+                V r = zero_v();
+                bool is = bgi::detail::kd_nearest(v2.begin(), v2.end(), p, r);
+                dummy += int(is) + int(first_coordinate(r) != 0);
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_nearest()" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+
+        {
+            std::size_t dummy = 0;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), 0);
+                V r = zero_v();
+                bool is = bgi::detail::kd_nearest_left_balanced(v3.begin(), v3.end(), p, r);
+                dummy += int(is) + int(first_coordinate(r) != 0);
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_nearest_left_balanced()" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+
+        {
+            std::size_t dummy = 0;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), 0);
+                V r = zero_v();
+                bool is = bgi::detail::kd_nearest_left_balanced_iterative(v3.begin(), v3.end(), p, r);
+                dummy += int(is) + int(first_coordinate(r) != 0);
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_nearest_left_balanced_iterative()" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+
+        {
+            std::vector<P> queries;
+            queries.reserve(coords.size());
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                queries.push_back(P(boost::get<0>(c), 0));
+            }
+            std::vector<V> r1(queries.size()), r2(queries.size());
+
+            {
+                wall_clock_t::time_point start = wall_clock_t::now();
+                bgi::detail::kd_nearest_batch(v2.begin(), v2.end(), queries.begin(), queries.end(), r1.begin(), pool);
+                dur_t time = wall_clock_t::now() - start;
+                std::cout << time << " - kd_nearest_batch() "
+                          << (queries.size() / time.count() / 1000000) << " Mq/s" << std::endl;
+            }
+
+            {
+                wall_clock_t::time_point start = wall_clock_t::now();
+                bgi::detail::kd_nearest_left_balanced_batch(v3.begin(), v3.end(), queries.begin(), queries.end(), r2.begin(), pool);
+                dur_t time = wall_clock_t::now() - start;
+                std::cout << time << " - kd_nearest_left_balanced_batch() "
+                          << (queries.size() / time.count() / 1000000) << " Mq/s" << std::endl;
+            }
+
+            int errors = 0;
+            for ( std::size_t i = 0 ; i < queries.size() && errors <= 10 ; ++i )
+            {
+                // each batch is compared with the single query on the same layout
+                V n1 = zero_v(), n2 = zero_v();
+                if ( ! bgi::detail::kd_nearest(v2.begin(), v2.end(), queries[i], n1)
+                  || bg::comparable_distance(queries[i], n1) != bg::comparable_distance(queries[i], r1[i]) )
+                {
+                    std::cout << "kd_nearest and kd_nearest_batch results not compatible!" << std::endl;
+                    print(queries[i]); std::cout << std::endl;
+                    ++errors;
+                }
+
+                if ( ! bgi::detail::kd_nearest_left_balanced(v3.begin(), v3.end(), queries[i], n2)
+                  || bg::comparable_distance(queries[i], n2) != bg::comparable_distance(queries[i], r2[i]) )
+                {
+                    std::cout << "kd_nearest_left_balanced and kd_nearest_left_balanced_batch results not compatible!" << std::endl;
+                    print(queries[i]); std::cout << std::endl;
+                    ++errors;
+                }
+            }
+        }
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            std::size_t dummy = 0;
+            std::vector<V> r;
+            r.reserve(nearest_k);
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), 0);
+                r.clear();
+                dummy += rt.query(bgi::nearest(p, nearest_k), std::back_inserter(r));
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - rtree::nearest(" << nearest_k << ")" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+
+        {
+            std::size_t dummy = 0;
+            std::vector<V> r;
+            r.reserve(nearest_k);
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), 0);
+                r.clear();
+                dummy += bgi::detail::kd_nearest_k(v2.begin(), v2.end(), p, nearest_k, std::back_inserter(r));
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_nearest_k(" << nearest_k << ")" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+
+        {
+            std::size_t dummy = 0;
+            std::vector<V> r;
+            r.reserve(nearest_k);
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), 0);
+                r.clear();
+                dummy += bgi::detail::kd_nearest_k_left_balanced(v3.begin(), v3.end(), p, nearest_k, std::back_inserter(r));
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_nearest_k_left_balanced(" << nearest_k << ")" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+
+        // the Boxes are not supported, see kd_within_distance_impl
+#ifndef TEST_BOXES
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            std::size_t dummy = 0;
+            std::vector<std::pair<V, double> > r;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), boost::get<1>(c));
+                r.clear();
+                dummy += bgi::detail::kd_within_distance(v2.begin(), v2.end(), p, within_distance, std::back_inserter(r));
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_within_distance()" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+
+        {
+            std::size_t dummy = 0;
+            std::vector<std::pair<V, double> > r;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), boost::get<1>(c));
+                r.clear();
+                dummy += bgi::detail::kd_within_distance_sorted(v2.begin(), v2.end(), p, within_distance, std::back_inserter(r));
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_within_distance_sorted()" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+
+        {
+            std::size_t dummy = 0;
+            std::vector<std::pair<V, double> > r;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), boost::get<1>(c));
+                r.clear();
+                dummy += bgi::detail::kd_within_distance_left_balanced(v3.begin(), v3.end(), p, within_distance, std::back_inserter(r));
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_within_distance_left_balanced()" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+
+        {
+            std::size_t dummy = 0;
+            std::vector<std::pair<V, double> > r;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), boost::get<1>(c));
+                r.clear();
+                dummy += bgi::detail::kd_within_distance_left_balanced_sorted(v3.begin(), v3.end(), p, within_distance, std::back_inserter(r));
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_within_distance_left_balanced_sorted()" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+#endif
+
+        // the Boxes are not supported, see kd_query_within_impl
+#ifndef TEST_BOXES
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            std::size_t dummy = 0;
+            std::vector<V> r;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                r.clear();
+                dummy += rt.query(bgi::intersects(to_query_box(c)), std::back_inserter(r));
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - rtree::intersects()" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+
+        {
+            std::size_t dummy = 0;
+            std::vector<V> r;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                r.clear();
+                dummy += bgi::detail::kd_query_within(v2.begin(), v2.end(), to_query_box(c), std::back_inserter(r));
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_query_within()" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+
+        {
+            std::size_t dummy = 0;
+            std::vector<V> r;
+            clock_t::time_point start = clock_t::now();
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                r.clear();
+                dummy += bgi::detail::kd_query_within_left_balanced(v3.begin(), v3.end(), to_query_box(c), std::back_inserter(r));
+            }
+            dur_t time = clock_t::now() - start;
+            std::cout << time << " - kd_query_within_left_balanced()" << std::endl;
+            std::cout << "dummy: " << dummy << ' ' << std::endl;
+        }
+#endif
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            std::vector<V> v(coords.size());
+            std::transform(coords.begin(), coords.end(), v.begin(), to_v);
+
+            {
+                clock_t::time_point start = clock_t::now();
+                bgi::detail::kd_sort_blocked(v.begin(), v.end());
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_sort_blocked()" << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    bool is = bgi::detail::kd_binary_search_blocked(v.begin(), v.end(), to_v(c));
+                    dummy += int(is);
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_binary_search_blocked()" << std::endl;
+                std::cout << "dummy: " << dummy << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    P p(boost::get<0>(c), 0);
+                    V r = zero_v();
+                    bool is = bgi::detail::kd_nearest_blocked(v.begin(), v.end(), p, r);
+                    dummy += int(is) + int(first_coordinate(r) != 0);
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_nearest_blocked()" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+#ifndef TEST_BOXES
+            {
+                std::size_t dummy = 0;
+                std::vector<V> r;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    r.clear();
+                    dummy += bgi::detail::kd_query_within_blocked(v.begin(), v.end(), to_query_box(c), std::back_inserter(r));
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_query_within_blocked()" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+#endif
+
+            int errors = 0;
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                if ( ! bgi::detail::kd_binary_search_blocked(v.begin(), v.end(), to_v(c)) )
+                {
+                    std::cout << "kd_binary_search_blocked results not compatible!" << std::endl;
+                    ++errors;
+                }
+
+                P p(boost::get<0>(c), 0);
+                V r1 = zero_v(), r2 = zero_v();
+                bool const found1 = bgi::detail::kd_nearest_left_balanced(v3.begin(), v3.end(), p, r1);
+                bool const found2 = bgi::detail::kd_nearest_blocked(v.begin(), v.end(), p, r2);
+                if ( ! found1 || ! found2
+                  || bg::comparable_distance(p, r1) != bg::comparable_distance(p, r2) )
+                {
+                    std::cout << "kd_nearest_left_balanced and kd_nearest_blocked results not compatible!" << std::endl;
+                    print(p); std::cout << std::endl;
+                    ++errors;
+                }
+
+                if ( errors > 10 )
+                    break;
+            }
+        }
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            char const* path = "kd_sort_benchmark.kd";
+
+            {
+                clock_t::time_point start = clock_t::now();
+                bgi::detail::kd_file_write(path, v2.begin(), v2.end(), bgi::detail::kd_file_layout_kd_sort);
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_file_write()" << std::endl;
+            }
+
+            {
+                wall_clock_t::time_point start = wall_clock_t::now();
+                bgi::detail::kd_mapped_file<V> file(path, bgi::detail::kd_file_layout_kd_sort);
+                dur_t time = wall_clock_t::now() - start;
+                std::cout << time << " - kd_mapped_file()" << std::endl;
+
+                {
+                    std::size_t dummy = 0;
+                    clock_t::time_point start = clock_t::now();
+                    BOOST_FOREACH(pt_data const& c, coords)
+                    {
+                        P p(boost::get<0>(c), 0);
+                        V r = zero_v();
+                        bool is = bgi::detail::kd_nearest(file.begin(), file.end(), p, r);
+                        dummy += int(is) + int(first_coordinate(r) != 0);
+                    }
+                    dur_t time = clock_t::now() - start;
+                    std::cout << time << " - kd_nearest() mapped" << std::endl;
+                    std::cout << "dummy: " << dummy << ' ' << std::endl;
+                }
+
+                if ( file.size() != v2.size() || file.layout() != bgi::detail::kd_file_layout_kd_sort
+                  || ! std::equal(v2.begin(), v2.end(), file.begin(), bg::equals<V, V>) )
+                    std::cout << "kd_file_write and kd_mapped_file results not compatible!" << std::endl;
+            }
+
+            // the file can't be queried with a different ValuesMin
+            try
+            {
+                bgi::detail::kd_mapped_file<V> file(path, bgi::detail::kd_file_layout_kd_sort,
+                                                    BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN + 1);
+                std::cout << "kd_mapped_file ValuesMin not checked!" << std::endl;
+            }
+            catch (bgi::detail::kd_file_error const& )
+            {}
+
+            std::remove(path);
+        }
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            bgi::detail::kd_dynamic_index<V> dyn;
+
+            {
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    dyn.insert(to_v(c));
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_dynamic_index::insert() "
+                          << (time.count() / coords.size() * 1000000) << " us/value" << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    P p(boost::get<0>(c), 0);
+                    V r = zero_v();
+                    bool is = dyn.nearest(p, r);
+                    dummy += int(is) + int(first_coordinate(r) != 0);
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_dynamic_index::nearest()" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                std::vector<V> r;
+                r.reserve(nearest_k);
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    P p(boost::get<0>(c), 0);
+                    r.clear();
+                    dummy += dyn.nearest(p, nearest_k, std::back_inserter(r));
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_dynamic_index::nearest(k)" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+            int errors = 0;
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                // the nearest Boxes found in different layouts may be different
+#ifndef TEST_BOXES
+                P p(boost::get<0>(c), 0);
+                V r1, r2;
+                bool const found1 = bgi::detail::kd_nearest(v2.begin(), v2.end(), p, r1);
+                bool const found2 = dyn.nearest(p, r2);
+                if ( ! found1 || ! found2
+                  || bg::comparable_distance(p, r1) != bg::comparable_distance(p, r2) )
+                {
+                    std::cout << "kd_nearest and kd_dynamic_index::nearest results not compatible!" << std::endl;
+                    print(p); std::cout << std::endl;
+                    ++errors;
+                }
+#endif
+
+                if ( ! dyn.binary_search(to_v(c)) )
+                {
+                    std::cout << "kd_binary_search and kd_dynamic_index::binary_search results not compatible!" << std::endl;
+                    ++errors;
+                }
+
+                if ( errors > 10 )
+                    break;
+            }
+        }
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            // every other value is erased
+            std::vector<V> alive(v2);
+            bgi::detail::kd_tombstones tombstones(alive.size());
+            bgi::detail::kd_dynamic_index<V> dyn;
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                dyn.insert(to_v(c));
+            }
+
+            {
+                std::size_t dummy = 0;
+                clock_t::time_point start = clock_t::now();
+                for ( std::size_t i = 0 ; i < coords.size() ; i += 2 )
+                {
+                    dummy += int(bgi::detail::kd_erase(alive.begin(), alive.end(), tombstones, to_v(coords[i])));
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_erase()" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                clock_t::time_point start = clock_t::now();
+                for ( std::size_t i = 0 ; i < coords.size() ; i += 2 )
+                {
+                    dummy += int(dyn.erase(to_v(coords[i])));
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_dynamic_index::erase()" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    P p(boost::get<0>(c), 0);
+                    V r = zero_v();
+                    bool is = bgi::detail::kd_nearest(alive.begin(), alive.end(), tombstones, p, r);
+                    dummy += int(is) + int(first_coordinate(r) != 0);
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_nearest() tombstones" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    P p(boost::get<0>(c), 0);
+                    V r = zero_v();
+                    bool is = dyn.nearest(p, r);
+                    dummy += int(is) + int(first_coordinate(r) != 0);
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_dynamic_index::nearest() erased" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+            std::vector<V> v4(alive);
+            bgi::detail::kd_tombstones tombstones4(tombstones);
+            {
+                clock_t::time_point start = clock_t::now();
+                v4.erase(bgi::detail::kd_compact(v4.begin(), v4.end(), tombstones4), v4.end());
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_compact()" << std::endl;
+            }
+
+            int errors = 0;
+            if ( v4.size() != alive.size() - tombstones.dead_count() || dyn.size() != v4.size() )
+            {
+                std::cout << "kd_compact and kd_dynamic_index::erase results not compatible!" << std::endl;
+                ++errors;
+            }
+            for ( std::size_t i = 0 ; i < coords.size() && errors <= 10 ; ++i )
+            {
+                // the nearest Boxes found in different layouts may be different
+#ifndef TEST_BOXES
+                P p(boost::get<0>(coords[i]), 0);
+                V r1 = zero_v(), r2 = zero_v(), r3 = zero_v();
+                bool const found1 = bgi::detail::kd_nearest(v4.begin(), v4.end(), p, r1);
+                bool const found2 = bgi::detail::kd_nearest(alive.begin(), alive.end(), tombstones, p, r2);
+                bool const found3 = dyn.nearest(p, r3);
+                if ( ! found1 || ! found2 || ! found3
+                  || bg::comparable_distance(p, r1) != bg::comparable_distance(p, r2)
+                  || bg::comparable_distance(p, r1) != bg::comparable_distance(p, r3) )
+                {
+                    std::cout << "kd_nearest tombstones and kd_compact results not compatible!" << std::endl;
+                    print(p); std::cout << std::endl;
+                    ++errors;
+                }
+#endif
+
+                bool const expected = i % 2 != 0;
+                if ( bgi::detail::kd_binary_search(alive.begin(), alive.end(), tombstones, to_v(coords[i])) != expected
+                  || dyn.binary_search(to_v(coords[i])) != expected )
+                {
+                    std::cout << "kd_erase and kd_binary_search results not compatible!" << std::endl;
+                    ++errors;
+                }
+            }
+
+            // the same values erased from a range sorted with ValuesMin = 4
+            std::vector<V> alive4(alive);
+            bgi::detail::kd_sort<4>(alive4.begin(), alive4.end());
+            bgi::detail::kd_tombstones tombstones_vm4(alive4.size());
+            for ( std::size_t i = 0 ; i < coords.size() ; i += 2 )
+            {
+                bgi::detail::kd_erase<4>(alive4.begin(), alive4.end(), tombstones_vm4, to_v(coords[i]));
+            }
+            std::vector<V> v5(alive4);
+            bgi::detail::kd_tombstones tombstones5(tombstones_vm4);
+            v5.erase(bgi::detail::kd_compact<4>(v5.begin(), v5.end(), tombstones5), v5.end());
+            if ( tombstones_vm4.dead_count() != tombstones.dead_count() || v5.size() != v4.size() )
+            {
+                std::cout << "kd_erase<4> and kd_erase results not compatible!" << std::endl;
+                ++errors;
+            }
+            for ( std::size_t i = 0 ; i < coords.size() && errors <= 10 ; ++i )
+            {
+#ifndef TEST_BOXES
+                P p(boost::get<0>(coords[i]), 0);
+                V r1 = zero_v(), r2 = zero_v();
+                bool const found1 = bgi::detail::kd_nearest<4>(v5.begin(), v5.end(), p, r1);
+                bool const found2 = bgi::detail::kd_nearest<4>(alive4.begin(), alive4.end(), tombstones_vm4, p, r2);
+                if ( ! found1 || ! found2
+                  || bg::comparable_distance(p, r1) != bg::comparable_distance(p, r2) )
+                {
+                    std::cout << "kd_nearest<4> tombstones and kd_compact<4> results not compatible!" << std::endl;
+                    print(p); std::cout << std::endl;
+                    ++errors;
+                }
+#endif
+
+                bool const expected = i % 2 != 0;
+                if ( bgi::detail::kd_binary_search<4>(alive4.begin(), alive4.end(), tombstones_vm4, to_v(coords[i])) != expected
+                  || bgi::detail::kd_binary_search<4>(v5.begin(), v5.end(), to_v(coords[i])) != expected )
+                {
+                    std::cout << "kd_erase<4> and kd_binary_search<4> results not compatible!" << std::endl;
+                    ++errors;
+                }
+            }
+        }
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        compare_approximate_nearest(coords, v2, v3, 0.05, 0);
+        compare_approximate_nearest(coords, v2, v3, 0.25, 0);
+        compare_approximate_nearest(coords, v2, v3, 1.0, 0);
+        {
+            // the medians on the path to the first leaf and the values of the leaf,
+            // the exact search of the 2d data checks only a few more values
+            std::size_t max_visited = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN;
+            for ( std::size_t n = coords.size() ; n > BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN ; n /= 2 )
+                ++max_visited;
+            compare_approximate_nearest(coords, v2, v3, 0.0, max_visited);
+        }
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        compare_split_axes("uniform", coords);
+        compare_split_axes("clustered", coords_clustered);
+        compare_split_axes("skewed", coords_skewed);
+        compare_split_axes("snapped", coords_snapped);
+
+        // the comparisons below and kd_soa_index support only the Points
+#ifndef TEST_BOXES
+        std::cout << "------------------------------------------------" << std::endl;
+
+        compare_three_way("uniform", coords);
+        compare_three_way("snapped", coords_snapped);
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        compare_quantized("uniform", coords);
+        compare_quantized("snapped", coords_snapped);
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        compare_count_within("uniform", coords);
+        compare_count_within("snapped", coords_snapped);
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        compare_nearest_join("uniform", coords);
+        compare_nearest_join("snapped", coords_snapped);
+        compare_nearest_join("clustered", coords_clustered);
+        compare_nearest_join("skewed", coords_skewed);
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        check_traversal_stats("uniform", coords);
+        check_traversal_stats("snapped", coords_snapped);
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            bgi::detail::kd_soa_index<P> soa;
+            {
+                clock_t::time_point start = clock_t::now();
+                soa.build(v1.begin(), v1.end());
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_soa_index::build()" << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    bool is = soa.binary_search(to_v(c));
+                    dummy += int(is);
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_soa_index::binary_search()" << std::endl;
+                std::cout << "dummy: " << dummy << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    P p(boost::get<0>(c), 0);
+                    std::size_t r = 0;
+                    bool is = soa.nearest(p, r);
+                    dummy += int(is) + r;
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_soa_index::nearest()" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                std::vector<std::size_t> r;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    r.clear();
+                    dummy += soa.query_within(to_query_box(c), std::back_inserter(r));
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_soa_index::query_within()" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+            int errors = 0;
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), 0);
+                V p1;
+                std::size_t i2 = 0;
+                bool const found1 = bgi::detail::kd_nearest(v2.begin(), v2.end(), p, p1);
+                bool const found2 = soa.nearest(p, i2);
+
+                if ( found1 != found2
+                  || ( found1 && bg::comparable_distance(p, p1) != bg::comparable_distance(p, v1[i2]) ) )
+                {
+                    std::cout << "kd_nearest and kd_soa_index::nearest results not compatible!" << std::endl;
+                    print(p); std::cout << std::endl;
+                    ++errors;
+                }
+
+                if ( errors > 10 )
+                    break;
+            }
+        }
+#endif
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            // the values of about 200 bytes
+            std::vector<record> records(coords.size());
+            std::vector<heavy_value> heavy(coords.size());
+            for ( std::size_t i = 0 ; i < coords.size() ; ++i )
+            {
+                records[i].first = to_v(coords[i]);
+                heavy[i].indexable = to_v(coords[i]);
+            }
+            std::vector<bgi::detail::kd_indexed<V> > indexed(coords.size());
+            std::vector<boost::uint32_t> indexes(coords.size());
+
+            {
+                clock_t::time_point start = clock_t::now();
+                bgi::detail::kd_sort(heavy.begin(), heavy.end());
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_sort() " << sizeof(heavy_value) << "B values" << std::endl;
+            }
+
+            {
+                clock_t::time_point start = clock_t::now();
+                bgi::detail::kd_sort_indexed(records.begin(), records.end(), indexed.begin());
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_sort_indexed() " << sizeof(bgi::detail::kd_indexed<V>) << "B elements" << std::endl;
+            }
+
+            {
+                clock_t::time_point start = clock_t::now();
+                bgi::detail::kd_sort_indexes(records.begin(), records.end(), indexes.begin());
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_sort_indexes()" << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    P p(boost::get<0>(c), 0);
+                    bgi::detail::kd_indexed<V> r;
+                    if ( bgi::detail::kd_nearest(indexed.begin(), indexed.end(), p, r) )
+                        dummy += r.id;
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_nearest() kd_indexed" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+            int errors = 0;
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                if ( ! bgi::detail::kd_binary_search(indexed.begin(), indexed.end(), to_v(c)) )
+                {
+                    std::cout << "kd_binary_search and kd_sort_indexed results not compatible!" << std::endl;
+                    ++errors;
+                }
+
+#ifndef TEST_BOXES
+                P p(boost::get<0>(c), 0);
+                V r1;
+                bgi::detail::kd_indexed<V> r2;
+                bool const found1 = bgi::detail::kd_nearest(v2.begin(), v2.end(), p, r1);
+                bool const found2 = bgi::detail::kd_nearest(indexed.begin(), indexed.end(), p, r2);
+                if ( found1 != found2
+                  || ( found1 && bg::comparable_distance(p, r1) != bg::comparable_distance(p, records[r2.id].first) ) )
+                {
+                    std::cout << "kd_nearest and kd_nearest kd_indexed results not compatible!" << std::endl;
+                    print(p); std::cout << std::endl;
+                    ++errors;
+                }
+#endif
+
+                if ( errors > 10 )
+                    break;
+            }
+
+            for ( std::size_t i = 0 ; i < indexes.size() && errors <= 10 ; ++i )
+            {
+                if ( ! bg::equals(records[indexes[i]].first, indexed[i].indexable) )
+                {
+                    std::cout << "kd_sort_indexes and kd_sort_indexed results not compatible!" << std::endl;
+                    ++errors;
+                }
+            }
+        }
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            std::vector<V> v(coords.size());
+            std::transform(coords.begin(), coords.end(), v.begin(), to_v);
+            bgi::detail::kd_split_extents<bg::coordinate_type<V>::type> extents;
+
+            {
+                clock_t::time_point start = clock_t::now();
+                bgi::detail::kd_sort_extents(v.begin(), v.end(), extents);
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_sort_extents()" << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    P p(boost::get<0>(c), 0);
+                    V r = zero_v();
+                    bool is = bgi::detail::kd_nearest_extents(v.begin(), v.end(), extents, p, r);
+                    dummy += int(is) + int(first_coordinate(r) != 0);
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_nearest_extents()" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                std::vector<V> r;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    r.clear();
+                    dummy += rt.query(bgi::intersects(to_query_box(c)), std::back_inserter(r));
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - rtree::intersects()" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+            {
+                std::size_t dummy = 0;
+                std::vector<V> r;
+                clock_t::time_point start = clock_t::now();
+                BOOST_FOREACH(pt_data const& c, coords)
+                {
+                    r.clear();
+                    dummy += bgi::detail::kd_query_intersects_extents(v.begin(), v.end(), extents, to_query_box(c), std::back_inserter(r));
+                }
+                dur_t time = clock_t::now() - start;
+                std::cout << time << " - kd_query_intersects_extents()" << std::endl;
+                std::cout << "dummy: " << dummy << ' ' << std::endl;
+            }
+
+            int errors = 0;
+            std::vector<V> r1, r2;
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), 0);
+                V n1, n2;
+                std::size_t const found1 = rt.query(bgi::nearest(p, 1), &n1);
+                bool const found2 = bgi::detail::kd_nearest_extents(v.begin(), v.end(), extents, p, n2);
+                if ( found1 != 1 || ! found2
+                  || bg::comparable_distance(p, n1) != bg::comparable_distance(p, n2) )
+                {
+                    std::cout << "rtree::nearest and kd_nearest_extents results not compatible!" << std::endl;
+                    print(p); std::cout << std::endl;
+                    ++errors;
+                }
+
+                r1.clear();
+                r2.clear();
+                rt.query(bgi::intersects(to_query_box(c)), std::back_inserter(r1));
+                bgi::detail::kd_query_intersects_extents(v.begin(), v.end(), extents, to_query_box(c), std::back_inserter(r2));
+                if ( r1.size() != r2.size() )
+                {
+                    std::cout << "rtree::intersects and kd_query_intersects_extents results not compatible!" << std::endl;
+                    print(to_query_box(c)); std::cout << std::endl;
+                    ++errors;
+                }
+
+                if ( ! bgi::detail::kd_binary_search_extents(v.begin(), v.end(), extents, to_v(c)) )
+                {
+                    std::cout << "kd_binary_search_extents results not compatible!" << std::endl;
+                    ++errors;
+                }
+
+                if ( errors > 10 )
+                    break;
+            }
+        }
+
+        std::cout << "------------------------------------------------" << std::endl;
+
+        {
+            int errors = 0;
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), 0);
+                V p1, p2, p3;
+                bool r1 = rt.query(bgi::nearest(p, 1), &p1) > 0;
+                bool r2 = bgi::detail::kd_nearest(v2.begin(), v2.end(), p, p2);
+                bool r3 = bgi::detail::kd_nearest_left_balanced(v3.begin(), v3.end(), p, p3);
+                
                 if ( r1 != r2
                   || bg::comparable_distance(p, p1) != bg::comparable_distance(p, p2) )
                 {
@@ -254,10 +2345,141 @@ int main()
                     ++errors;
                 }
 
+                V p4;
+                bool r4 = bgi::detail::kd_nearest_left_balanced_iterative(v3.begin(), v3.end(), p, p4);
+                if ( r3 != r4 || ! bg::equals(p3, p4) )
+                {
+                    std::cout << "kd_nearest_left_balanced and kd_nearest_left_balanced_iterative results not compatible!" << std::endl;
+                    print(p); std::cout << std::endl;
+                    print(p3); std::cout << std::endl;
+                    print(p4); std::cout << std::endl;
+                    ++errors;
+                }
+
+                if ( errors > 10 )
+                    break;
+            }
+        }
+
+        {
+            int errors = 0;
+            std::vector<V> r1, r2, r3;
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), 0);
+                r1.clear(); r2.clear(); r3.clear();
+                rt.query(bgi::nearest(p, nearest_k), std::back_inserter(r1));
+                bgi::detail::kd_nearest_k(v2.begin(), v2.end(), p, nearest_k, std::back_inserter(r2));
+                bgi::detail::kd_nearest_k_left_balanced(v3.begin(), v3.end(), p, nearest_k, std::back_inserter(r3));
+
+                std::vector<double> d1, d2, d3;
+                BOOST_FOREACH(V const& v, r1) d1.push_back(bg::comparable_distance(p, v));
+                BOOST_FOREACH(V const& v, r2) d2.push_back(bg::comparable_distance(p, v));
+                BOOST_FOREACH(V const& v, r3) d3.push_back(bg::comparable_distance(p, v));
+                std::sort(d1.begin(), d1.end());
+
+                if ( d1 != d2 )
+                {
+                    std::cout << "nearest(k) and kd_nearest_k results not compatible!" << std::endl;
+                    print(p); std::cout << std::endl;
+                    ++errors;
+                }
+
+                if ( d1 != d3 )
+                {
+                    std::cout << "nearest(k) and kd_nearest_k_left_balanced results not compatible!" << std::endl;
+                    print(p); std::cout << std::endl;
+                    ++errors;
+                }
+
+                if ( errors > 10 )
+                    break;
+            }
+        }
+
+#ifndef TEST_BOXES
+        {
+            int errors = 0;
+            std::size_t checked = 0;
+            std::vector<std::pair<V, double> > r1, r2;
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                P p(boost::get<0>(c), boost::get<1>(c));
+                r1.clear(); r2.clear();
+                bgi::detail::kd_within_distance_sorted(v2.begin(), v2.end(), p, within_distance, std::back_inserter(r1));
+                bgi::detail::kd_within_distance_left_balanced_sorted(v3.begin(), v3.end(), p, within_distance, std::back_inserter(r2));
+
+                std::size_t count = 0;
+                BOOST_FOREACH(V const& v, v1)
+                {
+                    if ( bg::comparable_distance(p, v) <= within_distance * within_distance )
+                        ++count;
+                }
+
+                bool sorted = true;
+                for ( std::size_t i = 1 ; i < r1.size() ; ++i )
+                    sorted = sorted && r1[i-1].second <= r1[i].second;
+
+                if ( r1.size() != count || ! sorted )
+                {
+                    std::cout << "brute force and kd_within_distance_sorted results not compatible!" << std::endl;
+                    std::cout << count << ' ' << r1.size() << std::endl;
+                    print(p); std::cout << std::endl;
+                    ++errors;
+                }
+
+                bool equal = r1.size() == r2.size();
+                for ( std::size_t i = 0 ; equal && i < r1.size() ; ++i )
+                    equal = r1[i].second == r2[i].second;
+
+                if ( ! equal )
+                {
+                    std::cout << "kd_within_distance_sorted and kd_within_distance_left_balanced_sorted results not compatible!" << std::endl;
+                    std::cout << r1.size() << ' ' << r2.size() << std::endl;
+                    print(p); std::cout << std::endl;
+                    ++errors;
+                }
+
+                // brute force is slow
+                if ( errors > 10 || ++checked >= 1000 )
+                    break;
+            }
+        }
+        {
+            int errors = 0;
+            std::vector<V> r1, r2, r3;
+            BOOST_FOREACH(pt_data const& c, coords)
+            {
+                B b = to_query_box(c);
+                r1.clear(); r2.clear(); r3.clear();
+                rt.query(bgi::intersects(b), std::back_inserter(r1));
+                bgi::detail::kd_query_within(v2.begin(), v2.end(), b, std::back_inserter(r2));
+                bgi::detail::kd_query_within_left_balanced(v3.begin(), v3.end(), b, std::back_inserter(r3));
+                std::sort(r1.begin(), r1.end(), bg::less<P>());
+                std::sort(r2.begin(), r2.end(), bg::less<P>());
+                std::sort(r3.begin(), r3.end(), bg::less<P>());
+
+                if ( r1.size() != r2.size() || ! std::equal(r1.begin(), r1.end(), r2.begin(), bg::equals<V, V>) )
+                {
+                    std::cout << "intersects() and kd_query_within results not compatible!" << std::endl;
+                    std::cout << r1.size() << ' ' << r2.size() << std::endl;
+                    print(b); std::cout << std::endl;
+                    ++errors;
+                }
+
+                if ( r1.size() != r3.size() || ! std::equal(r1.begin(), r1.end(), r3.begin(), bg::equals<V, V>) )
+                {
+                    std::cout << "intersects() and kd_query_within_left_balanced results not compatible!" << std::endl;
+                    std::cout << r1.size() << ' ' << r3.size() << std::endl;
+                    print(b); std::cout << std::endl;
+                    ++errors;
+                }
+
                 if ( errors > 10 )
                     break;
             }
         }
+#endif
 
     }
 
@@ -11,19 +11,31 @@
 
 #include "kd_less.hpp"
 #include "kd_is_further.hpp"
+#include "kd_leaf_simd.hpp"
+#include "kd_nearest_approximation.hpp"
+#include "kd_nearest_k_result.hpp"
+#include "kd_traversal_stats.hpp"
+#include "kd_within_distance_result.hpp"
 
 namespace boost { namespace geometry { namespace index { namespace detail {
 
 // ---------------------------------------------------------------------- //
 
+// The maximum number of values in a leaf, the default for all of the ranges.
+// It may also be passed as the first template parameter of kd_sort() and
+// of the queries, e.g. kd_sort<16>(first, last). The queries must use the same
+// or greater value than the one used by kd_sort().
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN
 #define BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN 8
+#endif
 #if BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN < 1
 #error "invalid value"
 #endif
 
 // ---------------------------------------------------------------------- //
 
-template <typename Point, std::size_t I = 0>
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
 struct kd_sort_impl
 {
     static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
@@ -38,30 +50,38 @@ struct kd_sort_impl
         It nth = first + lsize;
         std::nth_element(first, nth, last, kd_less<I, Point, Point>);
 
-        if ( lsize > BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN )
+        if ( lsize > ValuesMin )
         {
-            kd_sort_impl<Point, next_dimension>::apply(first, nth);
+            kd_sort_impl<Point, next_dimension, ValuesMin>::apply(first, nth);
         }
-        if ( rsize > BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN )
+        if ( rsize > ValuesMin )
         {
-            kd_sort_impl<Point, next_dimension>::apply(nth+1, last);
+            kd_sort_impl<Point, next_dimension, ValuesMin>::apply(nth+1, last);
         }
     }
 };
 
-template <typename RandomIt>
+template <std::size_t ValuesMin, typename RandomIt>
 inline void kd_sort(RandomIt first, RandomIt last)
 {
     typedef typename boost::iterator_value<RandomIt>::type point_type;
     if ( std::distance(first, last) > 1 )
     {
-        kd_sort_impl<point_type>::apply(first, last);
+        kd_sort_impl<point_type, 0, ValuesMin>::apply(first, last);
     }
 }
 
+template <typename RandomIt>
+inline void kd_sort(RandomIt first, RandomIt last)
+{
+    kd_sort<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last);
+}
+
 // ---------------------------------------------------------------------- //
 
-template <typename Point, std::size_t I = 0>
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN,
+          typename Stats = kd_default_stats>
 struct kd_binary_search_impl
 {
     static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
@@ -71,25 +91,23 @@ struct kd_binary_search_impl
     {
         std::size_t size = static_cast<std::size_t>(std::distance(first, last));
 
-        if ( size > BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN )
+        if ( size > ValuesMin )
         {
-            return kd_binary_search_impl<Point, next_dimension>::apply(first, last, value);
+            return kd_binary_search_impl<Point, next_dimension, ValuesMin, Stats>::apply(first, last, value);
         }
         else
         {
-            for ( ; first != last ; ++first )
-            {
-                if ( geometry::equals(*first, value) )
-                    return true;
-            }
+            Stats::leaf(size);
+            return kd_leaf_binary_search<It, Value>::apply(first, last, value);
         }
-
-        return false;
     }
 
     template <typename It, typename Value>
     static inline bool apply(It first, It last, Value const& value)
     {
+        typename Stats::scope scope;
+        Stats::node();
+
         std::size_t size = static_cast<std::size_t>(std::distance(first, last));
         std::size_t lsize = size / 2;
 
@@ -117,19 +135,27 @@ struct kd_binary_search_impl
     }
 };
 
-template <typename RandomIt, typename Value>
+template <std::size_t ValuesMin, typename RandomIt, typename Value>
 inline bool kd_binary_search(RandomIt first, RandomIt last, Value const& value)
 {
     if ( std::distance(first, last) < 1 )
         return false;
 
     typedef typename boost::iterator_value<RandomIt>::type point_type;
-    return kd_binary_search_impl<point_type>::apply(first, last, value);
+    return kd_binary_search_impl<point_type, 0, ValuesMin, kd_default_stats>::apply(first, last, value);
+}
+
+template <typename RandomIt, typename Value>
+inline bool kd_binary_search(RandomIt first, RandomIt last, Value const& value)
+{
+    return kd_binary_search<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, value);
 }
 
 // ---------------------------------------------------------------------- //
 
-template <typename Point, std::size_t I = 0>
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN,
+          typename Stats = kd_default_stats>
 struct kd_nearest_impl
 {
     static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
@@ -137,6 +163,7 @@ struct kd_nearest_impl
     template <typename It, typename Value, typename CDist>
     static inline bool update_one(It it, Value const& point, It & out_it, CDist & smallest_cdist)
     {
+        Stats::distance();
         CDist cdist = geometry::comparable_distance(point, *it);
         if ( cdist < smallest_cdist )
         {
@@ -147,23 +174,24 @@ struct kd_nearest_impl
         return math::equals(smallest_cdist, CDist(0));
     }
 
-    template <typename It, typename Value, typename CDist>
-    static inline bool per_branch(It first, It last, Value const& point, It & out_it, CDist & smallest_cdist)
+    template <typename It, typename Value, typename CDist, typename Bound>
+    static inline bool per_branch(It first, It last, Value const& point, It & out_it, CDist & smallest_cdist,
+                                  Bound & bound)
     {
         std::size_t size = static_cast<std::size_t>(std::distance(first, last));
 
-        if ( size > BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN )
+        if ( size > ValuesMin )
         {
-            if ( kd_nearest_impl<Point, next_dimension>::apply(first, last, point, out_it, smallest_cdist) )
+            if ( kd_nearest_impl<Point, next_dimension, ValuesMin, Stats>::apply(first, last, point, out_it, smallest_cdist, bound) )
                 return true;
         }
         else
         {
-            for ( ; first != last ; ++first )
-            {
-                if ( update_one(first, point, out_it, smallest_cdist) )
-                    return true;
-            }
+            Stats::leaf(size);
+            Stats::distance(size);
+            if ( kd_leaf_nearest<It, Value>::apply(first, last, point, out_it, smallest_cdist)
+              || bound.visit(size) )
+                return true;
         }
 
         return false;
@@ -172,46 +200,64 @@ struct kd_nearest_impl
     template <typename It, typename Value, typename CDist>
     static inline bool apply(It first, It last, Value const& point, It & out_it, CDist & smallest_cdist)
     {
+        kd_nearest_exact bound;
+        return apply(first, last, point, out_it, smallest_cdist, bound);
+    }
+
+    // the Bound is kd_nearest_exact or kd_nearest_approximation
+    template <typename It, typename Value, typename CDist, typename Bound>
+    static inline bool apply(It first, It last, Value const& point, It & out_it, CDist & smallest_cdist,
+                             Bound & bound)
+    {
+        typename Stats::scope scope;
+        Stats::node();
+
         std::size_t size = static_cast<std::size_t>(std::distance(first, last));
         std::size_t lsize = size / 2;
         It nth = first + lsize;
 
-        if ( update_one(nth, point, out_it, smallest_cdist) )
+        if ( update_one(nth, point, out_it, smallest_cdist) || bound.visit() )
             return true;
 
         if ( kd_less<I>(point, *nth) )
         {
-            if ( per_branch(first, nth, point, out_it, smallest_cdist) )
+            if ( per_branch(first, nth, point, out_it, smallest_cdist, bound) )
                 return true;
 
-            if ( kd_is_further<I>(point, *nth, smallest_cdist) )
+            if ( kd_is_further<I>(point, *nth, bound.bound(smallest_cdist)) )
+            {
+                Stats::prune();
                 return false;
+            }
 
-            return per_branch(nth+1, last, point, out_it, smallest_cdist);
+            return per_branch(nth+1, last, point, out_it, smallest_cdist, bound);
         }
         else if ( kd_less<I>(*nth, point) )
         {
-            if ( per_branch(nth+1, last, point, out_it, smallest_cdist) )
+            if ( per_branch(nth+1, last, point, out_it, smallest_cdist, bound) )
                 return true;
 
-            if ( kd_is_further<I>(*nth, point, smallest_cdist) )
+            if ( kd_is_further<I>(*nth, point, bound.bound(smallest_cdist)) )
+            {
+                Stats::prune();
                 return false;
+            }
 
-            return per_branch(first, nth, point, out_it, smallest_cdist);
+            return per_branch(first, nth, point, out_it, smallest_cdist, bound);
         }
         else
         {
-            if ( per_branch(first, nth, point, out_it, smallest_cdist) )
+            if ( per_branch(first, nth, point, out_it, smallest_cdist, bound) )
                 return true;
 
-            return per_branch(nth+1, last, point, out_it, smallest_cdist);
+            return per_branch(nth+1, last, point, out_it, smallest_cdist, bound);
         }
 
         return false;
     }
 };
 
-template <typename RandomIt, typename Point, typename Value>
+template <std::size_t ValuesMin, typename RandomIt, typename Point, typename Value>
 inline bool kd_nearest(RandomIt first, RandomIt last, Point const& point, Value & result)
 {
     if ( std::distance(first, last) < 1 )
@@ -223,13 +269,379 @@ inline bool kd_nearest(RandomIt first, RandomIt last, Point const& point, Value
         cdist = geometry::comparable_distance(point, *first);
     RandomIt out_it = first;
     
-    kd_nearest_impl<point_type>::apply(first, last, point, out_it, cdist);
+    kd_nearest_impl<point_type, 0, ValuesMin, kd_default_stats>::apply(first, last, point, out_it, cdist);
 
     result = *out_it;
 
     return true;
 }
 
+template <typename RandomIt, typename Point, typename Value>
+inline bool kd_nearest(RandomIt first, RandomIt last, Point const& point, Value & result)
+{
+    return kd_nearest<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, point, result);
+}
+
+// ---------------------------------------------------------------------- //
+
+// finds a value at most (1+epsilon) times further than the nearest one,
+// see kd_nearest_approximation
+template <std::size_t ValuesMin, typename RandomIt, typename Point, typename Value>
+inline bool kd_nearest(RandomIt first, RandomIt last, Point const& point, Value & result,
+                       double epsilon, std::size_t max_visited = 0)
+{
+    if ( std::distance(first, last) < 1 )
+        return false;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typedef typename geometry::default_comparable_distance_result<point_type>::type cdist_type;
+
+    cdist_type cdist = geometry::comparable_distance(point, *first);
+    RandomIt out_it = first;
+    kd_nearest_approximation<cdist_type> approximation(epsilon, max_visited);
+
+    kd_nearest_impl<point_type, 0, ValuesMin, kd_default_stats>::apply(first, last, point, out_it, cdist, approximation);
+
+    result = *out_it;
+
+    return true;
+}
+
+template <typename RandomIt, typename Point, typename Value>
+inline bool kd_nearest(RandomIt first, RandomIt last, Point const& point, Value & result,
+                       double epsilon, std::size_t max_visited = 0)
+{
+    return kd_nearest<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, point, result, epsilon, max_visited);
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_nearest_k_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It, typename Value, typename Result>
+    static inline bool update_one(It it, Value const& point, Result & result)
+    {
+        typename Result::distance_type cdist = geometry::comparable_distance(point, *it);
+        return result.update(it, cdist);
+    }
+
+    template <typename It, typename Value, typename Result>
+    static inline bool per_branch(It first, It last, Value const& point, Result & result)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size > ValuesMin )
+        {
+            if ( kd_nearest_k_impl<Point, next_dimension, ValuesMin>::apply(first, last, point, result) )
+                return true;
+        }
+        else
+        {
+            for ( ; first != last ; ++first )
+            {
+                if ( update_one(first, point, result) )
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    template <typename It, typename Value, typename Result>
+    static inline bool apply(It first, It last, Value const& point, Result & result)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        It nth = first + lsize;
+
+        if ( update_one(nth, point, result) )
+            return true;
+
+        if ( kd_less<I>(point, *nth) )
+        {
+            if ( per_branch(first, nth, point, result) )
+                return true;
+
+            if ( result.is_full() && kd_is_further<I>(point, *nth, result.greatest_cdist()) )
+                return false;
+
+            return per_branch(nth+1, last, point, result);
+        }
+        else if ( kd_less<I>(*nth, point) )
+        {
+            if ( per_branch(nth+1, last, point, result) )
+                return true;
+
+            if ( result.is_full() && kd_is_further<I>(*nth, point, result.greatest_cdist()) )
+                return false;
+
+            return per_branch(first, nth, point, result);
+        }
+        else
+        {
+            if ( per_branch(first, nth, point, result) )
+                return true;
+
+            return per_branch(nth+1, last, point, result);
+        }
+
+        return false;
+    }
+};
+
+// writes at most k closest values sorted by distance, returns the number of values written
+template <std::size_t ValuesMin, typename RandomIt, typename Point, typename OutIt>
+inline std::size_t kd_nearest_k(RandomIt first, RandomIt last, Point const& point, std::size_t k, OutIt out_it)
+{
+    if ( std::distance(first, last) < 1 || k < 1 )
+        return 0;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typedef typename geometry::default_comparable_distance_result<point_type>::type cdist_type;
+
+    kd_nearest_k_result<RandomIt, cdist_type> result(k, static_cast<std::size_t>(std::distance(first, last)));
+
+    kd_nearest_k_impl<point_type, 0, ValuesMin>::apply(first, last, point, result);
+
+    result.finish(out_it);
+
+    return result.size();
+}
+
+template <typename RandomIt, typename Point, typename OutIt>
+inline std::size_t kd_nearest_k(RandomIt first, RandomIt last, Point const& point, std::size_t k, OutIt out_it)
+{
+    return kd_nearest_k<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, point, k, out_it);
+}
+
+// ---------------------------------------------------------------------- //
+
+// The Filter is called for the elements passing the spatial test, only
+// the elements for which it returns true are written, e.g. see kd_alive_filter.
+struct kd_no_filter
+{
+    template <typename It>
+    inline bool operator()(It ) const
+    {
+        return true;
+    }
+};
+
+// Only the Points are supported for now. The median recursion defines no bounds
+// of the Boxes' extents so the subtrees can't be safely pruned.
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN,
+          typename Filter = kd_no_filter>
+struct kd_query_within_impl
+{
+    BOOST_MPL_ASSERT_MSG((boost::is_same<typename geometry::tag<Point>::type, point_tag>::value),
+                         NOT_IMPLEMENTED_FOR_THIS_VALUE_TYPE, (Point));
+
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It, typename Box, typename OutIt>
+    static inline void update_one(It it, Box const& box, OutIt & out_it, std::size_t & count, Filter const& filter)
+    {
+        if ( geometry::covered_by(*it, box) && filter(it) )
+        {
+            *out_it = *it;
+            ++out_it;
+            ++count;
+        }
+    }
+
+    template <typename It, typename Box, typename OutIt>
+    static inline void per_branch(It first, It last, Box const& box, OutIt & out_it, std::size_t & count,
+                                  Filter const& filter)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size > ValuesMin )
+        {
+            kd_query_within_impl<Point, next_dimension, ValuesMin, Filter>::apply(first, last, box, out_it, count, filter);
+        }
+        else
+        {
+            for ( ; first != last ; ++first )
+            {
+                update_one(first, box, out_it, count, filter);
+            }
+        }
+    }
+
+    template <typename It, typename Box, typename OutIt>
+    static inline void apply(It first, It last, Box const& box, OutIt & out_it, std::size_t & count,
+                             Filter const& filter = Filter())
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        It nth = first + lsize;
+
+        update_one(nth, box, out_it, count, filter);
+
+        // the values in the left half are not greater than the median on axis I
+        // so they may be in the box only if the median is not less than the box
+        if ( ! kd_less<I>(*nth, box) )
+        {
+            per_branch(first, nth, box, out_it, count, filter);
+        }
+        // analogically the values in the right half are not less than the median
+        if ( ! kd_less<I>(box, *nth) )
+        {
+            per_branch(nth+1, last, box, out_it, count, filter);
+        }
+    }
+};
+
+// writes the values covered by the box, returns the number of values written
+template <std::size_t ValuesMin, typename RandomIt, typename Box, typename OutIt>
+inline std::size_t kd_query_within(RandomIt first, RandomIt last, Box const& box, OutIt out_it)
+{
+    if ( std::distance(first, last) < 1 )
+        return 0;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+
+    std::size_t count = 0;
+    kd_query_within_impl<point_type, 0, ValuesMin>::apply(first, last, box, out_it, count);
+
+    return count;
+}
+
+template <typename RandomIt, typename Box, typename OutIt>
+inline std::size_t kd_query_within(RandomIt first, RandomIt last, Box const& box, OutIt out_it)
+{
+    return kd_query_within<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, box, out_it);
+}
+
+// ---------------------------------------------------------------------- //
+
+// Only the Points are supported, see kd_query_within_impl
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN,
+          typename Filter = kd_no_filter>
+struct kd_within_distance_impl
+{
+    BOOST_MPL_ASSERT_MSG((boost::is_same<typename geometry::tag<Point>::type, point_tag>::value),
+                         NOT_IMPLEMENTED_FOR_THIS_VALUE_TYPE, (Point));
+
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It, typename Value, typename CDist, typename OutIt>
+    static inline void update_one(It it, Value const& point, CDist const& max_cdist, OutIt & out_it, std::size_t & count,
+                                  Filter const& filter)
+    {
+        CDist cdist = geometry::comparable_distance(point, *it);
+        if ( ! (max_cdist < cdist) && filter(it) )
+        {
+            *out_it = std::make_pair(*it, cdist);
+            ++out_it;
+            ++count;
+        }
+    }
+
+    template <typename It, typename Value, typename CDist, typename OutIt>
+    static inline void per_branch(It first, It last, Value const& point, CDist const& max_cdist, OutIt & out_it, std::size_t & count,
+                                  Filter const& filter)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size > ValuesMin )
+        {
+            kd_within_distance_impl<Point, next_dimension, ValuesMin, Filter>::apply(first, last, point, max_cdist, out_it, count, filter);
+        }
+        else
+        {
+            for ( ; first != last ; ++first )
+            {
+                update_one(first, point, max_cdist, out_it, count, filter);
+            }
+        }
+    }
+
+    template <typename It, typename Value, typename CDist, typename OutIt>
+    static inline void apply(It first, It last, Value const& point, CDist const& max_cdist, OutIt & out_it, std::size_t & count,
+                             Filter const& filter = Filter())
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        It nth = first + lsize;
+
+        update_one(nth, point, max_cdist, out_it, count, filter);
+
+        if ( kd_less<I>(point, *nth) )
+        {
+            per_branch(first, nth, point, max_cdist, out_it, count, filter);
+
+            if ( ! kd_is_further<I>(point, *nth, max_cdist) )
+                per_branch(nth+1, last, point, max_cdist, out_it, count, filter);
+        }
+        else if ( kd_less<I>(*nth, point) )
+        {
+            per_branch(nth+1, last, point, max_cdist, out_it, count, filter);
+
+            if ( ! kd_is_further<I>(*nth, point, max_cdist) )
+                per_branch(first, nth, point, max_cdist, out_it, count, filter);
+        }
+        else
+        {
+            per_branch(first, nth, point, max_cdist, out_it, count, filter);
+            per_branch(nth+1, last, point, max_cdist, out_it, count, filter);
+        }
+    }
+};
+
+// writes the (value, comparable distance) pairs of the values within the distance
+// from the point, returns the number of values written
+// the comparable distance is the squared distance, see kd_is_further()
+template <std::size_t ValuesMin, typename RandomIt, typename Point, typename Distance, typename OutIt>
+inline std::size_t kd_within_distance(RandomIt first, RandomIt last, Point const& point, Distance const& distance, OutIt out_it)
+{
+    if ( std::distance(first, last) < 1 )
+        return 0;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typedef typename geometry::default_comparable_distance_result<point_type>::type cdist_type;
+
+    cdist_type max_cdist = distance;
+    max_cdist *= max_cdist;
+
+    std::size_t count = 0;
+    kd_within_distance_impl<point_type, 0, ValuesMin>::apply(first, last, point, max_cdist, out_it, count);
+
+    return count;
+}
+
+template <typename RandomIt, typename Point, typename Distance, typename OutIt>
+inline std::size_t kd_within_distance(RandomIt first, RandomIt last, Point const& point, Distance const& distance, OutIt out_it)
+{
+    return kd_within_distance<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, point, distance, out_it);
+}
+
+// the same as kd_within_distance() but the pairs are written sorted by distance
+template <std::size_t ValuesMin, typename RandomIt, typename Point, typename Distance, typename OutIt>
+inline std::size_t kd_within_distance_sorted(RandomIt first, RandomIt last, Point const& point, Distance const& distance, OutIt out_it)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typedef typename geometry::default_comparable_distance_result<point_type>::type cdist_type;
+
+    kd_within_distance_sorted_result<point_type, cdist_type> result;
+    std::size_t count = kd_within_distance<ValuesMin>(first, last, point, distance, result.inserter());
+    result.finish(out_it);
+
+    return count;
+}
+
+template <typename RandomIt, typename Point, typename Distance, typename OutIt>
+inline std::size_t kd_within_distance_sorted(RandomIt first, RandomIt last, Point const& point, Distance const& distance, OutIt out_it)
+{
+    return kd_within_distance_sorted<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, point, distance, out_it);
+}
+
 // ---------------------------------------------------------------------- //
 
 }}}} // namespace boost::geometry::index::detail
@@ -0,0 +1,433 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_BLOCKED_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_BLOCKED_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "kd_sort_left_balanced.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_CACHE_LINE
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_CACHE_LINE 64
+#endif
+
+// The tree is the same as the one created by kd_sort_left_balanced() but
+// the subtrees of height BlockHeight are stored contiguously, B-tree style.
+// The top block is shorter if needed so all of the other blocks have the full
+// height. Inside a block and among the blocks of the same level the nodes are
+// stored in the BFS order. Only the bottom blocks may be partially filled,
+// they're stored without gaps.
+// A block is loaded with a few cache lines so the blocked binary search pays
+// off when the tree doesn't fit in the cache. The nearest query visits
+// the siblings too and isn't faster than the one of the BFS layout.
+
+// the greatest height for which a block fits in 2 cache lines
+template <typename Point,
+          std::size_t Height = 1,
+          bool Fits = ((std::size_t(2) << Height) - 1) * sizeof(Point) <= 2 * BOOST_GEOMETRY_INDEX_DETAIL_KD_CACHE_LINE>
+struct kd_blocked_default_height
+{
+    static const std::size_t value = kd_blocked_default_height<Point, (Height + 1)>::value;
+};
+
+template <typename Point, std::size_t Height>
+struct kd_blocked_default_height<Point, Height, false>
+{
+    static const std::size_t value = Height;
+};
+
+inline std::size_t kd_floor_log2(std::size_t v)
+{
+#if defined(__GNUC__)
+    return sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(v);
+#else
+    std::size_t result = 0;
+    for ( ; v > 1 ; v /= 2 )
+        ++result;
+    return result;
+#endif
+}
+
+// a node of the tree visited by a traversal
+struct kd_blocked_node
+{
+    std::size_t index;       // the index in the left-balanced tree [1, count]
+    std::size_t position;    // the position in the blocked layout [0, count)
+    std::size_t block;       // the index of the block in its level of blocks
+    std::size_t block_depth; // the depth of the roots of the blocks in this level
+    std::size_t local_index; // the index in the block [1, 2^BlockHeight)
+    std::size_t local_depth; // the depth in the block
+};
+
+// maps the index of a node in the left-balanced tree [1, count]
+// to its position in the blocked layout [0, count)
+template <std::size_t BlockHeight>
+class kd_blocked_layout
+{
+    BOOST_MPL_ASSERT_MSG((BlockHeight > 0), INVALID_BLOCK_HEIGHT, (kd_blocked_layout));
+
+public:
+    explicit kd_blocked_layout(std::size_t count)
+    {
+        std::size_t const height = kd_floor_log2(count) + 1;
+        m_top_height = (height - 1) % BlockHeight + 1;
+        m_bottom_depth = height > BlockHeight ? height - BlockHeight : 0;
+        m_last_count = count - ((std::size_t(1) << (height - 1)) - 1);
+    }
+
+    inline std::size_t position(std::size_t index) const
+    {
+        std::size_t const depth = kd_floor_log2(index);
+        if ( depth < m_top_height )
+            return index - 1;
+
+        std::size_t const block_depth = depth - (depth - m_top_height) % BlockHeight;
+        std::size_t const local_depth = depth - block_depth;
+        std::size_t const block_root = index >> local_depth;
+        std::size_t const block = block_root - (std::size_t(1) << block_depth);
+        std::size_t const local_index = index - (block_root << local_depth) + (std::size_t(1) << local_depth);
+
+        return block_position(block, block_depth) + local_index - 1;
+    }
+
+    inline kd_blocked_node root() const
+    {
+        kd_blocked_node result = { 1, 0, 0, 0, 1, 0 };
+        return result;
+    }
+
+    // side is 0 for the left child and 1 for the right child
+    // the traversal is incremental, the position is calculated only
+    // when the child is the root of a block
+    inline kd_blocked_node child(kd_blocked_node const& node, std::size_t side) const
+    {
+        kd_blocked_node result;
+        result.index = 2 * node.index + side;
+
+        std::size_t const height = node.block_depth == 0 ? m_top_height : BlockHeight;
+        if ( node.local_depth + 1 < height )
+        {
+            result.block = node.block;
+            result.block_depth = node.block_depth;
+            result.local_index = 2 * node.local_index + side;
+            result.local_depth = node.local_depth + 1;
+            result.position = node.position + node.local_index + side;
+        }
+        else
+        {
+            std::size_t const last_row = std::size_t(1) << (height - 1);
+            result.block = (node.block << height) + 2 * (node.local_index - last_row) + side;
+            result.block_depth = node.block_depth + height;
+            result.local_index = 1;
+            result.local_depth = 0;
+            result.position = block_position(result.block, result.block_depth);
+        }
+
+        return result;
+    }
+
+private:
+    // the position of the root of the block
+    inline std::size_t block_position(std::size_t block, std::size_t block_depth) const
+    {
+        // all of the nodes above this level of blocks
+        std::size_t result = (std::size_t(1) << block_depth) - 1;
+        if ( block_depth < m_bottom_depth )
+        {
+            result += block * ((std::size_t(1) << BlockHeight) - 1);
+        }
+        else
+        {
+            std::size_t const last_row = std::size_t(1) << (BlockHeight - 1);
+            result += block * (last_row - 1) + (std::min)(m_last_count, block * last_row);
+        }
+        return result;
+    }
+
+    std::size_t m_top_height;
+    std::size_t m_bottom_depth;
+    std::size_t m_last_count;
+};
+
+// ---------------------------------------------------------------------- //
+
+template <std::size_t BlockHeight, typename RandomIt>
+inline void kd_sort_blocked(RandomIt first, RandomIt last)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    std::size_t const count = static_cast<std::size_t>(std::distance(first, last));
+    if ( count < 2 )
+        return;
+
+    kd_sort_left_balanced_in_place(first, last);
+
+    // move the nodes from the BFS order to their blocks
+    kd_blocked_layout<BlockHeight> const layout(count);
+    std::vector<bool> moved(count, false);
+    for ( std::size_t index = 1 ; index <= count ; ++index )
+    {
+        if ( moved[index - 1] )
+            continue;
+
+        point_type temp = *(first + (index - 1));
+        std::size_t current = index;
+        while ( ! moved[current - 1] )
+        {
+            moved[current - 1] = true;
+            std::size_t const position = layout.position(current);
+            std::swap(temp, *(first + position));
+            current = position + 1;
+        }
+    }
+}
+
+template <typename RandomIt>
+inline void kd_sort_blocked(RandomIt first, RandomIt last)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    kd_sort_blocked<kd_blocked_default_height<point_type>::value>(first, last);
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0>
+struct kd_binary_search_blocked_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It, typename Layout, typename Value>
+    static inline bool apply(It first, Layout const& layout,
+                             kd_blocked_node const& node, std::size_t const max_index,
+                             Value const& value)
+    {
+        It nth = first + node.position;
+
+        if ( geometry::equals(*nth, value) )
+            return true;
+
+        std::size_t const left = 2 * node.index;
+        std::size_t const right = left + 1;
+
+        if ( kd_less<I>(value, *nth) )
+        {
+            return left <= max_index
+                && kd_binary_search_blocked_impl<Point, next_dimension>
+                        ::apply(first, layout, layout.child(node, 0), max_index, value);
+        }
+        else if ( kd_less<I>(*nth, value) )
+        {
+            return right <= max_index
+                && kd_binary_search_blocked_impl<Point, next_dimension>
+                        ::apply(first, layout, layout.child(node, 1), max_index, value);
+        }
+        else
+        {
+            return ( left <= max_index
+                  && kd_binary_search_blocked_impl<Point, next_dimension>
+                        ::apply(first, layout, layout.child(node, 0), max_index, value) )
+                || ( right <= max_index
+                  && kd_binary_search_blocked_impl<Point, next_dimension>
+                        ::apply(first, layout, layout.child(node, 1), max_index, value) );
+        }
+    }
+};
+
+template <std::size_t BlockHeight, typename RandomIt, typename Value>
+inline bool kd_binary_search_blocked(RandomIt first, RandomIt last, Value const& value)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    std::size_t const count = static_cast<std::size_t>(std::distance(first, last));
+    if ( count < 1 )
+        return false;
+
+    kd_blocked_layout<BlockHeight> const layout(count);
+    return kd_binary_search_blocked_impl<point_type>::apply(first, layout, layout.root(), count, value);
+}
+
+template <typename RandomIt, typename Value>
+inline bool kd_binary_search_blocked(RandomIt first, RandomIt last, Value const& value)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    return kd_binary_search_blocked<kd_blocked_default_height<point_type>::value>(first, last, value);
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0>
+struct kd_nearest_blocked_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It, typename Layout, typename Value, typename CDist>
+    static inline bool per_branch(It first, Layout const& layout,
+                                  kd_blocked_node const& node, std::size_t max_index,
+                                  Value const& point,
+                                  It & out_it, CDist & smallest_cdist)
+    {
+        return kd_nearest_blocked_impl<Point, next_dimension>
+                    ::apply(first, layout, node, max_index, point, out_it, smallest_cdist);
+    }
+
+    template <typename It, typename Layout, typename Value, typename CDist>
+    static inline bool apply(It first, Layout const& layout,
+                             kd_blocked_node const& node, std::size_t const max_index,
+                             Value const& point,
+                             It & out_it, CDist & smallest_cdist)
+    {
+        It nth = first + node.position;
+
+        if ( kd_nearest_left_balanced_impl<Point>::update_one(nth, point, out_it, smallest_cdist) )
+            return true;
+
+        std::size_t const left = 2 * node.index;
+        std::size_t const right = left + 1;
+
+        if ( left > max_index )
+            return false;
+
+        if ( kd_less<I>(point, *nth) )
+        {
+            if ( per_branch(first, layout, layout.child(node, 0), max_index, point, out_it, smallest_cdist) )
+                return true;
+
+            if ( right > max_index || kd_is_further<I>(point, *nth, smallest_cdist) )
+                return false;
+
+            return per_branch(first, layout, layout.child(node, 1), max_index, point, out_it, smallest_cdist);
+        }
+        else if ( kd_less<I>(*nth, point) )
+        {
+            if ( right <= max_index )
+                if ( per_branch(first, layout, layout.child(node, 1), max_index, point, out_it, smallest_cdist) )
+                    return true;
+
+            if ( kd_is_further<I>(*nth, point, smallest_cdist) )
+                return false;
+
+            return per_branch(first, layout, layout.child(node, 0), max_index, point, out_it, smallest_cdist);
+        }
+        else
+        {
+            if ( per_branch(first, layout, layout.child(node, 0), max_index, point, out_it, smallest_cdist) )
+                return true;
+
+            if ( right > max_index )
+                return false;
+
+            return per_branch(first, layout, layout.child(node, 1), max_index, point, out_it, smallest_cdist);
+        }
+    }
+};
+
+template <std::size_t BlockHeight, typename RandomIt, typename Point, typename Value>
+inline bool kd_nearest_blocked(RandomIt first, RandomIt last, Point const& point, Value & result)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    std::size_t const count = static_cast<std::size_t>(std::distance(first, last));
+    if ( count < 1 )
+        return false;
+
+    typename geometry::default_comparable_distance_result<point_type>::type
+        cdist = geometry::comparable_distance(point, *first);
+    RandomIt out_it = first;
+
+    kd_blocked_layout<BlockHeight> const layout(count);
+    kd_nearest_blocked_impl<point_type>::apply(first, layout, layout.root(), count, point, out_it, cdist);
+
+    result = *out_it;
+
+    return true;
+}
+
+template <typename RandomIt, typename Point, typename Value>
+inline bool kd_nearest_blocked(RandomIt first, RandomIt last, Point const& point, Value & result)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    return kd_nearest_blocked<kd_blocked_default_height<point_type>::value>(first, last, point, result);
+}
+
+// ---------------------------------------------------------------------- //
+
+// Only the Points are supported, see kd_query_within_impl
+template <typename Point, std::size_t I = 0>
+struct kd_query_within_blocked_impl
+{
+    BOOST_MPL_ASSERT_MSG((boost::is_same<typename geometry::tag<Point>::type, point_tag>::value),
+                         NOT_IMPLEMENTED_FOR_THIS_VALUE_TYPE, (Point));
+
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It, typename Layout, typename Box, typename OutIt>
+    static inline void apply(It first, Layout const& layout,
+                             kd_blocked_node const& node, std::size_t const max_index,
+                             Box const& box,
+                             OutIt & out_it, std::size_t & count)
+    {
+        It nth = first + node.position;
+
+        if ( geometry::covered_by(*nth, box) )
+        {
+            *out_it = *nth;
+            ++out_it;
+            ++count;
+        }
+
+        std::size_t next_index = 2 * node.index;
+        if ( next_index > max_index )
+            return;
+
+        if ( ! kd_less<I>(*nth, box) )
+        {
+            kd_query_within_blocked_impl<Point, next_dimension>
+                ::apply(first, layout, layout.child(node, 0), max_index, box, out_it, count);
+        }
+
+        ++next_index;
+        if ( next_index > max_index )
+            return;
+
+        if ( ! kd_less<I>(box, *nth) )
+        {
+            kd_query_within_blocked_impl<Point, next_dimension>
+                ::apply(first, layout, layout.child(node, 1), max_index, box, out_it, count);
+        }
+    }
+};
+
+// writes the values covered by the box, returns the number of values written
+template <std::size_t BlockHeight, typename RandomIt, typename Box, typename OutIt>
+inline std::size_t kd_query_within_blocked(RandomIt first, RandomIt last, Box const& box, OutIt out_it)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    std::size_t const size = static_cast<std::size_t>(std::distance(first, last));
+    if ( size < 1 )
+        return 0;
+
+    kd_blocked_layout<BlockHeight> const layout(size);
+    std::size_t count = 0;
+    kd_query_within_blocked_impl<point_type>::apply(first, layout, layout.root(), size, box, out_it, count);
+
+    return count;
+}
+
+template <typename RandomIt, typename Box, typename OutIt>
+inline std::size_t kd_query_within_blocked(RandomIt first, RandomIt last, Box const& box, OutIt out_it)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    return kd_query_within_blocked<kd_blocked_default_height<point_type>::value>(first, last, box, out_it);
+}
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_BLOCKED_HPP
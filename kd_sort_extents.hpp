@@ -0,0 +1,418 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_EXTENTS_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_EXTENTS_HPP
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "kd_sort.hpp"
+#include "kd_sort_spread.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// The layout for the Boxes, the same as the one created by kd_sort() but
+// the elements are ordered by their centers and each node stores how far
+// the elements of its children cross the splitting plane: the greatest max
+// coordinate in the left subrange and the smallest min coordinate in the right
+// subrange along the split axis. These bounds are exact so the nearest and
+// intersects queries don't miss the overlapping Boxes, contrary to kd_less()
+// and kd_is_further() which don't take the width of the Boxes into account.
+// For the Points the bounds are the coordinates of the closest elements.
+// The nodes are numbered like in kd_split_axes.
+template <typename Coord>
+class kd_split_extents
+{
+public:
+    typedef Coord coordinate_type;
+
+    // the nodes are [1, nodes_count)
+    inline void reset(std::size_t nodes_count)
+    {
+        m_bounds.assign(nodes_count, std::make_pair(Coord(0), Coord(0)));
+    }
+
+    inline std::size_t nodes_count() const
+    {
+        return m_bounds.size();
+    }
+
+    inline Coord const& left_max(std::size_t node) const
+    {
+        BOOST_ASSERT(node < m_bounds.size());
+        return m_bounds[node].first;
+    }
+
+    inline Coord const& right_min(std::size_t node) const
+    {
+        BOOST_ASSERT(node < m_bounds.size());
+        return m_bounds[node].second;
+    }
+
+    inline void set(std::size_t node, Coord const& left_max, Coord const& right_min)
+    {
+        BOOST_ASSERT(node < m_bounds.size());
+        m_bounds[node].first = left_max;
+        m_bounds[node].second = right_min;
+    }
+
+private:
+    std::vector<std::pair<Coord, Coord> > m_bounds;
+};
+
+// ---------------------------------------------------------------------- //
+
+template <typename Geometry, std::size_t I,
+          typename Tag = typename geometry::tag<Geometry>::type>
+struct kd_extent_coord
+{
+    BOOST_MPL_ASSERT_MSG(false, NOT_IMPLEMENTED, (Geometry));
+};
+
+template <typename Geometry, std::size_t I>
+struct kd_extent_coord<Geometry, I, point_tag>
+{
+    typedef typename coordinate_type<Geometry>::type type;
+
+    static inline type min(Geometry const& g) { return geometry::get<I>(g); }
+    static inline type max(Geometry const& g) { return geometry::get<I>(g); }
+};
+
+template <typename Geometry, std::size_t I>
+struct kd_extent_coord<Geometry, I, box_tag>
+{
+    typedef typename coordinate_type<Geometry>::type type;
+
+    static inline type min(Geometry const& g) { return geometry::get<min_corner, I>(g); }
+    static inline type max(Geometry const& g) { return geometry::get<max_corner, I>(g); }
+};
+
+// the strict weak ordering of the centers, see kd_spread_coord
+template <std::size_t I, typename Geometry>
+inline bool kd_center_less(Geometry const& l, Geometry const& r)
+{
+    return kd_spread_coord<Geometry, I>::apply(l) < kd_spread_coord<Geometry, I>::apply(r);
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_sort_extents_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+    typedef kd_extent_coord<Point, I> extent_coord;
+    typedef typename extent_coord::type coord_type;
+
+    template <typename It>
+    static inline void apply(It first, It last, std::size_t node, kd_split_extents<coord_type> & extents)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        std::size_t rsize = size - lsize - 1;
+
+        It nth = first + lsize;
+        std::nth_element(first, nth, last, kd_center_less<I, Point>);
+
+        // the left subrange is never empty, the bound of the empty right one is not used
+        coord_type left_max = extent_coord::max(*first);
+        for ( It it = first + 1 ; it != nth ; ++it )
+        {
+            coord_type const c = extent_coord::max(*it);
+            if ( left_max < c )
+                left_max = c;
+        }
+        coord_type right_min = rsize > 0 ? extent_coord::min(*(nth + 1)) : extent_coord::min(*nth);
+        for ( It it = nth + 1 ; it != last ; ++it )
+        {
+            coord_type const c = extent_coord::min(*it);
+            if ( c < right_min )
+                right_min = c;
+        }
+        extents.set(node, left_max, right_min);
+
+        if ( lsize > ValuesMin )
+        {
+            kd_sort_extents_impl<Point, next_dimension, ValuesMin>::apply(first, nth, 2 * node, extents);
+        }
+        if ( rsize > ValuesMin )
+        {
+            kd_sort_extents_impl<Point, next_dimension, ValuesMin>::apply(nth+1, last, 2 * node + 1, extents);
+        }
+    }
+};
+
+template <std::size_t ValuesMin, typename RandomIt, typename Coord>
+inline void kd_sort_extents(RandomIt first, RandomIt last, kd_split_extents<Coord> & extents)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    BOOST_MPL_ASSERT_MSG((boost::is_same<Coord, typename coordinate_type<point_type>::type>::value),
+                         INVALID_COORDINATE_TYPE, (point_type));
+
+    std::size_t const size = static_cast<std::size_t>(std::distance(first, last));
+    extents.reset(kd_split_axes_nodes_count<ValuesMin>(size));
+    if ( size > 1 )
+    {
+        kd_sort_extents_impl<point_type, 0, ValuesMin>::apply(first, last, 1, extents);
+    }
+}
+
+template <typename RandomIt, typename Coord>
+inline void kd_sort_extents(RandomIt first, RandomIt last, kd_split_extents<Coord> & extents)
+{
+    kd_sort_extents<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, extents);
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_binary_search_extents_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+    typedef kd_extent_coord<Point, I> extent_coord;
+    typedef typename extent_coord::type coord_type;
+
+    template <typename It, typename Value>
+    static inline bool per_branch(It first, It last, std::size_t node, kd_split_extents<coord_type> const& extents, Value const& value)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size > ValuesMin )
+        {
+            return kd_binary_search_extents_impl<Point, next_dimension, ValuesMin>::apply(first, last, node, extents, value);
+        }
+        else
+        {
+            return kd_leaf_binary_search<It, Value>::apply(first, last, value);
+        }
+    }
+
+    template <typename It, typename Value>
+    static inline bool apply(It first, It last, std::size_t node, kd_split_extents<coord_type> const& extents, Value const& value)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+
+        It nth = first + lsize;
+
+        if ( geometry::equals(*nth, value) )
+            return true;
+
+        // the value may be in the left subrange only if it isn't crossing its bound
+        return ( ! (extents.left_max(node) < extent_coord::max(value))
+              && per_branch(first, nth, 2 * node, extents, value) )
+            || ( ! (extent_coord::min(value) < extents.right_min(node))
+              && per_branch(nth+1, last, 2 * node + 1, extents, value) );
+    }
+};
+
+// the extents must be the ones created by kd_sort_extents() for this range
+template <std::size_t ValuesMin, typename RandomIt, typename Coord, typename Value>
+inline bool kd_binary_search_extents(RandomIt first, RandomIt last, kd_split_extents<Coord> const& extents, Value const& value)
+{
+    if ( std::distance(first, last) < 1 )
+        return false;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    return kd_binary_search_extents_impl<point_type, 0, ValuesMin>::apply(first, last, 1, extents, value);
+}
+
+template <typename RandomIt, typename Coord, typename Value>
+inline bool kd_binary_search_extents(RandomIt first, RandomIt last, kd_split_extents<Coord> const& extents, Value const& value)
+{
+    return kd_binary_search_extents<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, extents, value);
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_nearest_extents_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+    typedef kd_extent_coord<Point, I> extent_coord;
+    typedef typename extent_coord::type coord_type;
+
+    template <typename It, typename Value, typename CDist>
+    static inline bool per_branch(It first, It last, std::size_t node, kd_split_extents<coord_type> const& extents,
+                                  Value const& point, It & out_it, CDist & smallest_cdist)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size > ValuesMin )
+        {
+            if ( kd_nearest_extents_impl<Point, next_dimension, ValuesMin>::apply(first, last, node, extents, point, out_it, smallest_cdist) )
+                return true;
+        }
+        else
+        {
+            if ( kd_leaf_nearest<It, Value>::apply(first, last, point, out_it, smallest_cdist) )
+                return true;
+        }
+
+        return false;
+    }
+
+    template <typename It, typename Value, typename CDist>
+    static inline bool apply(It first, It last, std::size_t node, kd_split_extents<coord_type> const& extents,
+                             Value const& point, It & out_it, CDist & smallest_cdist)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        It nth = first + lsize;
+
+        if ( kd_nearest_impl<Point>::update_one(nth, point, out_it, smallest_cdist) )
+            return true;
+
+        // the comparable distances to the bounds of the subranges along the axis I
+        CDist const coord = geometry::get<I>(point);
+        CDist const left_max = extents.left_max(node);
+        CDist const right_min = extents.right_min(node);
+        CDist left_cdist = left_max < coord ? coord - left_max : 0;
+        CDist right_cdist = coord < right_min ? right_min - coord : 0;
+        left_cdist *= left_cdist;
+        right_cdist *= right_cdist;
+
+        if ( left_cdist <= right_cdist )
+        {
+            if ( left_cdist < smallest_cdist
+              && per_branch(first, nth, 2 * node, extents, point, out_it, smallest_cdist) )
+                return true;
+
+            return right_cdist < smallest_cdist
+                && per_branch(nth+1, last, 2 * node + 1, extents, point, out_it, smallest_cdist);
+        }
+        else
+        {
+            if ( right_cdist < smallest_cdist
+              && per_branch(nth+1, last, 2 * node + 1, extents, point, out_it, smallest_cdist) )
+                return true;
+
+            return left_cdist < smallest_cdist
+                && per_branch(first, nth, 2 * node, extents, point, out_it, smallest_cdist);
+        }
+    }
+};
+
+// the extents must be the ones created by kd_sort_extents() for this range
+template <std::size_t ValuesMin, typename RandomIt, typename Coord, typename Point, typename Value>
+inline bool kd_nearest_extents(RandomIt first, RandomIt last, kd_split_extents<Coord> const& extents, Point const& point, Value & result)
+{
+    if ( std::distance(first, last) < 1 )
+        return false;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+
+    typename geometry::default_comparable_distance_result<point_type>::type
+        cdist = geometry::comparable_distance(point, *first);
+    RandomIt out_it = first;
+
+    kd_nearest_extents_impl<point_type, 0, ValuesMin>::apply(first, last, 1, extents, point, out_it, cdist);
+
+    result = *out_it;
+
+    return true;
+}
+
+template <typename RandomIt, typename Coord, typename Point, typename Value>
+inline bool kd_nearest_extents(RandomIt first, RandomIt last, kd_split_extents<Coord> const& extents, Point const& point, Value & result)
+{
+    return kd_nearest_extents<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, extents, point, result);
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_query_intersects_extents_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+    typedef kd_extent_coord<Point, I> extent_coord;
+    typedef typename extent_coord::type coord_type;
+
+    template <typename It, typename Box, typename OutIt>
+    static inline void update_one(It it, Box const& box, OutIt & out_it, std::size_t & count)
+    {
+        if ( geometry::intersects(*it, box) )
+        {
+            *out_it = *it;
+            ++out_it;
+            ++count;
+        }
+    }
+
+    template <typename It, typename Box, typename OutIt>
+    static inline void per_branch(It first, It last, std::size_t node, kd_split_extents<coord_type> const& extents,
+                                  Box const& box, OutIt & out_it, std::size_t & count)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size > ValuesMin )
+        {
+            kd_query_intersects_extents_impl<Point, next_dimension, ValuesMin>::apply(first, last, node, extents, box, out_it, count);
+        }
+        else
+        {
+            for ( ; first != last ; ++first )
+            {
+                update_one(first, box, out_it, count);
+            }
+        }
+    }
+
+    template <typename It, typename Box, typename OutIt>
+    static inline void apply(It first, It last, std::size_t node, kd_split_extents<coord_type> const& extents,
+                             Box const& box, OutIt & out_it, std::size_t & count)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        It nth = first + lsize;
+
+        update_one(nth, box, out_it, count);
+
+        if ( ! (extents.left_max(node) < geometry::get<min_corner, I>(box)) )
+        {
+            per_branch(first, nth, 2 * node, extents, box, out_it, count);
+        }
+        if ( ! (geometry::get<max_corner, I>(box) < extents.right_min(node)) )
+        {
+            per_branch(nth+1, last, 2 * node + 1, extents, box, out_it, count);
+        }
+    }
+};
+
+// writes the values intersecting the box, returns the number of values written
+// the extents must be the ones created by kd_sort_extents() for this range
+template <std::size_t ValuesMin, typename RandomIt, typename Coord, typename Box, typename OutIt>
+inline std::size_t kd_query_intersects_extents(RandomIt first, RandomIt last, kd_split_extents<Coord> const& extents, Box const& box, OutIt out_it)
+{
+    if ( std::distance(first, last) < 1 )
+        return 0;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+
+    std::size_t count = 0;
+    kd_query_intersects_extents_impl<point_type, 0, ValuesMin>::apply(first, last, 1, extents, box, out_it, count);
+
+    return count;
+}
+
+template <typename RandomIt, typename Coord, typename Box, typename OutIt>
+inline std::size_t kd_query_intersects_extents(RandomIt first, RandomIt last, kd_split_extents<Coord> const& extents, Box const& box, OutIt out_it)
+{
+    return kd_query_intersects_extents<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, extents, box, out_it);
+}
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_EXTENTS_HPP
@@ -0,0 +1,268 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_INDEXES_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_INDEXES_HPP
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/cstdint.hpp>
+#include <boost/type_traits/remove_const.hpp>
+#include <boost/type_traits/remove_reference.hpp>
+
+#include <boost/geometry/index/indexable.hpp>
+
+#include "kd_sort.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// The Point or Box of a value together with the id of this value, usually
+// its position in the original range. It is adapted to the concept of its
+// Indexable so the range of kd_indexed may be sorted with kd_sort() and passed
+// to all of the queries instead of the range of heavy values, e.g.
+//   std::vector<kd_indexed<P> > indexed(values.size());
+//   kd_sort_indexed(values.begin(), values.end(), indexed.begin());
+//   kd_indexed<P> r;
+//   kd_nearest(indexed.begin(), indexed.end(), point, r);
+//   values[r.id] ...
+template <typename Indexable, typename Id = boost::uint32_t>
+struct kd_indexed
+{
+    typedef Indexable indexable_type;
+    typedef Id id_type;
+
+    kd_indexed()
+        : indexable(), id()
+    {}
+
+    kd_indexed(Indexable const& i, Id const& id_)
+        : indexable(i), id(id_)
+    {}
+
+    Indexable indexable;
+    Id id;
+};
+
+// ---------------------------------------------------------------------- //
+
+template <std::size_t I, typename PointIt,
+          typename IndexableGetter = index::indexable<typename boost::iterator_value<PointIt>::type> >
+struct kd_indirect_less
+{
+    explicit kd_indirect_less(PointIt first, IndexableGetter const& getter = IndexableGetter())
+        : m_first(first), m_getter(getter)
+    {}
+
+    inline bool operator()(std::size_t l, std::size_t r) const
+    {
+        return kd_less<I>(m_getter(*(m_first + l)), m_getter(*(m_first + r)));
+    }
+
+    PointIt m_first;
+    IndexableGetter m_getter;
+};
+
+// The same median recursion as kd_sort_impl but the indexes of the points
+// are sorted instead of the points. Consecutive indexes refer to the points
+// close to each other.
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_sort_indexes_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename PointIt, typename It>
+    static inline void apply(PointIt points, It first, It last)
+    {
+        apply(points, first, last, index::indexable<typename boost::iterator_value<PointIt>::type>());
+    }
+
+    template <typename PointIt, typename It, typename IndexableGetter>
+    static inline void apply(PointIt points, It first, It last, IndexableGetter const& getter)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        std::size_t rsize = size - lsize - 1;
+
+        It nth = first + lsize;
+        std::nth_element(first, nth, last, kd_indirect_less<I, PointIt, IndexableGetter>(points, getter));
+
+        if ( lsize > ValuesMin )
+        {
+            kd_sort_indexes_impl<Point, next_dimension, ValuesMin>::apply(points, first, nth, getter);
+        }
+        if ( rsize > ValuesMin )
+        {
+            kd_sort_indexes_impl<Point, next_dimension, ValuesMin>::apply(points, nth+1, last, getter);
+        }
+    }
+};
+
+// Fills the range of distance(first, last) indexes with the permutation of
+// the values in the kd_sort() order, the values are not modified. The queries
+// may traverse the values through this permutation, e.g. with
+// boost::permutation_iterator, or the indexes may be used to reorder them.
+template <std::size_t ValuesMin, typename RandomIt, typename IndexIt, typename IndexableGetter>
+inline void kd_sort_indexes(RandomIt first, RandomIt last, IndexIt indexes_first, IndexableGetter const& getter)
+{
+    typedef typename boost::remove_const<
+        typename boost::remove_reference<typename IndexableGetter::result_type>::type
+    >::type indexable_type;
+    typedef typename boost::iterator_value<IndexIt>::type index_type;
+
+    std::size_t const size = static_cast<std::size_t>(std::distance(first, last));
+    // the positions must be representable by the indexes
+    BOOST_ASSERT(size < 1 || size - 1 <= static_cast<std::size_t>((std::numeric_limits<index_type>::max)()));
+    for ( std::size_t i = 0 ; i < size ; ++i )
+        *(indexes_first + i) = static_cast<index_type>(i);
+
+    if ( size > 1 )
+    {
+        kd_sort_indexes_impl<indexable_type, 0, ValuesMin>::apply(first, indexes_first, indexes_first + size, getter);
+    }
+}
+
+template <typename RandomIt, typename IndexIt, typename IndexableGetter>
+inline void kd_sort_indexes(RandomIt first, RandomIt last, IndexIt indexes_first, IndexableGetter const& getter)
+{
+    kd_sort_indexes<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, indexes_first, getter);
+}
+
+template <std::size_t ValuesMin, typename RandomIt, typename IndexIt>
+inline void kd_sort_indexes(RandomIt first, RandomIt last, IndexIt indexes_first)
+{
+    kd_sort_indexes<ValuesMin>(first, last, indexes_first, index::indexable<typename boost::iterator_value<RandomIt>::type>());
+}
+
+template <typename RandomIt, typename IndexIt>
+inline void kd_sort_indexes(RandomIt first, RandomIt last, IndexIt indexes_first)
+{
+    kd_sort_indexes<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, indexes_first);
+}
+
+// ---------------------------------------------------------------------- //
+
+// Fills the range of distance(first, last) kd_indexed elements with the Indexables
+// of the values and their positions and kd_sort()s it, the values are not modified.
+// Only the compact elements are moved during the partitioning so the bandwidth
+// needed by the build falls with the size of the values.
+template <std::size_t ValuesMin, typename RandomIt, typename IndexedIt, typename IndexableGetter>
+inline void kd_sort_indexed(RandomIt first, RandomIt last, IndexedIt indexed_first, IndexableGetter const& getter)
+{
+    typedef typename boost::iterator_value<IndexedIt>::type indexed_type;
+    typedef typename indexed_type::id_type id_type;
+
+    // the positions must be representable by the ids
+    BOOST_ASSERT(first == last
+              || static_cast<std::size_t>(std::distance(first, last)) - 1
+                     <= static_cast<std::size_t>((std::numeric_limits<id_type>::max)()));
+
+    IndexedIt indexed_it = indexed_first;
+    for ( std::size_t i = 0 ; first != last ; ++first, ++indexed_it, ++i )
+    {
+        *indexed_it = indexed_type(getter(*first), static_cast<id_type>(i));
+    }
+
+    kd_sort<ValuesMin>(indexed_first, indexed_it);
+}
+
+template <typename RandomIt, typename IndexedIt, typename IndexableGetter>
+inline void kd_sort_indexed(RandomIt first, RandomIt last, IndexedIt indexed_first, IndexableGetter const& getter)
+{
+    kd_sort_indexed<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, indexed_first, getter);
+}
+
+template <std::size_t ValuesMin, typename RandomIt, typename IndexedIt>
+inline void kd_sort_indexed(RandomIt first, RandomIt last, IndexedIt indexed_first)
+{
+    kd_sort_indexed<ValuesMin>(first, last, indexed_first, index::indexable<typename boost::iterator_value<RandomIt>::type>());
+}
+
+template <typename RandomIt, typename IndexedIt>
+inline void kd_sort_indexed(RandomIt first, RandomIt last, IndexedIt indexed_first)
+{
+    kd_sort_indexed<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, indexed_first);
+}
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+// ---------------------------------------------------------------------- //
+
+// kd_indexed is a Point or a Box, the same as its Indexable
+
+namespace boost { namespace geometry { namespace traits {
+
+template <typename Indexable, typename Id>
+struct tag< index::detail::kd_indexed<Indexable, Id> >
+{
+    typedef typename geometry::tag<Indexable>::type type;
+};
+
+template <typename Indexable, typename Id>
+struct coordinate_type< index::detail::kd_indexed<Indexable, Id> >
+{
+    typedef typename geometry::coordinate_type<Indexable>::type type;
+};
+
+template <typename Indexable, typename Id>
+struct coordinate_system< index::detail::kd_indexed<Indexable, Id> >
+{
+    typedef typename geometry::coordinate_system<Indexable>::type type;
+};
+
+template <typename Indexable, typename Id>
+struct dimension< index::detail::kd_indexed<Indexable, Id> >
+    : geometry::dimension<Indexable>
+{};
+
+template <typename Indexable, typename Id>
+struct point_type< index::detail::kd_indexed<Indexable, Id> >
+{
+    typedef typename geometry::point_type<Indexable>::type type;
+};
+
+// used if the Indexable is a Point
+template <typename Indexable, typename Id, std::size_t D>
+struct access< index::detail::kd_indexed<Indexable, Id>, D >
+{
+    typedef typename geometry::coordinate_type<Indexable>::type coordinate_type;
+
+    static inline coordinate_type get(index::detail::kd_indexed<Indexable, Id> const& i)
+    {
+        return geometry::get<D>(i.indexable);
+    }
+
+    static inline void set(index::detail::kd_indexed<Indexable, Id> & i, coordinate_type const& value)
+    {
+        geometry::set<D>(i.indexable, value);
+    }
+};
+
+// used if the Indexable is a Box
+template <typename Indexable, typename Id, std::size_t Index, std::size_t D>
+struct indexed_access< index::detail::kd_indexed<Indexable, Id>, Index, D >
+{
+    typedef typename geometry::coordinate_type<Indexable>::type coordinate_type;
+
+    static inline coordinate_type get(index::detail::kd_indexed<Indexable, Id> const& i)
+    {
+        return geometry::get<Index, D>(i.indexable);
+    }
+
+    static inline void set(index::detail::kd_indexed<Indexable, Id> & i, coordinate_type const& value)
+    {
+        geometry::set<Index, D>(i.indexable, value);
+    }
+};
+
+}}} // namespace boost::geometry::traits
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_INDEXES_HPP
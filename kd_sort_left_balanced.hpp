@@ -8,8 +8,22 @@
 #define BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_LEFT_BALANCED_HPP
 
 #include <algorithm>
+#include <limits>
 #include "kd_less.hpp"
 #include "kd_is_further.hpp"
+#include "kd_nearest_approximation.hpp"
+#include "kd_nearest_k_result.hpp"
+#include "kd_traversal_stats.hpp"
+#include "kd_within_distance_result.hpp"
+
+#if defined(__GNUC__)
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_PREFETCH(ADDR) __builtin_prefetch(ADDR)
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <xmmintrin.h>
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_PREFETCH(ADDR) _mm_prefetch(reinterpret_cast<char const*>(ADDR), _MM_HINT_T0)
+#else
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_PREFETCH(ADDR) ((void)0)
+#endif
 
 namespace boost { namespace geometry { namespace index { namespace detail {
 
@@ -100,9 +114,127 @@ inline void kd_sort_left_balanced(RandomIt first, RandomIt last)
     }
 }
 
+// the same as above but the buffer of at least distance(first, last) elements
+// provided by the caller is used instead of the temporary copy
+template <typename RandomIt, typename BufferIt>
+inline void kd_sort_left_balanced(RandomIt first, RandomIt last, BufferIt buffer_first)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typename boost::iterator_difference<RandomIt>::type
+        count = std::distance(first, last);
+    if ( count > 1 )
+    {
+        BufferIt buffer_last = std::copy(first, last, buffer_first);
+        kd_sort_left_balanced_impl<point_type>
+            ::apply(buffer_first, buffer_last, 1, count, 1, first);
+    }
+}
+
 // ---------------------------------------------------------------------- //
 
+// The in-place build is done in two steps. First the elements are partitioned
+// the same way as in kd_sort_left_balanced_impl but each median is left in place,
+// so the range contains the in-order traversal of the left-balanced tree.
+// Then the elements are moved to their positions in the heap by following
+// the cycles of the permutation. Only 1 bit per element is needed to mark
+// the elements which were already moved.
 template <typename Point, std::size_t I = 0>
+struct kd_sort_left_balanced_in_place_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    // the range of elements is [start, stop] like in kd_sort_left_balanced_impl
+    template <typename It>
+    static inline void apply(It first, It last, std::size_t start, std::size_t stop)
+    {
+        std::size_t median = kd_sort_left_balanced_impl<Point>::calc_median(start, stop);
+        It median_it = first + (median - start);
+
+        std::nth_element(first, median_it, last, kd_less<I, Point, Point>);
+
+        if ( start + 1 < median )
+        {
+            kd_sort_left_balanced_in_place_impl<Point, next_dimension>
+                ::apply(first, median_it, start, median - 1);
+        }
+
+        if ( median + 1 < stop )
+        {
+            kd_sort_left_balanced_in_place_impl<Point, next_dimension>
+                ::apply(median_it + 1, last, median + 1, stop);
+        }
+    }
+
+    static inline std::size_t depth(std::size_t index)
+    {
+        std::size_t result = 0;
+        for ( ; index > 1 ; index /= 2 )
+            ++result;
+        return result;
+    }
+
+    // The position [1, count] in the in-order traversal of the node at index.
+    // In the perfect tree of height levels the position of the node at depth d
+    // is (2 * (index - 2^d) + 1) * 2^(height - 1 - d). The nodes of the last level
+    // are at the odd positions and only the first last_count of them exist.
+    static inline std::size_t in_order_position(std::size_t index, std::size_t height, std::size_t last_count)
+    {
+        std::size_t const d = depth(index);
+        std::size_t const position = (2 * (index - (std::size_t(1) << d)) + 1) << (height - 1 - d);
+        std::size_t const last_before = position / 2;
+        return last_before > last_count ?
+               position - (last_before - last_count) :
+               position;
+    }
+
+    template <typename It>
+    static inline void permute(It first, std::size_t count)
+    {
+        std::size_t const height = depth(count) + 1;
+        std::size_t const last_count = count - ((std::size_t(1) << (height - 1)) - 1);
+
+        std::vector<bool> moved(count, false);
+
+        for ( std::size_t index = 1 ; index <= count ; ++index )
+        {
+            if ( moved[index - 1] )
+                continue;
+
+            Point temp = *(first + (index - 1));
+            std::size_t current = index;
+            for (;;)
+            {
+                moved[current - 1] = true;
+                std::size_t const source = in_order_position(current, height, last_count);
+                if ( source == index )
+                {
+                    *(first + (current - 1)) = temp;
+                    break;
+                }
+                *(first + (current - 1)) = *(first + (source - 1));
+                current = source;
+            }
+        }
+    }
+};
+
+// the same layout as the one created by kd_sort_left_balanced()
+// without the temporary copy of the elements
+template <typename RandomIt>
+inline void kd_sort_left_balanced_in_place(RandomIt first, RandomIt last)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    std::size_t const count = static_cast<std::size_t>(std::distance(first, last));
+    if ( count > 1 )
+    {
+        kd_sort_left_balanced_in_place_impl<point_type>::apply(first, last, 1, count);
+        kd_sort_left_balanced_in_place_impl<point_type>::permute(first, count);
+    }
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0, typename Stats = kd_default_stats>
 struct kd_nearest_left_balanced_impl
 {
     static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
@@ -110,6 +242,7 @@ struct kd_nearest_left_balanced_impl
     template <typename It, typename Value, typename CDist>
     static inline bool update_one(It it, Value const& point, It & out_it, CDist & smallest_cdist)
     {
+        Stats::distance();
         CDist cdist = geometry::comparable_distance(point, *it);
         if ( cdist < smallest_cdist )
         {
@@ -120,14 +253,15 @@ struct kd_nearest_left_balanced_impl
         return math::equals(smallest_cdist, CDist(0));
     }
 
-    template <typename It, typename Value, typename CDist>
+    template <typename It, typename Value, typename CDist, typename Bound>
     static inline bool per_branch(It first,
                                   std::size_t index, std::size_t max_index,
                                   Value const& point,
-                                  It & out_it, CDist & smallest_cdist)
+                                  It & out_it, CDist & smallest_cdist,
+                                  Bound & bound)
     {
-        return kd_nearest_left_balanced_impl<Point, next_dimension>
-                    ::apply(first, index, max_index, point, out_it, smallest_cdist);
+        return kd_nearest_left_balanced_impl<Point, next_dimension, Stats>
+                    ::apply(first, index, max_index, point, out_it, smallest_cdist, bound);
     }
 
     template <typename It, typename Value, typename CDist>
@@ -136,9 +270,24 @@ struct kd_nearest_left_balanced_impl
                              Value const& point,
                              It & out_it, CDist & smallest_cdist)
     {
+        kd_nearest_exact bound;
+        return apply(first, index, max_index, point, out_it, smallest_cdist, bound);
+    }
+
+    // the Bound is kd_nearest_exact or kd_nearest_approximation
+    template <typename It, typename Value, typename CDist, typename Bound>
+    static inline bool apply(It first,
+                             std::size_t index, std::size_t const max_index,
+                             Value const& point,
+                             It & out_it, CDist & smallest_cdist,
+                             Bound & bound)
+    {
+        typename Stats::scope scope;
+        Stats::node();
+
         It nth = first + index - 1;
 
-        if ( update_one(nth, point, out_it, smallest_cdist) )
+        if ( update_one(nth, point, out_it, smallest_cdist) || bound.visit() )
             return true;
 
         if ( kd_less<I>(point, *nth) )
@@ -147,33 +296,39 @@ struct kd_nearest_left_balanced_impl
             if ( next_index > max_index )
                 return false;
 
-            if ( per_branch(first, next_index, max_index, point, out_it, smallest_cdist) )
+            if ( per_branch(first, next_index, max_index, point, out_it, smallest_cdist, bound) )
                 return true;
 
             ++next_index;
             if ( next_index > max_index )
                 return false;
 
-            if ( kd_is_further<I>(point, *nth, smallest_cdist) )
+            if ( kd_is_further<I>(point, *nth, bound.bound(smallest_cdist)) )
+            {
+                Stats::prune();
                 return false;
+            }
 
-            return per_branch(first, 2 * index + 1, max_index, point, out_it, smallest_cdist);
+            return per_branch(first, 2 * index + 1, max_index, point, out_it, smallest_cdist, bound);
         }
         else if ( kd_less<I>(*nth, point) )
         {
             std::size_t next_index = 2 * index + 1;
             if ( next_index <= max_index )
-                if ( per_branch(first, 2 * index + 1, max_index, point, out_it, smallest_cdist) )
+                if ( per_branch(first, 2 * index + 1, max_index, point, out_it, smallest_cdist, bound) )
                     return true;
 
             --next_index;
             if ( next_index > max_index )
                 return false;
 
-            if ( kd_is_further<I>(*nth, point, smallest_cdist) )
+            if ( kd_is_further<I>(*nth, point, bound.bound(smallest_cdist)) )
+            {
+                Stats::prune();
                 return false;
+            }
 
-            return per_branch(first, 2 * index, max_index, point, out_it, smallest_cdist);
+            return per_branch(first, 2 * index, max_index, point, out_it, smallest_cdist, bound);
         }
         else
         {
@@ -181,14 +336,14 @@ struct kd_nearest_left_balanced_impl
             if ( next_index > max_index )
                 return false;
 
-            if ( per_branch(first, next_index, max_index, point, out_it, smallest_cdist) )
+            if ( per_branch(first, next_index, max_index, point, out_it, smallest_cdist, bound) )
                 return true;
 
             ++next_index;
             if ( next_index > max_index )
                 return false;
 
-            return per_branch(first, next_index, max_index, point, out_it, smallest_cdist);
+            return per_branch(first, next_index, max_index, point, out_it, smallest_cdist, bound);
         }
 
         return false;
@@ -212,7 +367,7 @@ inline bool kd_nearest_left_balanced(RandomIt first, RandomIt last, Point const&
         cdist = geometry::comparable_distance(point, *first);
     RandomIt out_it = first;
 
-    kd_nearest_left_balanced_impl<point_type>
+    kd_nearest_left_balanced_impl<point_type, 0, kd_default_stats>
         ::apply(first, 1, size, point, out_it, cdist);
 
     result = *out_it;
@@ -220,6 +375,491 @@ inline bool kd_nearest_left_balanced(RandomIt first, RandomIt last, Point const&
     return true;
 }
 
+// finds a value at most (1+epsilon) times further than the nearest one,
+// see kd_nearest_approximation
+template <typename RandomIt, typename Point, typename Value>
+inline bool kd_nearest_left_balanced(RandomIt first, RandomIt last, Point const& point, Value & result,
+                                     double epsilon, std::size_t max_visited = 0)
+{
+    typename boost::iterator_difference<RandomIt>::type
+        d = std::distance(first, last);
+
+    if ( d < 1 )
+        return false;
+
+    std::size_t size = static_cast<std::size_t>(d);
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typedef typename geometry::default_comparable_distance_result<point_type>::type cdist_type;
+
+    cdist_type cdist = geometry::comparable_distance(point, *first);
+    RandomIt out_it = first;
+    kd_nearest_approximation<cdist_type> approximation(epsilon, max_visited);
+
+    kd_nearest_left_balanced_impl<point_type, 0, kd_default_stats>
+        ::apply(first, 1, size, point, out_it, cdist, approximation);
+
+    result = *out_it;
+
+    return true;
+}
+
+// ---------------------------------------------------------------------- //
+
+// The same traversal as in kd_nearest_left_balanced_impl but without the recursion
+// and with the split axis known at runtime. The far children are kept on the stack
+// and checked with kd_is_further() when they're popped. The grandchildren of each
+// visited node are prefetched. The prefetching doesn't make up for the runtime axis
+// dispatch, it's slower than the recursive version unless the range is far larger
+// than the cache.
+template <typename Point, typename Stats = kd_default_stats>
+struct kd_nearest_left_balanced_iterative_impl
+{
+    static const std::size_t dimension = geometry::dimension<Point>::value;
+
+    // the height of the tree is never greater than the number of bits of the index
+    static const std::size_t stack_capacity = std::numeric_limits<std::size_t>::digits;
+
+    enum side_type { no_pruning, point_less, point_greater };
+
+    struct stack_entry
+    {
+        std::size_t index;
+        std::size_t parent_axis;
+        std::size_t depth;
+        side_type side;
+    };
+
+    template <typename It>
+    static inline void prefetch_grandchildren(It first, std::size_t index, std::size_t max_index)
+    {
+        std::size_t const grandchild = 4 * index;
+        if ( grandchild <= max_index )
+        {
+            BOOST_GEOMETRY_INDEX_DETAIL_KD_PREFETCH(&*(first + (grandchild - 1)));
+            BOOST_GEOMETRY_INDEX_DETAIL_KD_PREFETCH(&*(first + ((std::min)(grandchild + 3, max_index) - 1)));
+        }
+    }
+
+    template <typename It, typename Value, typename CDist>
+    static inline void apply(It first,
+                             std::size_t const max_index,
+                             Value const& point,
+                             It & out_it, CDist & smallest_cdist)
+    {
+        typename Stats::scope scope;
+
+        stack_entry stack[stack_capacity];
+        std::size_t stack_size = 0;
+
+        std::size_t index = 1;
+        std::size_t axis = 0;
+        std::size_t depth = 1;
+
+        for (;;)
+        {
+            // descend to the leaf closer to the point
+            for (;;)
+            {
+                It nth = first + index - 1;
+
+                Stats::node();
+                Stats::depth(depth);
+
+                prefetch_grandchildren(first, index, max_index);
+
+                if ( kd_nearest_left_balanced_impl<Point, 0, Stats>::update_one(nth, point, out_it, smallest_cdist) )
+                    return;
+
+                std::size_t const left = 2 * index;
+                if ( left > max_index )
+                    break;
+
+                std::size_t near_index = left;
+                stack_entry far = { left + 1, axis, depth + 1, no_pruning };
+
+                if ( kd_less_by_axis(axis, point, *nth) )
+                {
+                    far.side = point_less;
+                }
+                else if ( kd_less_by_axis(axis, *nth, point) )
+                {
+                    near_index = left + 1;
+                    far.index = left;
+                    far.side = point_greater;
+                }
+
+                if ( far.index <= max_index )
+                {
+                    BOOST_ASSERT(stack_size < stack_capacity);
+                    stack[stack_size++] = far;
+                }
+
+                if ( near_index > max_index )
+                    break;
+
+                index = near_index;
+                axis = (axis + 1) % dimension;
+                ++depth;
+            }
+
+            // pop the closest far child which can't be pruned
+            for (;;)
+            {
+                if ( stack_size == 0 )
+                    return;
+
+                stack_entry const& e = stack[--stack_size];
+                It parent = first + (e.index / 2 - 1);
+
+                if ( ( e.side == point_less
+                    && kd_is_further_by_axis(e.parent_axis, point, *parent, smallest_cdist) )
+                  || ( e.side == point_greater
+                    && kd_is_further_by_axis(e.parent_axis, *parent, point, smallest_cdist) ) )
+                {
+                    Stats::prune();
+                    continue;
+                }
+
+                index = e.index;
+                axis = (e.parent_axis + 1) % dimension;
+                depth = e.depth;
+                break;
+            }
+        }
+    }
+};
+
+template <typename RandomIt, typename Point, typename Value>
+inline bool kd_nearest_left_balanced_iterative(RandomIt first, RandomIt last, Point const& point, Value & result)
+{
+    typename boost::iterator_difference<RandomIt>::type
+        d = std::distance(first, last);
+
+    if ( d < 1 )
+        return false;
+
+    std::size_t size = static_cast<std::size_t>(d);
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+
+    typename geometry::default_comparable_distance_result<point_type>::type
+        cdist = geometry::comparable_distance(point, *first);
+    RandomIt out_it = first;
+
+    kd_nearest_left_balanced_iterative_impl<point_type>
+        ::apply(first, size, point, out_it, cdist);
+
+    result = *out_it;
+
+    return true;
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0>
+struct kd_nearest_k_left_balanced_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It, typename Value, typename Result>
+    static inline bool update_one(It it, Value const& point, Result & result)
+    {
+        typename Result::distance_type cdist = geometry::comparable_distance(point, *it);
+        return result.update(it, cdist);
+    }
+
+    template <typename It, typename Value, typename Result>
+    static inline bool per_branch(It first,
+                                  std::size_t index, std::size_t max_index,
+                                  Value const& point,
+                                  Result & result)
+    {
+        return kd_nearest_k_left_balanced_impl<Point, next_dimension>
+                    ::apply(first, index, max_index, point, result);
+    }
+
+    template <typename It, typename Value, typename Result>
+    static inline bool apply(It first,
+                             std::size_t index, std::size_t const max_index,
+                             Value const& point,
+                             Result & result)
+    {
+        It nth = first + index - 1;
+
+        if ( update_one(nth, point, result) )
+            return true;
+
+        if ( kd_less<I>(point, *nth) )
+        {
+            std::size_t next_index = 2 * index;
+            if ( next_index > max_index )
+                return false;
+
+            if ( per_branch(first, next_index, max_index, point, result) )
+                return true;
+
+            ++next_index;
+            if ( next_index > max_index )
+                return false;
+
+            if ( result.is_full() && kd_is_further<I>(point, *nth, result.greatest_cdist()) )
+                return false;
+
+            return per_branch(first, next_index, max_index, point, result);
+        }
+        else if ( kd_less<I>(*nth, point) )
+        {
+            std::size_t next_index = 2 * index + 1;
+            if ( next_index <= max_index )
+                if ( per_branch(first, next_index, max_index, point, result) )
+                    return true;
+
+            --next_index;
+            if ( next_index > max_index )
+                return false;
+
+            if ( result.is_full() && kd_is_further<I>(*nth, point, result.greatest_cdist()) )
+                return false;
+
+            return per_branch(first, next_index, max_index, point, result);
+        }
+        else
+        {
+            std::size_t next_index = 2 * index;
+            if ( next_index > max_index )
+                return false;
+
+            if ( per_branch(first, next_index, max_index, point, result) )
+                return true;
+
+            ++next_index;
+            if ( next_index > max_index )
+                return false;
+
+            return per_branch(first, next_index, max_index, point, result);
+        }
+
+        return false;
+    }
+};
+
+// writes at most k closest values sorted by distance, returns the number of values written
+template <typename RandomIt, typename Point, typename OutIt>
+inline std::size_t kd_nearest_k_left_balanced(RandomIt first, RandomIt last, Point const& point, std::size_t k, OutIt out_it)
+{
+    typename boost::iterator_difference<RandomIt>::type
+        d = std::distance(first, last);
+
+    if ( d < 1 || k < 1 )
+        return 0;
+
+    std::size_t size = static_cast<std::size_t>(d);
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typedef typename geometry::default_comparable_distance_result<point_type>::type cdist_type;
+
+    kd_nearest_k_result<RandomIt, cdist_type> result(k, size);
+
+    kd_nearest_k_left_balanced_impl<point_type>
+        ::apply(first, 1, size, point, result);
+
+    result.finish(out_it);
+
+    return result.size();
+}
+
+// ---------------------------------------------------------------------- //
+
+// Only the Points are supported, see kd_query_within_impl
+template <typename Point, std::size_t I = 0>
+struct kd_query_within_left_balanced_impl
+{
+    BOOST_MPL_ASSERT_MSG((boost::is_same<typename geometry::tag<Point>::type, point_tag>::value),
+                         NOT_IMPLEMENTED_FOR_THIS_VALUE_TYPE, (Point));
+
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It, typename Box, typename OutIt>
+    static inline void per_branch(It first,
+                                  std::size_t index, std::size_t max_index,
+                                  Box const& box,
+                                  OutIt & out_it, std::size_t & count)
+    {
+        kd_query_within_left_balanced_impl<Point, next_dimension>
+            ::apply(first, index, max_index, box, out_it, count);
+    }
+
+    template <typename It, typename Box, typename OutIt>
+    static inline void apply(It first,
+                             std::size_t index, std::size_t const max_index,
+                             Box const& box,
+                             OutIt & out_it, std::size_t & count)
+    {
+        It nth = first + index - 1;
+
+        if ( geometry::covered_by(*nth, box) )
+        {
+            *out_it = *nth;
+            ++out_it;
+            ++count;
+        }
+
+        std::size_t next_index = 2 * index;
+        if ( next_index > max_index )
+            return;
+
+        if ( ! kd_less<I>(*nth, box) )
+        {
+            per_branch(first, next_index, max_index, box, out_it, count);
+        }
+
+        ++next_index;
+        if ( next_index > max_index )
+            return;
+
+        if ( ! kd_less<I>(box, *nth) )
+        {
+            per_branch(first, next_index, max_index, box, out_it, count);
+        }
+    }
+};
+
+// writes the values covered by the box, returns the number of values written
+template <typename RandomIt, typename Box, typename OutIt>
+inline std::size_t kd_query_within_left_balanced(RandomIt first, RandomIt last, Box const& box, OutIt out_it)
+{
+    typename boost::iterator_difference<RandomIt>::type
+        d = std::distance(first, last);
+
+    if ( d < 1 )
+        return 0;
+
+    std::size_t size = static_cast<std::size_t>(d);
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+
+    std::size_t count = 0;
+    kd_query_within_left_balanced_impl<point_type>
+        ::apply(first, 1, size, box, out_it, count);
+
+    return count;
+}
+
+// ---------------------------------------------------------------------- //
+
+// Only the Points are supported, see kd_query_within_impl
+template <typename Point, std::size_t I = 0>
+struct kd_within_distance_left_balanced_impl
+{
+    BOOST_MPL_ASSERT_MSG((boost::is_same<typename geometry::tag<Point>::type, point_tag>::value),
+                         NOT_IMPLEMENTED_FOR_THIS_VALUE_TYPE, (Point));
+
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It, typename Value, typename CDist, typename OutIt>
+    static inline void update_one(It it, Value const& point, CDist const& max_cdist, OutIt & out_it, std::size_t & count)
+    {
+        CDist cdist = geometry::comparable_distance(point, *it);
+        if ( ! (max_cdist < cdist) )
+        {
+            *out_it = std::make_pair(*it, cdist);
+            ++out_it;
+            ++count;
+        }
+    }
+
+    template <typename It, typename Value, typename CDist, typename OutIt>
+    static inline void per_branch(It first,
+                                  std::size_t index, std::size_t max_index,
+                                  Value const& point, CDist const& max_cdist,
+                                  OutIt & out_it, std::size_t & count)
+    {
+        kd_within_distance_left_balanced_impl<Point, next_dimension>
+            ::apply(first, index, max_index, point, max_cdist, out_it, count);
+    }
+
+    template <typename It, typename Value, typename CDist, typename OutIt>
+    static inline void apply(It first,
+                             std::size_t index, std::size_t const max_index,
+                             Value const& point, CDist const& max_cdist,
+                             OutIt & out_it, std::size_t & count)
+    {
+        It nth = first + index - 1;
+
+        update_one(nth, point, max_cdist, out_it, count);
+
+        std::size_t const left_index = 2 * index;
+        std::size_t const right_index = 2 * index + 1;
+        if ( left_index > max_index )
+            return;
+
+        if ( kd_less<I>(point, *nth) )
+        {
+            per_branch(first, left_index, max_index, point, max_cdist, out_it, count);
+
+            if ( right_index <= max_index && ! kd_is_further<I>(point, *nth, max_cdist) )
+                per_branch(first, right_index, max_index, point, max_cdist, out_it, count);
+        }
+        else if ( kd_less<I>(*nth, point) )
+        {
+            if ( right_index <= max_index )
+                per_branch(first, right_index, max_index, point, max_cdist, out_it, count);
+
+            if ( ! kd_is_further<I>(*nth, point, max_cdist) )
+                per_branch(first, left_index, max_index, point, max_cdist, out_it, count);
+        }
+        else
+        {
+            per_branch(first, left_index, max_index, point, max_cdist, out_it, count);
+
+            if ( right_index <= max_index )
+                per_branch(first, right_index, max_index, point, max_cdist, out_it, count);
+        }
+    }
+};
+
+// writes the (value, comparable distance) pairs of the values within the distance
+// from the point, returns the number of values written
+// the comparable distance is the squared distance, see kd_is_further()
+template <typename RandomIt, typename Point, typename Distance, typename OutIt>
+inline std::size_t kd_within_distance_left_balanced(RandomIt first, RandomIt last, Point const& point, Distance const& distance, OutIt out_it)
+{
+    typename boost::iterator_difference<RandomIt>::type
+        d = std::distance(first, last);
+
+    if ( d < 1 )
+        return 0;
+
+    std::size_t size = static_cast<std::size_t>(d);
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typedef typename geometry::default_comparable_distance_result<point_type>::type cdist_type;
+
+    cdist_type max_cdist = distance;
+    max_cdist *= max_cdist;
+
+    std::size_t count = 0;
+    kd_within_distance_left_balanced_impl<point_type>
+        ::apply(first, 1, size, point, max_cdist, out_it, count);
+
+    return count;
+}
+
+// the same as kd_within_distance_left_balanced() but the pairs are written sorted by distance
+template <typename RandomIt, typename Point, typename Distance, typename OutIt>
+inline std::size_t kd_within_distance_left_balanced_sorted(RandomIt first, RandomIt last, Point const& point, Distance const& distance, OutIt out_it)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typedef typename geometry::default_comparable_distance_result<point_type>::type cdist_type;
+
+    kd_within_distance_sorted_result<point_type, cdist_type> result;
+    std::size_t count = kd_within_distance_left_balanced(first, last, point, distance, result.inserter());
+    result.finish(out_it);
+
+    return count;
+}
+
 // ---------------------------------------------------------------------- //
 
 }}}} // namespace boost::geometry::index::detail
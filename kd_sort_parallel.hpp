@@ -0,0 +1,185 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_PARALLEL_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_PARALLEL_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "kd_sort.hpp"
+#include "kd_sort_left_balanced.hpp"
+#include "kd_task_pool.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// ranges containing at most this number of elements are sorted serially
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_PARALLEL_CUTOFF
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_PARALLEL_CUTOFF 16384
+#endif
+
+// ---------------------------------------------------------------------- //
+
+// The same median recursion as kd_sort_impl, the right subrange is pushed
+// to the pool and the left one is processed by the current worker.
+// Since the subranges are disjoint the result is identical to kd_sort().
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_sort_parallel_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It>
+    static inline void apply(It first, It last,
+                             std::size_t cutoff, kd_task_pool & pool,
+                             std::size_t worker)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size <= cutoff )
+        {
+            kd_sort_impl<Point, I, ValuesMin>::apply(first, last);
+            return;
+        }
+
+        std::size_t lsize = size / 2;
+        std::size_t rsize = size - lsize - 1;
+
+        It nth = first + lsize;
+        std::nth_element(first, nth, last, kd_less<I, Point, Point>);
+
+        if ( rsize > ValuesMin )
+        {
+            pool.push(worker, boost::bind(&kd_sort_parallel_impl<Point, next_dimension, ValuesMin>::template apply<It>,
+                                          nth+1, last, cutoff, boost::ref(pool), _1));
+        }
+        if ( lsize > ValuesMin )
+        {
+            kd_sort_parallel_impl<Point, next_dimension, ValuesMin>::apply(first, nth, cutoff, pool, worker);
+        }
+    }
+};
+
+template <std::size_t ValuesMin, typename RandomIt>
+inline void kd_sort_parallel(RandomIt first, RandomIt last, kd_task_pool & pool,
+                             std::size_t cutoff = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_PARALLEL_CUTOFF)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    if ( std::distance(first, last) > 1 )
+    {
+        kd_sort_parallel_impl<point_type, 0, ValuesMin>::apply(first, last, cutoff, pool, 0);
+        pool.wait();
+    }
+}
+
+template <typename RandomIt>
+inline void kd_sort_parallel(RandomIt first, RandomIt last, kd_task_pool & pool,
+                             std::size_t cutoff = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_PARALLEL_CUTOFF)
+{
+    kd_sort_parallel<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, pool, cutoff);
+}
+
+template <std::size_t ValuesMin, typename RandomIt>
+inline void kd_sort_parallel(RandomIt first, RandomIt last)
+{
+    kd_task_pool pool;
+    kd_sort_parallel<ValuesMin>(first, last, pool);
+}
+
+template <typename RandomIt>
+inline void kd_sort_parallel(RandomIt first, RandomIt last)
+{
+    kd_sort_parallel<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last);
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0>
+struct kd_sort_left_balanced_parallel_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It, typename OutIt>
+    static inline void apply(It first, It last,
+                             std::size_t start, std::size_t stop,
+                             std::size_t index, OutIt out_first,
+                             std::size_t cutoff, kd_task_pool & pool,
+                             std::size_t worker)
+    {
+        if ( stop - start + 1 <= cutoff )
+        {
+            kd_sort_left_balanced_impl<Point, I>::apply(first, last, start, stop, index, out_first);
+            return;
+        }
+
+        std::size_t median = kd_sort_left_balanced_impl<Point, I>::calc_median(start, stop);
+        It median_it = first + (median - start);
+
+        std::nth_element(first, median_it, last, kd_less<I, Point, Point>);
+
+        *(out_first + (index - 1)) = *median_it;
+
+        if ( median < stop )
+        {
+            std::size_t const new_start = median + 1;
+            if ( new_start < stop )
+            {
+                pool.push(worker, boost::bind(&kd_sort_left_balanced_parallel_impl<Point, next_dimension>::template apply<It, OutIt>,
+                                              median_it + 1, last, new_start, stop, 2 * index + 1, out_first,
+                                              cutoff, boost::ref(pool), _1));
+            }
+            else
+            {
+                *(out_first + (2 * index /*+ 1 - 1*/)) = *(last - 1);
+            }
+        }
+
+        if ( start < median )
+        {
+            std::size_t const new_stop = median - 1;
+            if ( start < new_stop )
+            {
+                kd_sort_left_balanced_parallel_impl<Point, next_dimension>
+                    ::apply(first, median_it, start, new_stop, 2 * index, out_first, cutoff, pool, worker);
+            }
+            else
+            {
+                *(out_first + (2 * index - 1)) = *first;
+            }
+        }
+    }
+};
+
+template <typename RandomIt>
+inline void kd_sort_left_balanced_parallel(RandomIt first, RandomIt last, kd_task_pool & pool,
+                                           std::size_t cutoff = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_PARALLEL_CUTOFF)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typename boost::iterator_difference<RandomIt>::type
+        count = std::distance(first, last);
+    if ( count > 1 )
+    {
+        std::vector<point_type> temp(first, last);
+        kd_sort_left_balanced_parallel_impl<point_type>
+            ::apply(temp.begin(), temp.end(), 1, count, 1, first, cutoff, pool, 0);
+        pool.wait();
+    }
+}
+
+template <typename RandomIt>
+inline void kd_sort_left_balanced_parallel(RandomIt first, RandomIt last)
+{
+    kd_task_pool pool;
+    kd_sort_left_balanced_parallel(first, last, pool);
+}
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_PARALLEL_HPP
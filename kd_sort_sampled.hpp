@@ -0,0 +1,163 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_SAMPLED_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_SAMPLED_HPP
+
+#include <algorithm>
+#include <cmath>
+
+#include "kd_sort.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// The selection of Floyd and Rivest. The pivot of a range of more than
+// sample_min elements is the element selected recursively in a sample of
+// about size^(2/3) elements. The sample is chosen so the nth element is
+// almost surely between the pivots of the consecutive steps, so each
+// partitioning reduces the range to about the size of the sample. This takes
+// about 1.5 comparisons per element instead of about 3 of std::nth_element().
+// The smaller ranges and the ones for which the partitioning doesn't converge
+// are passed to std::nth_element().
+template <typename RandomIt, typename Less>
+struct kd_floyd_rivest_select
+{
+    typedef typename boost::iterator_difference<RandomIt>::type difference_type;
+
+    static const difference_type sample_min = 600;
+
+    static inline void apply(RandomIt first, difference_type left, difference_type right,
+                             difference_type k, Less less)
+    {
+        // the introselect-like bound of the number of the partitionings
+        std::size_t steps = 0;
+        for ( difference_type n = right - left + 1 ; n > 1 ; n /= 2 )
+            steps += 2;
+
+        while ( left < right )
+        {
+            if ( steps == 0 || right - left <= sample_min )
+            {
+                std::nth_element(first + left, first + k, first + right + 1, less);
+                return;
+            }
+            --steps;
+
+            {
+                double const n = double(right - left + 1);
+                double const i = double(k - left + 1);
+                double const z = std::log(n);
+                double const s = 0.5 * std::exp(2 * z / 3);
+                double const sd = 0.5 * std::sqrt(z * s * (n - s) / n) * (i < n / 2 ? -1 : 1);
+                difference_type const sample_left = (std::max)(left, difference_type(double(k) - i * s / n + sd));
+                difference_type const sample_right = (std::min)(right, difference_type(double(k) + (n - i) * s / n + sd));
+                apply(first, sample_left, sample_right, k, less);
+            }
+
+            // Hoare partitioning around the kth element, the pivot and a not
+            // less element are placed at the ends to stop the scans
+            typename boost::iterator_value<RandomIt>::type const t = *(first + k);
+            std::iter_swap(first + left, first + k);
+            if ( less(t, *(first + right)) )
+                std::iter_swap(first + right, first + left);
+
+            difference_type i = left;
+            difference_type j = right;
+            while ( i < j )
+            {
+                std::iter_swap(first + i, first + j);
+                ++i;
+                --j;
+                while ( less(*(first + i), t) )
+                    ++i;
+                while ( less(t, *(first + j)) )
+                    --j;
+            }
+
+            if ( ! less(*(first + left), t) && ! less(t, *(first + left)) )
+            {
+                std::iter_swap(first + left, first + j);
+            }
+            else
+            {
+                ++j;
+                std::iter_swap(first + j, first + right);
+            }
+
+            if ( j <= k )
+                left = j + 1;
+            if ( k <= j )
+                right = j - 1;
+        }
+    }
+};
+
+// the same as std::nth_element()
+template <typename RandomIt, typename Less>
+inline void kd_nth_element_sampled(RandomIt first, RandomIt nth, RandomIt last, Less less)
+{
+    typedef kd_floyd_rivest_select<RandomIt, Less> select;
+    typename select::difference_type const size = std::distance(first, last);
+    if ( size > 1 )
+    {
+        select::apply(first, 0, size - 1, std::distance(first, nth), less);
+    }
+}
+
+// ---------------------------------------------------------------------- //
+
+// The same layout as the one created by kd_sort(), so all of the kd_sort()
+// queries may be used, but the medians are selected with kd_nth_element_sampled().
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_sort_sampled_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It>
+    static inline void apply(It first, It last)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        std::size_t rsize = size - lsize - 1;
+
+        It nth = first + lsize;
+        kd_nth_element_sampled(first, nth, last, kd_less_function<I, Point>());
+
+        if ( lsize > ValuesMin )
+        {
+            kd_sort_sampled_impl<Point, next_dimension, ValuesMin>::apply(first, nth);
+        }
+        if ( rsize > ValuesMin )
+        {
+            kd_sort_sampled_impl<Point, next_dimension, ValuesMin>::apply(nth+1, last);
+        }
+    }
+};
+
+template <std::size_t ValuesMin, typename RandomIt>
+inline void kd_sort_sampled(RandomIt first, RandomIt last)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    if ( std::distance(first, last) > 1 )
+    {
+        kd_sort_sampled_impl<point_type, 0, ValuesMin>::apply(first, last);
+    }
+}
+
+template <typename RandomIt>
+inline void kd_sort_sampled(RandomIt first, RandomIt last)
+{
+    kd_sort_sampled<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last);
+}
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_SAMPLED_HPP
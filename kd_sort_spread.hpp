@@ -0,0 +1,529 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_SPREAD_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_SPREAD_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "kd_sort.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// The same layout as the one created by kd_sort() but the split axis of each node
+// is the one along which the elements of its subrange are spread the most.
+// The axis known at runtime makes the traversal slower. If the widest axis was
+// always used kd_nearest_spread() would be slower than kd_nearest() for the
+// uniform and clustered data where the round-robin axes are as good, and faster
+// only for the long and thin ranges. So the widest axis is used only if it's
+// spread considerably more than the round-robin one. The subtrees having only
+// the round-robin axes are marked and traversed like the ones created by
+// kd_sort().
+// The nodes are numbered like in a heap, the root is 1 and the children of
+// the node n are 2n and 2n+1. The axes are packed, the number of bits per node
+// is the smallest power of 2 able to store the Dimension, e.g. 2 bits for 3D.
+template <std::size_t Dimension>
+class kd_split_axes
+{
+public:
+    static const std::size_t bits = Dimension <= 2 ? 1
+                                  : Dimension <= 4 ? 2
+                                  : Dimension <= 16 ? 4
+                                  : 8;
+    static const std::size_t per_byte = 8 / bits;
+    static const unsigned char mask = (1 << bits) - 1;
+
+    BOOST_MPL_ASSERT_MSG((Dimension <= 256), DIMENSION_NOT_SUPPORTED, (kd_split_axes));
+
+    kd_split_axes()
+        : m_nodes_count(0)
+    {}
+
+    // the nodes are [1, nodes_count)
+    inline void reset(std::size_t nodes_count)
+    {
+        m_nodes_count = nodes_count;
+        m_bytes.assign((nodes_count + per_byte - 1) / per_byte, 0);
+        m_round_robin.assign(nodes_count, false);
+    }
+
+    inline std::size_t nodes_count() const
+    {
+        return m_nodes_count;
+    }
+
+    inline std::size_t get(std::size_t node) const
+    {
+        BOOST_ASSERT(node < m_nodes_count);
+        return (m_bytes[node / per_byte] >> (node % per_byte * bits)) & mask;
+    }
+
+    inline void set(std::size_t node, std::size_t axis)
+    {
+        BOOST_ASSERT(node < m_nodes_count && axis < Dimension);
+        unsigned char & byte = m_bytes[node / per_byte];
+        std::size_t const shift = node % per_byte * bits;
+        byte = static_cast<unsigned char>((byte & ~(mask << shift)) | (axis << shift));
+    }
+
+    // true if the axes of the subtree of the node are the same as the ones used by kd_sort()
+    inline bool round_robin(std::size_t node) const
+    {
+        BOOST_ASSERT(node < m_nodes_count);
+        return m_round_robin[node];
+    }
+
+    inline void set_round_robin(std::size_t node)
+    {
+        BOOST_ASSERT(node < m_nodes_count);
+        m_round_robin[node] = true;
+    }
+
+    // the axis used by kd_sort() for the node
+    static inline std::size_t round_robin_axis(std::size_t node)
+    {
+        std::size_t depth = 0;
+        for ( ; node > 1 ; node /= 2 )
+            ++depth;
+        return depth % Dimension;
+    }
+
+private:
+    std::size_t m_nodes_count;
+    std::vector<unsigned char> m_bytes;
+    std::vector<bool> m_round_robin;
+};
+
+// the number of the node indexes needed by the range of size elements
+// the children of a node have at most half of its elements
+template <std::size_t ValuesMin>
+inline std::size_t kd_split_axes_nodes_count(std::size_t size)
+{
+    std::size_t count = 2;
+    for ( size /= 2 ; size > ValuesMin ; size /= 2 )
+        count *= 2;
+    return count;
+}
+
+// ---------------------------------------------------------------------- //
+
+// the coordinate used to calculate the spread, for Boxes the doubled center
+// the same as used by kd_less() for the Boxes
+template <typename Geometry, std::size_t I,
+          typename Tag = typename geometry::tag<Geometry>::type>
+struct kd_spread_coord
+{
+    BOOST_MPL_ASSERT_MSG(false, NOT_IMPLEMENTED, (Geometry));
+};
+
+template <typename Geometry, std::size_t I>
+struct kd_spread_coord<Geometry, I, point_tag>
+{
+    typedef typename coordinate_type<Geometry>::type type;
+
+    static inline type apply(Geometry const& g)
+    {
+        return geometry::get<I>(g);
+    }
+};
+
+template <typename Geometry, std::size_t I>
+struct kd_spread_coord<Geometry, I, box_tag>
+{
+    typedef typename coordinate_type<Geometry>::type type;
+
+    static inline type apply(Geometry const& g)
+    {
+        return geometry::get<min_corner, I>(g) + geometry::get<max_corner, I>(g);
+    }
+};
+
+template <typename Point, std::size_t I = 0, std::size_t Dimension = dimension<Point>::value>
+struct kd_spread_bounds
+{
+    template <typename Coord>
+    static inline void init(Point const& p, Coord * mins, Coord * maxs)
+    {
+        mins[I] = maxs[I] = kd_spread_coord<Point, I>::apply(p);
+        kd_spread_bounds<Point, I+1>::init(p, mins, maxs);
+    }
+
+    template <typename Coord>
+    static inline void expand(Point const& p, Coord * mins, Coord * maxs)
+    {
+        Coord const c = kd_spread_coord<Point, I>::apply(p);
+        if ( c < mins[I] )
+            mins[I] = c;
+        else if ( maxs[I] < c )
+            maxs[I] = c;
+        kd_spread_bounds<Point, I+1>::expand(p, mins, maxs);
+    }
+};
+
+template <typename Point, std::size_t Dimension>
+struct kd_spread_bounds<Point, Dimension, Dimension>
+{
+    template <typename Coord>
+    static inline void init(Point const& , Coord * , Coord * ) {}
+
+    template <typename Coord>
+    static inline void expand(Point const& , Coord * , Coord * ) {}
+};
+
+// std::nth_element() with the comparison along the axis known at runtime
+template <typename Point, std::size_t I = 0, std::size_t Dimension = dimension<Point>::value>
+struct kd_nth_element_by_axis
+{
+    template <typename It>
+    static inline void apply(std::size_t axis, It first, It nth, It last)
+    {
+        if ( axis == I )
+            std::nth_element(first, nth, last, kd_less<I, Point, Point>);
+        else
+            kd_nth_element_by_axis<Point, I+1>::apply(axis, first, nth, last);
+    }
+};
+
+template <typename Point, std::size_t Dimension>
+struct kd_nth_element_by_axis<Point, Dimension, Dimension>
+{
+    template <typename It>
+    static inline void apply(std::size_t , It , It , It )
+    {
+        BOOST_ASSERT(false);
+    }
+};
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_sort_spread_impl
+{
+    static const std::size_t dim = dimension<Point>::value;
+    typedef typename kd_spread_coord<Point, 0>::type coord_type;
+
+    // the widest axis is used if its spread is greater than spread_ratio times
+    // the spread along the round-robin axis and if the subrange is big enough,
+    // otherwise the random differences of the spreads of the small subranges
+    // prevent the round-robin traversal of most of the subtrees
+    static const std::size_t spread_ratio = 2;
+    static const std::size_t spread_size_min = 256 * ValuesMin;
+
+    template <typename It>
+    static inline std::size_t split_axis(It first, It last, std::size_t round_robin_axis)
+    {
+        coord_type mins[dim], maxs[dim];
+        kd_spread_bounds<Point>::init(*first, mins, maxs);
+        for ( ++first ; first != last ; ++first )
+            kd_spread_bounds<Point>::expand(*first, mins, maxs);
+
+        std::size_t axis = 0;
+        for ( std::size_t i = 1 ; i < dim ; ++i )
+        {
+            if ( maxs[axis] - mins[axis] < maxs[i] - mins[i] )
+                axis = i;
+        }
+
+        coord_type const rr_spread = maxs[round_robin_axis] - mins[round_robin_axis];
+        return rr_spread * coord_type(spread_ratio) < maxs[axis] - mins[axis] ? axis : round_robin_axis;
+    }
+
+    // returns true if all of the axes of the subtree are the round-robin ones
+    template <typename It>
+    static inline bool apply(It first, It last, std::size_t node, std::size_t round_robin_axis,
+                             kd_split_axes<dim> & axes)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        std::size_t rsize = size - lsize - 1;
+
+        std::size_t const axis = size > spread_size_min
+                              ? split_axis(first, last, round_robin_axis)
+                              : round_robin_axis;
+        axes.set(node, axis);
+
+        It nth = first + lsize;
+        kd_nth_element_by_axis<Point>::apply(axis, first, nth, last);
+
+        bool result = axis == round_robin_axis;
+        std::size_t const next_axis = (round_robin_axis + 1) % dim;
+        if ( lsize > ValuesMin )
+        {
+            result = apply(first, nth, 2 * node, next_axis, axes) && result;
+        }
+        if ( rsize > ValuesMin )
+        {
+            result = apply(nth+1, last, 2 * node + 1, next_axis, axes) && result;
+        }
+
+        if ( result )
+            axes.set_round_robin(node);
+
+        return result;
+    }
+};
+
+template <std::size_t ValuesMin, typename RandomIt, std::size_t Dimension>
+inline void kd_sort_spread(RandomIt first, RandomIt last, kd_split_axes<Dimension> & axes)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    BOOST_MPL_ASSERT_MSG((Dimension == dimension<point_type>::value), INVALID_DIMENSION, (point_type));
+
+    std::size_t const size = static_cast<std::size_t>(std::distance(first, last));
+    axes.reset(kd_split_axes_nodes_count<ValuesMin>(size));
+    if ( size > 1 )
+    {
+        kd_sort_spread_impl<point_type, ValuesMin>::apply(first, last, 1, 0, axes);
+    }
+}
+
+template <typename RandomIt, std::size_t Dimension>
+inline void kd_sort_spread(RandomIt first, RandomIt last, kd_split_axes<Dimension> & axes)
+{
+    kd_sort_spread<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, axes);
+}
+
+// ---------------------------------------------------------------------- //
+
+// The traversals of kd_sort() with the initial axis known at runtime,
+// used for the round-robin subtrees
+template <typename Point, std::size_t ValuesMin,
+          std::size_t I = 0, std::size_t Dimension = dimension<Point>::value>
+struct kd_round_robin_by_axis
+{
+    template <typename It, typename Value>
+    static inline bool binary_search(std::size_t axis, It first, It last, Value const& value)
+    {
+        if ( axis == I )
+            return kd_binary_search_impl<Point, I, ValuesMin>::apply(first, last, value);
+        else
+            return kd_round_robin_by_axis<Point, ValuesMin, I+1>::binary_search(axis, first, last, value);
+    }
+
+    template <typename It, typename Value, typename CDist>
+    static inline bool nearest(std::size_t axis, It first, It last, Value const& point, It & out_it, CDist & smallest_cdist)
+    {
+        if ( axis == I )
+            return kd_nearest_impl<Point, I, ValuesMin>::apply(first, last, point, out_it, smallest_cdist);
+        else
+            return kd_round_robin_by_axis<Point, ValuesMin, I+1>::nearest(axis, first, last, point, out_it, smallest_cdist);
+    }
+};
+
+template <typename Point, std::size_t ValuesMin, std::size_t Dimension>
+struct kd_round_robin_by_axis<Point, ValuesMin, Dimension, Dimension>
+{
+    template <typename It, typename Value>
+    static inline bool binary_search(std::size_t , It , It , Value const& )
+    {
+        BOOST_ASSERT(false);
+        return false;
+    }
+
+    template <typename It, typename Value, typename CDist>
+    static inline bool nearest(std::size_t , It , It , Value const& , It & , CDist & )
+    {
+        BOOST_ASSERT(false);
+        return false;
+    }
+};
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_binary_search_spread_impl
+{
+    static const std::size_t dim = dimension<Point>::value;
+
+    template <typename It, typename Value>
+    static inline bool per_branch(It first, It last, std::size_t node, kd_split_axes<dim> const& axes, Value const& value)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size > ValuesMin )
+        {
+            return apply(first, last, node, axes, value);
+        }
+        else
+        {
+            return kd_leaf_binary_search<It, Value>::apply(first, last, value);
+        }
+    }
+
+    template <typename It, typename Value>
+    static inline bool apply(It first, It last, std::size_t node, kd_split_axes<dim> const& axes, Value const& value)
+    {
+        if ( axes.round_robin(node) )
+        {
+            return kd_round_robin_by_axis<Point, ValuesMin>
+                        ::binary_search(kd_split_axes<dim>::round_robin_axis(node), first, last, value);
+        }
+
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+
+        It nth = first + lsize;
+
+        if ( geometry::equals(*nth, value) )
+            return true;
+
+        if ( size == 1 )
+            return false;
+
+        std::size_t const axis = axes.get(node);
+
+        if ( kd_less_by_axis(axis, value, *nth) )
+        {
+            return per_branch(first, nth, 2 * node, axes, value);
+        }
+        else if ( kd_less_by_axis(axis, *nth, value) )
+        {
+            return per_branch(nth+1, last, 2 * node + 1, axes, value);
+        }
+        else
+        {
+            return per_branch(first, nth, 2 * node, axes, value)
+                || per_branch(nth+1, last, 2 * node + 1, axes, value);
+        }
+    }
+};
+
+// the axes must be the ones created by kd_sort_spread() for this range
+template <std::size_t ValuesMin, typename RandomIt, std::size_t Dimension, typename Value>
+inline bool kd_binary_search_spread(RandomIt first, RandomIt last, kd_split_axes<Dimension> const& axes, Value const& value)
+{
+    if ( std::distance(first, last) < 1 )
+        return false;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    return kd_binary_search_spread_impl<point_type, ValuesMin>::apply(first, last, 1, axes, value);
+}
+
+template <typename RandomIt, std::size_t Dimension, typename Value>
+inline bool kd_binary_search_spread(RandomIt first, RandomIt last, kd_split_axes<Dimension> const& axes, Value const& value)
+{
+    return kd_binary_search_spread<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, axes, value);
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_nearest_spread_impl
+{
+    static const std::size_t dim = dimension<Point>::value;
+
+    template <typename It, typename Value, typename CDist>
+    static inline bool per_branch(It first, It last, std::size_t node, kd_split_axes<dim> const& axes,
+                                  Value const& point, It & out_it, CDist & smallest_cdist)
+    {
+        if ( axes.round_robin(node) )
+        {
+            return kd_round_robin_by_axis<Point, ValuesMin>
+                        ::nearest(kd_split_axes<dim>::round_robin_axis(node), first, last, point, out_it, smallest_cdist);
+        }
+
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size > ValuesMin )
+        {
+            if ( apply(first, last, node, axes, point, out_it, smallest_cdist) )
+                return true;
+        }
+        else
+        {
+            if ( kd_leaf_nearest<It, Value>::apply(first, last, point, out_it, smallest_cdist) )
+                return true;
+        }
+
+        return false;
+    }
+
+    template <typename It, typename Value, typename CDist>
+    static inline bool apply(It first, It last, std::size_t node, kd_split_axes<dim> const& axes,
+                             Value const& point, It & out_it, CDist & smallest_cdist)
+    {
+        if ( axes.round_robin(node) )
+        {
+            return kd_round_robin_by_axis<Point, ValuesMin>
+                        ::nearest(kd_split_axes<dim>::round_robin_axis(node), first, last, point, out_it, smallest_cdist);
+        }
+
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        It nth = first + lsize;
+
+        if ( kd_nearest_impl<Point>::update_one(nth, point, out_it, smallest_cdist) )
+            return true;
+
+        std::size_t const axis = axes.get(node);
+
+        if ( kd_less_by_axis(axis, point, *nth) )
+        {
+            if ( per_branch(first, nth, 2 * node, axes, point, out_it, smallest_cdist) )
+                return true;
+
+            if ( kd_is_further_by_axis(axis, point, *nth, smallest_cdist) )
+                return false;
+
+            return per_branch(nth+1, last, 2 * node + 1, axes, point, out_it, smallest_cdist);
+        }
+        else if ( kd_less_by_axis(axis, *nth, point) )
+        {
+            if ( per_branch(nth+1, last, 2 * node + 1, axes, point, out_it, smallest_cdist) )
+                return true;
+
+            if ( kd_is_further_by_axis(axis, *nth, point, smallest_cdist) )
+                return false;
+
+            return per_branch(first, nth, 2 * node, axes, point, out_it, smallest_cdist);
+        }
+        else
+        {
+            if ( per_branch(first, nth, 2 * node, axes, point, out_it, smallest_cdist) )
+                return true;
+
+            return per_branch(nth+1, last, 2 * node + 1, axes, point, out_it, smallest_cdist);
+        }
+    }
+};
+
+// the axes must be the ones created by kd_sort_spread() for this range
+template <std::size_t ValuesMin, typename RandomIt, std::size_t Dimension, typename Point, typename Value>
+inline bool kd_nearest_spread(RandomIt first, RandomIt last, kd_split_axes<Dimension> const& axes, Point const& point, Value & result)
+{
+    if ( std::distance(first, last) < 1 )
+        return false;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+
+    typename geometry::default_comparable_distance_result<point_type>::type
+        cdist = geometry::comparable_distance(point, *first);
+    RandomIt out_it = first;
+
+    kd_nearest_spread_impl<point_type, ValuesMin>::apply(first, last, 1, axes, point, out_it, cdist);
+
+    result = *out_it;
+
+    return true;
+}
+
+template <typename RandomIt, std::size_t Dimension, typename Point, typename Value>
+inline bool kd_nearest_spread(RandomIt first, RandomIt last, kd_split_axes<Dimension> const& axes, Point const& point, Value & result)
+{
+    return kd_nearest_spread<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, axes, point, result);
+}
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_SPREAD_HPP
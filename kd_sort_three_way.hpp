@@ -0,0 +1,294 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_THREE_WAY_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_THREE_WAY_HPP
+
+#include <algorithm>
+
+#include "kd_sort.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// The same layout as the one created by kd_sort() but the values equal to the
+// median on axis I are ordered by the remaining axes, I+1, I+2, ... like in
+// the lexicographical comparison starting at axis I. So the values equal to
+// the median on axis I are less/greater than the median on the first
+// differing axis and the side of each value is known. The exact match and
+// nearest queries don't have to search both halves of a node when the queried
+// Point is equal to the median on axis I. The halves still contain the values
+// not greater/not less than the median on axis I so all of the kd_sort()
+// queries may be used with this layout.
+// Only the Points are supported. The kd_less() of the Boxes doesn't define
+// the equivalence of the Boxes.
+
+// -1, 0 or 1 if l is less, equal or greater than r, the axes are compared
+// in the order I, I+1, ..., I+Count-1 modulo dimension
+template <std::size_t I, std::size_t Count>
+struct kd_three_way_compare_impl
+{
+    template <typename G1, typename G2>
+    static inline int apply(G1 const& l, G2 const& r)
+    {
+        if ( kd_less<I>(l, r) )
+            return -1;
+        if ( kd_less<I>(r, l) )
+            return 1;
+
+        return kd_three_way_compare_impl<(I+1) % dimension<G1>::value, Count-1>::apply(l, r);
+    }
+};
+
+template <std::size_t I>
+struct kd_three_way_compare_impl<I, 0>
+{
+    template <typename G1, typename G2>
+    static inline int apply(G1 const& , G2 const& )
+    {
+        return 0;
+    }
+};
+
+template <std::size_t I, typename G1, typename G2>
+inline int kd_three_way_compare(G1 const& l, G2 const& r)
+{
+    return kd_three_way_compare_impl<I, dimension<G1>::value>::apply(l, r);
+}
+
+template <std::size_t I, typename G1, typename G2>
+inline bool kd_three_way_less(G1 const& l, G2 const& r)
+{
+    return kd_three_way_compare<I>(l, r) < 0;
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_sort_three_way_impl
+{
+    BOOST_MPL_ASSERT_MSG((boost::is_same<typename geometry::tag<Point>::type, point_tag>::value),
+                         NOT_IMPLEMENTED_FOR_THIS_VALUE_TYPE, (Point));
+
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It>
+    static inline void apply(It first, It last)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        std::size_t rsize = size - lsize - 1;
+
+        It nth = first + lsize;
+        std::nth_element(first, nth, last, kd_three_way_less<I, Point, Point>);
+
+        if ( lsize > ValuesMin )
+        {
+            kd_sort_three_way_impl<Point, next_dimension, ValuesMin>::apply(first, nth);
+        }
+        if ( rsize > ValuesMin )
+        {
+            kd_sort_three_way_impl<Point, next_dimension, ValuesMin>::apply(nth+1, last);
+        }
+    }
+};
+
+template <std::size_t ValuesMin, typename RandomIt>
+inline void kd_sort_three_way(RandomIt first, RandomIt last)
+{
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    if ( std::distance(first, last) > 1 )
+    {
+        kd_sort_three_way_impl<point_type, 0, ValuesMin>::apply(first, last);
+    }
+}
+
+template <typename RandomIt>
+inline void kd_sort_three_way(RandomIt first, RandomIt last)
+{
+    kd_sort_three_way<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last);
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN,
+          typename Stats = kd_default_stats>
+struct kd_binary_search_three_way_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It, typename Value>
+    static inline bool per_branch(It first, It last, Value const& value)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size > ValuesMin )
+        {
+            return kd_binary_search_three_way_impl<Point, next_dimension, ValuesMin, Stats>::apply(first, last, value);
+        }
+        else
+        {
+            Stats::leaf(size);
+            return kd_leaf_binary_search<It, Value>::apply(first, last, value);
+        }
+    }
+
+    template <typename It, typename Value>
+    static inline bool apply(It first, It last, Value const& value)
+    {
+        typename Stats::scope scope;
+        Stats::node();
+
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+
+        It nth = first + lsize;
+
+        int const cmp = kd_three_way_compare<I>(value, *nth);
+
+        // all of the coordinates are equal
+        if ( cmp == 0 )
+            return true;
+
+        if ( size == 1 )
+            return false;
+
+        return cmp < 0 ?
+               per_branch(first, nth, value) :
+               per_branch(nth+1, last, value);
+    }
+};
+
+// the range must be sorted with kd_sort_three_way()
+template <std::size_t ValuesMin, typename RandomIt, typename Value>
+inline bool kd_binary_search_three_way(RandomIt first, RandomIt last, Value const& value)
+{
+    if ( std::distance(first, last) < 1 )
+        return false;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    return kd_binary_search_three_way_impl<point_type, 0, ValuesMin, kd_default_stats>::apply(first, last, value);
+}
+
+template <typename RandomIt, typename Value>
+inline bool kd_binary_search_three_way(RandomIt first, RandomIt last, Value const& value)
+{
+    return kd_binary_search_three_way<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, value);
+}
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN,
+          typename Stats = kd_default_stats>
+struct kd_nearest_three_way_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    typedef kd_nearest_impl<Point, I, ValuesMin, Stats> base;
+
+    template <typename It, typename Value, typename CDist>
+    static inline bool per_branch(It first, It last, Value const& point, It & out_it, CDist & smallest_cdist)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size > ValuesMin )
+        {
+            if ( kd_nearest_three_way_impl<Point, next_dimension, ValuesMin, Stats>::apply(first, last, point, out_it, smallest_cdist) )
+                return true;
+        }
+        else
+        {
+            Stats::leaf(size);
+            Stats::distance(size);
+            if ( kd_leaf_nearest<It, Value>::apply(first, last, point, out_it, smallest_cdist) )
+                return true;
+        }
+
+        return false;
+    }
+
+    template <typename It, typename Value, typename CDist>
+    static inline bool apply(It first, It last, Value const& point, It & out_it, CDist & smallest_cdist)
+    {
+        typename Stats::scope scope;
+        Stats::node();
+
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+        It nth = first + lsize;
+
+        if ( base::update_one(nth, point, out_it, smallest_cdist) )
+            return true;
+
+        int const cmp = kd_three_way_compare<I>(point, *nth);
+
+        // the closer half is the one containing the values equal to the point
+        // on the first axes, the other one is pruned only if the point isn't
+        // on the splitting plane
+        if ( cmp < 0 )
+        {
+            if ( per_branch(first, nth, point, out_it, smallest_cdist) )
+                return true;
+
+            if ( kd_is_further<I>(point, *nth, smallest_cdist) )
+            {
+                Stats::prune();
+                return false;
+            }
+
+            return per_branch(nth+1, last, point, out_it, smallest_cdist);
+        }
+        else
+        {
+            if ( per_branch(nth+1, last, point, out_it, smallest_cdist) )
+                return true;
+
+            if ( kd_is_further<I>(*nth, point, smallest_cdist) )
+            {
+                Stats::prune();
+                return false;
+            }
+
+            return per_branch(first, nth, point, out_it, smallest_cdist);
+        }
+    }
+};
+
+// the range must be sorted with kd_sort_three_way()
+template <std::size_t ValuesMin, typename RandomIt, typename Point, typename Value>
+inline bool kd_nearest_three_way(RandomIt first, RandomIt last, Point const& point, Value & result)
+{
+    if ( std::distance(first, last) < 1 )
+        return false;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+
+    typename geometry::default_comparable_distance_result<point_type>::type
+        cdist = geometry::comparable_distance(point, *first);
+    RandomIt out_it = first;
+
+    kd_nearest_three_way_impl<point_type, 0, ValuesMin, kd_default_stats>::apply(first, last, point, out_it, cdist);
+
+    result = *out_it;
+
+    return true;
+}
+
+template <typename RandomIt, typename Point, typename Value>
+inline bool kd_nearest_three_way(RandomIt first, RandomIt last, Point const& point, Value & result)
+{
+    return kd_nearest_three_way<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, point, result);
+}
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_THREE_WAY_HPP
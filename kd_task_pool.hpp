@@ -0,0 +1,192 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_TASK_POOL_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_TASK_POOL_HPP
+
+#include <deque>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// A minimal work-stealing pool for fork-only recursions.
+// Each worker owns a deque, pushes/pops its own tasks at the back
+// and steals from the front of the other deques when it runs out of work.
+// The thread calling wait() is the worker 0, so a pool of N threads
+// spawns N-1 additional threads.
+// A task is called with the index of the worker executing it and must not throw.
+class kd_task_pool
+    : boost::noncopyable
+{
+public:
+    typedef boost::function<void(std::size_t)> task_type;
+
+    explicit kd_task_pool(std::size_t threads_count = 0)
+        : m_threads_count(threads_count > 0 ? threads_count : default_threads_count())
+        , m_queues(new queue[m_threads_count])
+        , m_queued(0)
+        , m_pending(0)
+        , m_stop(false)
+    {
+        for ( std::size_t i = 1 ; i < m_threads_count ; ++i )
+        {
+            m_threads.create_thread(boost::bind(&kd_task_pool::worker, this, i));
+        }
+    }
+
+    ~kd_task_pool()
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        m_threads.join_all();
+    }
+
+    std::size_t threads_count() const
+    {
+        return m_threads_count;
+    }
+
+    // may be called by the user before wait() with worker == 0
+    // or by a task with the index of the worker executing it
+    void push(std::size_t worker, task_type const& task)
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(m_queues[worker].mutex);
+            m_queues[worker].tasks.push_back(task);
+        }
+        {
+            boost::lock_guard<boost::mutex> lock(m_mutex);
+            ++m_queued;
+            ++m_pending;
+        }
+        m_condition.notify_one();
+    }
+
+    // executes tasks in the calling thread until all of them are done
+    void wait()
+    {
+        for (;;)
+        {
+            if ( run_one(0) )
+                continue;
+
+            boost::unique_lock<boost::mutex> lock(m_mutex);
+            if ( m_pending == 0 )
+                return;
+            if ( m_queued == 0 )
+                m_condition.wait(lock);
+        }
+    }
+
+    static std::size_t default_threads_count()
+    {
+        std::size_t result = boost::thread::hardware_concurrency();
+        return result > 0 ? result : 1;
+    }
+
+private:
+    struct queue
+    {
+        boost::mutex mutex;
+        std::deque<task_type> tasks;
+    };
+
+    bool pop(std::size_t worker, task_type & task)
+    {
+        {
+            queue & q = m_queues[worker];
+            boost::lock_guard<boost::mutex> lock(q.mutex);
+            if ( ! q.tasks.empty() )
+            {
+                task.swap(q.tasks.back());
+                q.tasks.pop_back();
+                return true;
+            }
+        }
+
+        for ( std::size_t i = 1 ; i < m_threads_count ; ++i )
+        {
+            queue & q = m_queues[(worker + i) % m_threads_count];
+            boost::lock_guard<boost::mutex> lock(q.mutex);
+            if ( ! q.tasks.empty() )
+            {
+                task.swap(q.tasks.front());
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool run_one(std::size_t worker)
+    {
+        task_type task;
+        if ( ! pop(worker, task) )
+            return false;
+
+        {
+            boost::lock_guard<boost::mutex> lock(m_mutex);
+            --m_queued;
+        }
+
+        task(worker);
+
+        bool done = false;
+        {
+            boost::lock_guard<boost::mutex> lock(m_mutex);
+            --m_pending;
+            done = m_pending == 0;
+        }
+        if ( done )
+            m_condition.notify_all();
+
+        return true;
+    }
+
+    void worker(std::size_t index)
+    {
+        for (;;)
+        {
+            if ( run_one(index) )
+                continue;
+
+            boost::unique_lock<boost::mutex> lock(m_mutex);
+            if ( m_stop )
+                return;
+            if ( m_queued == 0 )
+                m_condition.wait(lock);
+        }
+    }
+
+    std::size_t m_threads_count;
+    boost::scoped_array<queue> m_queues;
+    boost::thread_group m_threads;
+
+    boost::mutex m_mutex;
+    boost::condition_variable m_condition;
+    std::size_t m_queued;
+    std::size_t m_pending;
+    bool m_stop;
+};
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_TASK_POOL_HPP
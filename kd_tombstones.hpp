@@ -0,0 +1,413 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_TOMBSTONES_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_TOMBSTONES_HPP
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "kd_sort.hpp"
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// The erased elements of a kd_sort()ed range are only marked as dead, the
+// range is not modified. The dead elements still split the space so
+// the queries prune the same way but they don't return them.
+class kd_tombstones
+{
+public:
+    kd_tombstones()
+        : m_dead_count(0)
+    {}
+
+    explicit kd_tombstones(std::size_t size)
+        : m_dead(size, false)
+        , m_dead_count(0)
+    {}
+
+    void reset(std::size_t size)
+    {
+        m_dead.assign(size, false);
+        m_dead_count = 0;
+    }
+
+    std::size_t size() const
+    {
+        return m_dead.size();
+    }
+
+    std::size_t dead_count() const
+    {
+        return m_dead_count;
+    }
+
+    double dead_fraction() const
+    {
+        return m_dead.empty() ? 0.0 : double(m_dead_count) / double(m_dead.size());
+    }
+
+    bool is_dead(std::size_t i) const
+    {
+        return m_dead[i];
+    }
+
+    // returns false if the element is already dead
+    bool erase(std::size_t i)
+    {
+        if ( m_dead[i] )
+            return false;
+        m_dead[i] = true;
+        ++m_dead_count;
+        return true;
+    }
+
+private:
+    std::vector<bool> m_dead;
+    std::size_t m_dead_count;
+};
+
+// passes only the alive elements to the Result used by kd_nearest_k_impl
+template <typename Result, typename It>
+class kd_alive_result
+{
+public:
+    typedef typename Result::distance_type distance_type;
+
+    kd_alive_result(Result & result, It first, kd_tombstones const& tombstones)
+        : m_result(result), m_first(first), m_tombstones(tombstones)
+    {}
+
+    inline bool update(It it, distance_type const& cdist)
+    {
+        if ( m_tombstones.is_dead(static_cast<std::size_t>(std::distance(m_first, it))) )
+            return false;
+        return m_result.update(it, cdist);
+    }
+
+    inline bool is_full() const { return m_result.is_full(); }
+    inline distance_type const& greatest_cdist() const { return m_result.greatest_cdist(); }
+
+private:
+    Result & m_result;
+    It m_first;
+    kd_tombstones const& m_tombstones;
+};
+
+// the closest element found so far, the Result used by kd_nearest_k_impl for k = 1
+template <typename It, typename CDist>
+class kd_nearest_one_result
+{
+public:
+    typedef CDist distance_type;
+
+    kd_nearest_one_result()
+        : m_cdist((std::numeric_limits<CDist>::max)())
+        , m_found(false)
+    {}
+
+    inline bool update(It it, CDist const& cdist)
+    {
+        if ( ! m_found || cdist < m_cdist )
+        {
+            m_it = it;
+            m_cdist = cdist;
+            m_found = true;
+        }
+        return math::equals(m_cdist, CDist(0));
+    }
+
+    inline bool is_full() const { return m_found; }
+    inline CDist const& greatest_cdist() const { return m_cdist; }
+
+    // valid only if is_full()
+    inline It it() const { return m_it; }
+
+private:
+    It m_it;
+    CDist m_cdist;
+    bool m_found;
+};
+
+// ---------------------------------------------------------------------- //
+
+template <typename Point, std::size_t I = 0,
+          std::size_t ValuesMin = BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>
+struct kd_find_alive_impl
+{
+    static const std::size_t next_dimension = (I+1) % dimension<Point>::value;
+
+    template <typename It, typename Value>
+    static inline It per_branch(It first, It last, It range_first, kd_tombstones const& tombstones,
+                                Value const& value, It not_found)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+
+        if ( size > ValuesMin )
+        {
+            return kd_find_alive_impl<Point, next_dimension, ValuesMin>::apply(first, last, range_first, tombstones, value, not_found);
+        }
+        else
+        {
+            for ( ; first != last ; ++first )
+            {
+                if ( geometry::equals(*first, value)
+                  && ! tombstones.is_dead(static_cast<std::size_t>(std::distance(range_first, first))) )
+                    return first;
+            }
+            return not_found;
+        }
+    }
+
+    template <typename It, typename Value>
+    static inline It apply(It first, It last, It range_first, kd_tombstones const& tombstones,
+                           Value const& value, It not_found)
+    {
+        std::size_t size = static_cast<std::size_t>(std::distance(first, last));
+        std::size_t lsize = size / 2;
+
+        It nth = first + lsize;
+
+        if ( geometry::equals(*nth, value)
+          && ! tombstones.is_dead(static_cast<std::size_t>(std::distance(range_first, nth))) )
+            return nth;
+
+        if ( kd_less<I>(value, *nth) )
+        {
+            return per_branch(first, nth, range_first, tombstones, value, not_found);
+        }
+        else if ( kd_less<I>(*nth, value) )
+        {
+            return per_branch(nth+1, last, range_first, tombstones, value, not_found);
+        }
+        else
+        {
+            It result = per_branch(first, nth, range_first, tombstones, value, not_found);
+            return result != not_found ?
+                   result :
+                   per_branch(nth+1, last, range_first, tombstones, value, not_found);
+        }
+    }
+};
+
+// returns the alive element equal to the value or last
+// the range must be sorted with the same ValuesMin
+template <std::size_t ValuesMin, typename RandomIt, typename Value>
+inline RandomIt kd_find(RandomIt first, RandomIt last, kd_tombstones const& tombstones, Value const& value)
+{
+    if ( std::distance(first, last) < 1 )
+        return last;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    return kd_find_alive_impl<point_type, 0, ValuesMin>::apply(first, last, first, tombstones, value, last);
+}
+
+template <typename RandomIt, typename Value>
+inline RandomIt kd_find(RandomIt first, RandomIt last, kd_tombstones const& tombstones, Value const& value)
+{
+    return kd_find<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, tombstones, value);
+}
+
+// marks the alive element equal to the value as dead, returns false if there is none
+template <std::size_t ValuesMin, typename RandomIt, typename Value>
+inline bool kd_erase(RandomIt first, RandomIt last, kd_tombstones & tombstones, Value const& value)
+{
+    RandomIt it = kd_find<ValuesMin>(first, last, tombstones, value);
+    return it != last
+        && tombstones.erase(static_cast<std::size_t>(std::distance(first, it)));
+}
+
+template <typename RandomIt, typename Value>
+inline bool kd_erase(RandomIt first, RandomIt last, kd_tombstones & tombstones, Value const& value)
+{
+    return kd_erase<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, tombstones, value);
+}
+
+template <std::size_t ValuesMin, typename RandomIt, typename Value>
+inline bool kd_binary_search(RandomIt first, RandomIt last, kd_tombstones const& tombstones, Value const& value)
+{
+    return kd_find<ValuesMin>(first, last, tombstones, value) != last;
+}
+
+template <typename RandomIt, typename Value>
+inline bool kd_binary_search(RandomIt first, RandomIt last, kd_tombstones const& tombstones, Value const& value)
+{
+    return kd_binary_search<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, tombstones, value);
+}
+
+// ---------------------------------------------------------------------- //
+
+template <std::size_t ValuesMin, typename RandomIt, typename Point, typename Value>
+inline bool kd_nearest(RandomIt first, RandomIt last, kd_tombstones const& tombstones, Point const& point, Value & result)
+{
+    if ( std::distance(first, last) < 1 )
+        return false;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typedef typename geometry::default_comparable_distance_result<point_type>::type cdist_type;
+
+    kd_nearest_one_result<RandomIt, cdist_type> nearest;
+    kd_alive_result<kd_nearest_one_result<RandomIt, cdist_type>, RandomIt> alive(nearest, first, tombstones);
+
+    kd_nearest_k_impl<point_type, 0, ValuesMin>::apply(first, last, point, alive);
+
+    if ( ! nearest.is_full() )
+        return false;
+
+    result = *nearest.it();
+
+    return true;
+}
+
+template <typename RandomIt, typename Point, typename Value>
+inline bool kd_nearest(RandomIt first, RandomIt last, kd_tombstones const& tombstones, Point const& point, Value & result)
+{
+    return kd_nearest<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, tombstones, point, result);
+}
+
+// writes at most k closest alive values sorted by distance, returns the number of values written
+template <std::size_t ValuesMin, typename RandomIt, typename Point, typename OutIt>
+inline std::size_t kd_nearest_k(RandomIt first, RandomIt last, kd_tombstones const& tombstones, Point const& point, std::size_t k, OutIt out_it)
+{
+    if ( std::distance(first, last) < 1 || k < 1 )
+        return 0;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typedef typename geometry::default_comparable_distance_result<point_type>::type cdist_type;
+
+    kd_nearest_k_result<RandomIt, cdist_type> result(k, static_cast<std::size_t>(std::distance(first, last)));
+    kd_alive_result<kd_nearest_k_result<RandomIt, cdist_type>, RandomIt> alive(result, first, tombstones);
+
+    kd_nearest_k_impl<point_type, 0, ValuesMin>::apply(first, last, point, alive);
+
+    result.finish(out_it);
+
+    return result.size();
+}
+
+template <typename RandomIt, typename Point, typename OutIt>
+inline std::size_t kd_nearest_k(RandomIt first, RandomIt last, kd_tombstones const& tombstones, Point const& point, std::size_t k, OutIt out_it)
+{
+    return kd_nearest_k<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, tombstones, point, k, out_it);
+}
+
+// ---------------------------------------------------------------------- //
+
+// The filter of kd_query_within_impl and kd_within_distance_impl passing
+// only the alive elements of the range starting at range_first
+template <typename It>
+class kd_alive_filter
+{
+public:
+    kd_alive_filter(It range_first, kd_tombstones const& tombstones)
+        : m_range_first(range_first), m_tombstones(tombstones)
+    {}
+
+    inline bool operator()(It it) const
+    {
+        return ! m_tombstones.is_dead(static_cast<std::size_t>(std::distance(m_range_first, it)));
+    }
+
+private:
+    It m_range_first;
+    kd_tombstones const& m_tombstones;
+};
+
+// writes the alive values covered by the box, returns the number of values written
+template <std::size_t ValuesMin, typename RandomIt, typename Box, typename OutIt>
+inline std::size_t kd_query_within(RandomIt first, RandomIt last, kd_tombstones const& tombstones, Box const& box, OutIt out_it)
+{
+    if ( std::distance(first, last) < 1 )
+        return 0;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+
+    std::size_t count = 0;
+    kd_query_within_impl<point_type, 0, ValuesMin, kd_alive_filter<RandomIt> >
+        ::apply(first, last, box, out_it, count, kd_alive_filter<RandomIt>(first, tombstones));
+
+    return count;
+}
+
+template <typename RandomIt, typename Box, typename OutIt>
+inline std::size_t kd_query_within(RandomIt first, RandomIt last, kd_tombstones const& tombstones, Box const& box, OutIt out_it)
+{
+    return kd_query_within<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, tombstones, box, out_it);
+}
+
+// ---------------------------------------------------------------------- //
+
+// writes the (value, comparable distance) pairs of the alive values within
+// the distance from the point, returns the number of values written
+template <std::size_t ValuesMin, typename RandomIt, typename Point, typename Distance, typename OutIt>
+inline std::size_t kd_within_distance(RandomIt first, RandomIt last, kd_tombstones const& tombstones,
+                                      Point const& point, Distance const& distance, OutIt out_it)
+{
+    if ( std::distance(first, last) < 1 )
+        return 0;
+
+    typedef typename boost::iterator_value<RandomIt>::type point_type;
+    typedef typename geometry::default_comparable_distance_result<point_type>::type cdist_type;
+
+    cdist_type max_cdist = distance;
+    max_cdist *= max_cdist;
+
+    std::size_t count = 0;
+    kd_within_distance_impl<point_type, 0, ValuesMin, kd_alive_filter<RandomIt> >
+        ::apply(first, last, point, max_cdist, out_it, count, kd_alive_filter<RandomIt>(first, tombstones));
+
+    return count;
+}
+
+template <typename RandomIt, typename Point, typename Distance, typename OutIt>
+inline std::size_t kd_within_distance(RandomIt first, RandomIt last, kd_tombstones const& tombstones,
+                                      Point const& point, Distance const& distance, OutIt out_it)
+{
+    return kd_within_distance<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, tombstones, point, distance, out_it);
+}
+
+// ---------------------------------------------------------------------- //
+
+// Removes the dead elements and sorts the rest again, returns the new end
+// of the range. The implicit layout defines the position of each median by
+// the size of its subrange so a subrange can't shrink without rebuilding
+// all of its ancestors, see kd_dynamic_index for the partial rebuilds.
+// The rest is sorted with the same ValuesMin as the queries use.
+template <std::size_t ValuesMin, typename RandomIt>
+inline RandomIt kd_compact(RandomIt first, RandomIt last, kd_tombstones & tombstones)
+{
+    RandomIt out = first;
+    std::size_t i = 0;
+    for ( RandomIt it = first ; it != last ; ++it, ++i )
+    {
+        if ( ! tombstones.is_dead(i) )
+        {
+            if ( out != it )
+                *out = *it;
+            ++out;
+        }
+    }
+
+    kd_sort<ValuesMin>(first, out);
+    tombstones.reset(static_cast<std::size_t>(std::distance(first, out)));
+
+    return out;
+}
+
+template <typename RandomIt>
+inline RandomIt kd_compact(RandomIt first, RandomIt last, kd_tombstones & tombstones)
+{
+    return kd_compact<BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_VALUES_MIN>(first, last, tombstones);
+}
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_TOMBSTONES_HPP
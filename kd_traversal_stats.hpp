@@ -0,0 +1,129 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_TRAVERSAL_STATS_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_TRAVERSAL_STATS_HPP
+
+#include <cstddef>
+
+#include <boost/config.hpp>
+
+#if !defined(BOOST_NO_CXX11_THREAD_LOCAL)
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_THREAD_LOCAL thread_local
+#elif defined(__GNUC__)
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_THREAD_LOCAL __declspec(thread)
+#else
+#error "thread local storage is not supported"
+#endif
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// The counters of the traversals. There are no constructors so it may be
+// stored in the thread local storage of C++03 compilers.
+struct kd_traversal_counters
+{
+    std::size_t nodes;          // the medians checked
+    std::size_t leaf_values;    // the values scanned in the leaves
+    std::size_t distances;      // the comparable distances calculated
+    std::size_t prunes;         // the subtrees skipped because of kd_is_further()
+    std::size_t depth;          // the current depth of the recursion
+    std::size_t max_depth;
+
+    void reset()
+    {
+        nodes = leaf_values = distances = prunes = depth = max_depth = 0;
+    }
+
+    // e.g. to aggregate the counters of all of the threads
+    kd_traversal_counters & operator+=(kd_traversal_counters const& other)
+    {
+        nodes += other.nodes;
+        leaf_values += other.leaf_values;
+        distances += other.distances;
+        prunes += other.prunes;
+        if ( max_depth < other.max_depth )
+            max_depth = other.max_depth;
+        return *this;
+    }
+};
+
+// The stats policies passed to the traversals. The policy is a template
+// parameter so no stats compile away to nothing.
+struct kd_no_stats
+{
+    // created when a node is entered and destroyed when it's left
+    struct scope
+    {
+        scope() {}
+    };
+
+    static inline void node() {}
+    static inline void leaf(std::size_t ) {}
+    static inline void distance(std::size_t = 1) {}
+    static inline void prune() {}
+    // the depth of the node visited by a traversal without the recursion
+    static inline void depth(std::size_t ) {}
+};
+
+// The counters are stored per thread, each thread updates only its own ones.
+// The values scanned in a leaf are counted before the scan, i.e. also the ones
+// skipped when the exact match is found.
+struct kd_thread_stats
+{
+    static inline kd_traversal_counters & local()
+    {
+        static BOOST_GEOMETRY_INDEX_DETAIL_KD_THREAD_LOCAL kd_traversal_counters counters;
+        return counters;
+    }
+
+    struct scope
+    {
+        scope()
+        {
+            kd_traversal_counters & c = local();
+            if ( ++c.depth > c.max_depth )
+                c.max_depth = c.depth;
+        }
+
+        ~scope()
+        {
+            --local().depth;
+        }
+    };
+
+    static inline void node() { ++local().nodes; }
+    static inline void leaf(std::size_t count) { local().leaf_values += count; }
+    static inline void distance(std::size_t count = 1) { local().distances += count; }
+    static inline void prune() { ++local().prunes; }
+
+    // the depth of the enclosing scope is added, the root is at depth 1
+    static inline void depth(std::size_t d)
+    {
+        kd_traversal_counters & c = local();
+        if ( c.depth + d - 1 > c.max_depth )
+            c.max_depth = c.depth + d - 1;
+    }
+};
+
+// The policy used by kd_nearest(), kd_binary_search(), kd_nearest_left_balanced()
+// and kd_nearest_left_balanced_iterative().
+// If BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_STATS is defined the counters of the
+// calling thread are updated, see kd_thread_stats.
+#ifdef BOOST_GEOMETRY_INDEX_DETAIL_KD_SORT_STATS
+typedef kd_thread_stats kd_default_stats;
+#else
+typedef kd_no_stats kd_default_stats;
+#endif
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_TRAVERSAL_STATS_HPP
@@ -0,0 +1,54 @@
+// Copyright (c) 2014 Adam Wulkiewicz, Lodz, Poland.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_GEOMETRY_INDEX_DETAIL_KD_WITHIN_DISTANCE_RESULT_HPP
+#define BOOST_GEOMETRY_INDEX_DETAIL_KD_WITHIN_DISTANCE_RESULT_HPP
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace boost { namespace geometry { namespace index { namespace detail {
+
+// ---------------------------------------------------------------------- //
+
+// buffers the (value, comparable distance) pairs found by the radius search
+// in order to output them sorted by distance
+template <typename Value, typename CDist>
+class kd_within_distance_sorted_result
+{
+    typedef std::pair<Value, CDist> element_type;
+
+    static inline bool second_less(element_type const& l, element_type const& r)
+    {
+        return l.second < r.second;
+    }
+
+public:
+    typedef std::back_insert_iterator<std::vector<element_type> > iterator;
+
+    inline iterator inserter()
+    {
+        return std::back_inserter(m_elements);
+    }
+
+    template <typename OutIt>
+    inline OutIt finish(OutIt out_it)
+    {
+        std::stable_sort(m_elements.begin(), m_elements.end(), second_less);
+        return std::copy(m_elements.begin(), m_elements.end(), out_it);
+    }
+
+private:
+    std::vector<element_type> m_elements;
+};
+
+// ---------------------------------------------------------------------- //
+
+}}}} // namespace boost::geometry::index::detail
+
+#endif // BOOST_GEOMETRY_INDEX_DETAIL_KD_WITHIN_DISTANCE_RESULT_HPP